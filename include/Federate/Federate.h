@@ -7,10 +7,40 @@
 ///	\author	John Farrier
 ///
 
+#include <Federate/FederateFwd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <vector>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <thread>
+#include <atomic>
+#include <tuple>
+#include <iterator>
+#include <new>
+
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define FEDERATE_HAS_COROUTINES
+#include <coroutine>
+#include <optional>
+#endif
+#endif
 
 ///
 /// A dummy template class which will be used to supporess warnings from unused variables. 
@@ -21,169 +51,5403 @@ template<typename T> inline void SuppressWarningUnusedVariable(T const&)
 }
 
 ///
-/// Mixin with conditional template parameter.
+/// Extracts the result type from a Federate's function type.
 ///
-template<bool, typename T> struct VectorMember
+template<typename T> struct FederateFunctionTraits
 {
-	std::vector<T> vec;
 };
 
 ///
-/// Mixin with conditional template parameter.
 ///
-template<typename T> struct VectorMember<true, T>
+///
+template<typename T> class FederateMoveOnlyFunction
 {
-	std::vector<std::weak_ptr<T>> vec;
 };
 
 ///
-/// Mixin with conditional template parameter.
+/// The function type stored by Federates.  Like std::function, but it only needs the callable to be movable,
+/// so a slot can own a std::unique_ptr, a handle or a buffer directly.
 ///
-template<bool> struct MutexMember
+/// Callables of up to three pointers which move without throwing (captureless lambdas, most small captures) are
+/// stored in the wrapper itself, as std::function does.  Larger copyable callables are stored on the heap.
+/// Copying the wrapper copies a copyable callable; a move-only callable is kept on the heap and shared by the
+/// copies instead, so all of them call the same object.  "share" makes a wrapper which shares any callable.
+///
+/// This breaks source compatibility: Federate<Sig>::FederateFunction, and the function a Tracker points to, used to
+/// be std::function<Sig>.  The wrapper converts to std::function<Sig>, as it is copyable, but it is a different type,
+/// so code which relied on it being one (a std::function<Sig>& or a Tracker declared with std::function, an overload
+/// or deduction on it, "target" or "target_type") must change.
+///
+template<typename R, typename... Args> class FederateMoveOnlyFunction<R(Args...)>
 {
-	int acquire() const
-	{
-		return 0;
-	}
+	private:
+		/// Room for the callable, or for the pointer to it.
+		typedef typename std::aligned_storage<3 * sizeof(void*), std::alignment_of<void*>::value>::type Storage;
+
+		enum Operation
+		{
+			Destroy,
+			Move,
+			Copy,
+			Size,
+			Share
+		};
+
+		///
+		/// Small callables which move without throwing: stored in place.
+		///
+		template<typename F> struct Inline
+		{
+			template<typename G> static void create(Storage& s, G&& f)
+			{
+				new(&s) F(std::forward<G>(f));
+			}
+
+			static F& get(Storage& s)
+			{
+				return *reinterpret_cast<F*>(&s);
+			}
+
+			static size_t manage(Operation op, FederateMoveOnlyFunction* from, FederateMoveOnlyFunction* to)
+			{
+				switch(op)
+				{
+					case Destroy:
+						Inline::get(from->storage).~F();
+						break;
+
+					case Move:
+						new(&to->storage) F(std::move(Inline::get(from->storage)));
+						Inline::get(from->storage).~F();
+						break;
+
+					case Copy:
+						new(&to->storage) F(Inline::get(from->storage));
+						break;
+
+					case Size:
+						break;
+
+					case Share:
+					{
+						auto shared = std::make_shared<F>(std::move(Inline::get(from->storage)));
+						Inline::get(from->storage).~F();
+						Shared<F, true>::adopt(*from, std::move(shared));
+						return from->manage(Share, from, to);
+					}
+				}
+
+				// Nothing on the heap.
+				return 0;
+			}
+		};
+
+		///
+		/// Larger copyable callables: stored on the heap and copied with the wrapper.
+		///
+		template<typename F> struct Heap
+		{
+			template<typename G> static void create(Storage& s, G&& f)
+			{
+				new(&s) F*(new F(std::forward<G>(f)));
+			}
+
+			static F*& pointer(Storage& s)
+			{
+				return *reinterpret_cast<F**>(&s);
+			}
+
+			static F& get(Storage& s)
+			{
+				return *Heap::pointer(s);
+			}
+
+			static size_t manage(Operation op, FederateMoveOnlyFunction* from, FederateMoveOnlyFunction* to)
+			{
+				switch(op)
+				{
+					case Destroy:
+						delete Heap::pointer(from->storage);
+						break;
+
+					case Move:
+						new(&to->storage) F*(Heap::pointer(from->storage));
+						break;
+
+					case Copy:
+						new(&to->storage) F*(new F(Heap::get(from->storage)));
+						break;
+
+					case Size:
+						break;
+
+					case Share:
+					{
+						// Copied rather than adopted if moving could throw, so a failure leaves the callable where it was.
+						auto shared = std::make_shared<F>(std::move_if_noexcept(Heap::get(from->storage)));
+						delete Heap::pointer(from->storage);
+						Shared<F, true>::adopt(*from, std::move(shared));
+						return from->manage(Share, from, to);
+					}
+				}
+
+				return sizeof(F);
+			}
+		};
+
+		///
+		/// Callables on the heap behind a std::shared_ptr.  Move-only callables are stored this way from the start and
+		/// shared by copies of the wrapper ("Deep" is false).  A copyable callable moves here the first time it is
+		/// shared, and copies of its wrapper still copy it ("Deep" is true); only the wrappers made by "share" share it.
+		///
+		template<typename F, bool Deep> struct Shared
+		{
+			template<typename G> static void create(Storage& s, G&& f)
+			{
+				new(&s) std::shared_ptr<F>(std::make_shared<F>(std::forward<G>(f)));
+			}
+
+			static void adopt(FederateMoveOnlyFunction& x, std::shared_ptr<F> f)
+			{
+				new(&x.storage) std::shared_ptr<F>(std::move(f));
+				x.call = &FederateMoveOnlyFunction::callTarget<Shared>;
+				x.manage = &Shared::manage;
+			}
+
+			static std::shared_ptr<F>& pointer(Storage& s)
+			{
+				return *reinterpret_cast<std::shared_ptr<F>*>(&s);
+			}
+
+			static F& get(Storage& s)
+			{
+				return *Shared::pointer(s);
+			}
+
+			static size_t manage(Operation op, FederateMoveOnlyFunction* from, FederateMoveOnlyFunction* to)
+			{
+				switch(op)
+				{
+					case Destroy:
+						Shared::pointer(from->storage).~shared_ptr();
+						break;
+
+					case Move:
+						new(&to->storage) std::shared_ptr<F>(std::move(Shared::pointer(from->storage)));
+						Shared::pointer(from->storage).~shared_ptr();
+						break;
+
+					case Copy:
+						Shared::copy(from->storage, to->storage, std::integral_constant<bool, Deep>());
+						break;
+
+					case Size:
+						break;
+
+					case Share:
+						Shared<F, false>::adopt(*to, Shared::pointer(from->storage));
+						break;
+				}
+
+				return sizeof(F);
+			}
+
+			static void copy(Storage& from, Storage& to, std::true_type)
+			{
+				new(&to) std::shared_ptr<F>(std::make_shared<F>(Shared::get(from)));
+			}
+
+			static void copy(Storage& from, Storage& to, std::false_type)
+			{
+				new(&to) std::shared_ptr<F>(Shared::pointer(from));
+			}
+		};
+
+		template<typename F> struct Handler
+		{
+			static const bool Fits = sizeof(F) <= sizeof(Storage)
+				&& std::alignment_of<F>::value <= std::alignment_of<Storage>::value
+				&& std::is_nothrow_move_constructible<F>::value;
+
+			typedef typename std::conditional<std::is_copy_constructible<F>::value == false, Shared<F, false>,
+				typename std::conditional<Fits, Inline<F>, Heap<F>>::type>::type type;
+		};
+
+	public:
+		FederateMoveOnlyFunction() : call(nullptr), manage(nullptr)
+		{
+		}
+
+		FederateMoveOnlyFunction(std::nullptr_t) : call(nullptr), manage(nullptr)
+		{
+		}
+
+		template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, FederateMoveOnlyFunction>::value>::type>
+		FederateMoveOnlyFunction(F&& f) : call(nullptr), manage(nullptr)
+		{
+			typedef typename Handler<typename std::decay<F>::type>::type H;
+
+			H::create(this->storage, std::forward<F>(f));
+			this->call = &FederateMoveOnlyFunction::callTarget<H>;
+			this->manage = &H::manage;
+		}
+
+		FederateMoveOnlyFunction(const FederateMoveOnlyFunction& x) : call(nullptr), manage(nullptr)
+		{
+			if(x.manage != nullptr)
+			{
+				x.manage(Copy, const_cast<FederateMoveOnlyFunction*>(&x), this);
+				this->call = x.call;
+				this->manage = x.manage;
+			}
+		}
+
+		FederateMoveOnlyFunction(FederateMoveOnlyFunction&& x) noexcept : call(nullptr), manage(nullptr)
+		{
+			this->take(x);
+		}
+
+		FederateMoveOnlyFunction& operator=(const FederateMoveOnlyFunction& x)
+		{
+			if(this != &x)
+			{
+				FederateMoveOnlyFunction copy(x);
+				*this = std::move(copy);
+			}
+
+			return *this;
+		}
+
+		FederateMoveOnlyFunction& operator=(FederateMoveOnlyFunction&& x) noexcept
+		{
+			if(this != &x)
+			{
+				this->reset();
+				this->take(x);
+			}
+
+			return *this;
+		}
+
+		FederateMoveOnlyFunction& operator=(std::nullptr_t)
+		{
+			this->reset();
+			return *this;
+		}
+
+		~FederateMoveOnlyFunction()
+		{
+			this->reset();
+		}
+
+		///
+		/// Calls the stored callable.  Throws std::bad_function_call if there is none.
+		///
+		R operator()(Args... args) const
+		{
+			if(this->call == nullptr)
+			{
+				throw std::bad_function_call();
+			}
+
+			return this->call(this->storage, std::forward<Args>(args)...);
+		}
+
+		explicit operator bool() const
+		{
+			return this->call != nullptr;
+		}
+
+		///
+		/// Returns a wrapper which calls the same callable object as this one, for a caller which must outlive this
+		/// wrapper, such as an asynchronous task.  A callable stored in place or on its own is moved to a shared heap
+		/// block the first time, which is the only allocation; after that, sharing only counts a reference.
+		/// Copies of this wrapper still copy a copyable callable.
+		///
+		FederateMoveOnlyFunction share()
+		{
+			FederateMoveOnlyFunction x;
+
+			if(this->manage != nullptr)
+			{
+				this->manage(Share, this, &x);
+			}
+
+			return x;
+		}
+
+		///
+		/// Returns the size of the heap block holding the callable and its captures, or 0 if it is stored in place or empty.
+		/// Memory the captures themselves own (a captured std::vector's buffer, say) is not included.
+		///
+		size_t targetSize() const
+		{
+			return (this->manage != nullptr) ? this->manage(Size, const_cast<FederateMoveOnlyFunction*>(this), nullptr) : 0;
+		}
+
+	private:
+		template<typename H> static R callTarget(Storage& s, Args... args)
+		{
+			return H::get(s)(std::forward<Args>(args)...);
+		}
+
+		void take(FederateMoveOnlyFunction& x) noexcept
+		{
+			if(x.manage != nullptr)
+			{
+				x.manage(Move, &x, this);
+				this->call = x.call;
+				this->manage = x.manage;
+				x.call = nullptr;
+				x.manage = nullptr;
+			}
+		}
+
+		void reset()
+		{
+			if(this->manage != nullptr)
+			{
+				this->manage(Destroy, this, nullptr);
+			}
+
+			this->call = nullptr;
+			this->manage = nullptr;
+		}
+
+		/// Mutable because calling a const wrapper may still change the callable's state, as with std::function.
+		mutable Storage storage;
+		R (*call)(Storage&, Args...);
+		size_t (*manage)(Operation, FederateMoveOnlyFunction*, FederateMoveOnlyFunction*);
 };
 
 ///
-/// Mixin with conditional template parameter.
+/// Extracts the result type from a Federate's function type.
 ///
-template<> struct MutexMember<true>
+template<typename R, typename... Args> struct FederateFunctionTraits<FederateMoveOnlyFunction<R(Args...)>>
 {
-	std::lock_guard<std::mutex> acquire() const
-	{
-		return std::lock_guard<std::mutex>(this->access);
-	}
+	typedef R ResultType;
 
-	mutable std::mutex access;
+	/// The parameters as declared: reference parameters stay references.
+	typedef std::tuple<Args...> Parameters;
 };
 
 ///
-/// Base class for all Federate classes.
-/// This consolodates some of the copy-paste implementation that would otherwise be required.
+/// A compile-time list of indices, used to unpack a tuple into a call.
 ///
-template<typename FederateFunction, bool Tracked, bool ThreadSafe> class FederateBase
+template<size_t...> struct FederateIndexSequence
 {
-	public:
-		typedef std::shared_ptr<FederateFunction> Tracker;
-		typedef std::weak_ptr<FederateFunction> WeakTracker;
+};
 
-		///
-		/// Adds a new function to the end of the Federate.
-		/// Non-Tracked Version.
-		///
-		template<typename = typename std::enable_if<!Tracked>::type> 
-		void push_back(FederateFunction f)
+///
+/// Builds FederateIndexSequence<0, 1, ..., N - 1>.
+///
+template<size_t N, size_t... Is> struct FederateMakeIndexSequence : FederateMakeIndexSequence<N - 1, N - 1, Is...>
+{
+};
+
+template<size_t... Is> struct FederateMakeIndexSequence<0, Is...>
+{
+	typedef FederateIndexSequence<Is...> type;
+};
+
+///
+/// True if every type is trivially copyable, so it can be copied as bytes.
+///
+template<typename... Ts> struct FederateAllTriviallyCopyable : std::true_type
+{
+};
+
+template<typename T, typename... Ts> struct FederateAllTriviallyCopyable<T, Ts...> :
+	std::integral_constant<bool, std::is_trivially_copyable<T>::value && FederateAllTriviallyCopyable<Ts...>::value>
+{
+};
+
+///
+/// True if every type is copy-constructible.
+///
+template<typename... Ts> struct FederateAllCopyConstructible : std::true_type
+{
+};
+
+template<typename T, typename... Ts> struct FederateAllCopyConstructible<T, Ts...> :
+	std::integral_constant<bool, std::is_copy_constructible<T>::value && FederateAllCopyConstructible<Ts...>::value>
+{
+};
+
+///
+/// True if a Federate's arguments can be copied by value, to be kept past the invocation which passed them.
+///
+template<typename T> struct FederateCopyableArguments : std::false_type
+{
+};
+
+template<typename R, typename... Args> struct FederateCopyableArguments<FederateMoveOnlyFunction<R(Args...)>> :
+	FederateAllCopyConstructible<typename std::decay<Args>::type...>
+{
+};
+
+///
+/// Lays a trivially copyable argument pack out as bytes, each argument at the next 8-byte aligned offset.
+/// Used to pass argument packs through shared memory and log files.
+///
+template<typename... Args> struct FederatePackedArgs
+{
+	typedef std::tuple<typename std::decay<Args>::type...> Values;
+	typedef typename FederateMakeIndexSequence<sizeof...(Args)>::type Indices;
+
+	static_assert(FederateAllTriviallyCopyable<typename std::decay<Args>::type...>::value, "Packed arguments must be trivially copyable.");
+
+	///
+	/// Returns where argument "i" starts.  offset(sizeof...(Args)) is the packed size.
+	///
+	static size_t offset(size_t i)
+	{
+		const size_t sizes[] = {sizeof(typename std::decay<Args>::type)..., 0};
+		size_t x = 0;
+
+		for(size_t j = 0; j < i; ++j)
 		{
-			auto scopedLock = this->lock.acquire();
-			SuppressWarningUnusedVariable(scopedLock);
-			this->functions.vec.emplace_back(std::move(f));
+			x += (sizes[j] + 7) & ~size_t(7);
 		}
 
-		///
-		/// Adds a new function to the end of the Federate.
-		/// Tracked Version.
-		///
-		template<typename = typename std::enable_if<Tracked>::type>
-		Tracker push_back(FederateFunction f)
-		{
-			auto tracker = std::make_shared<FederateFunction>(std::move(f));
-			auto scopedLock = this->lock.acquire();
-			SuppressWarningUnusedVariable(scopedLock);
-			this->functions.vec.push_back(tracker);
-			return tracker;
+		return x;
+	}
+
+	static size_t size()
+	{
+		return offset(sizeof...(Args));
+	}
+
+	template<typename... CallArgs> static void write(char* out, CallArgs&... args)
+	{
+		writeAt(out, Indices(), args...);
+	}
+
+	static void read(const char* in, Values& values)
+	{
+		readAt(in, values, Indices());
+	}
+
+	///
+	/// Invokes "federate" with the unpacked values.
+	///
+	template<typename F> static void invoke(F& federate, Values& values)
+	{
+		invokeAt(federate, values, Indices());
+	}
+
+	///
+	/// A hash of each argument's size, alignment and kind, so that processes can tell whether they agree on the layout.
+	///
+	static uint64_t layout()
+	{
+		typedef uint64_t Traits[sizeof...(Args) + 1];
+
+		const Traits traits = {FederatePackedArgs::describe<typename std::decay<Args>::type>()..., 0};
+		return FederatePackedArgs::hash(reinterpret_cast<const char*>(traits), sizeof(traits), FederatePackedArgs::HashBasis);
+	}
+
+	///
+	/// A hash of the bytes of the arguments, to detect a packed copy which was torn while it was written.
+	///
+	template<typename... CallArgs> static uint32_t checksum(CallArgs&... args)
+	{
+		uint64_t x = FederatePackedArgs::HashBasis;
+		int expand[] = {0, (x = FederatePackedArgs::hash(reinterpret_cast<const char*>(&args), sizeof(args), x), 0)...};
+		SuppressWarningUnusedVariable(expand);
+		return static_cast<uint32_t>(x ^ (x >> 32));
+	}
+
+	static uint32_t checksum(Values& values)
+	{
+		return checksumAt(values, Indices());
+	}
+
+	private:
+		template<typename T> static uint64_t describe()
+		{
+			return (uint64_t(sizeof(T)) << 16) | (uint64_t(std::alignment_of<T>::value) << 8) | (std::is_floating_point<T>::value ? 1 : 0) |
+				(std::is_integral<T>::value ? 2 : 0) | (std::is_signed<T>::value ? 4 : 0) | (std::is_pointer<T>::value ? 8 : 0) |
+				(std::is_enum<T>::value ? 16 : 0) | (std::is_class<T>::value ? 32 : 0);
+		}
+
+		static const uint64_t HashBasis = 14695981039346656037ULL;
+
+		///
+		/// FNV-1a over "n" bytes, continuing from the hash "x".  Start from HashBasis.
+		///
+		static uint64_t hash(const char* bytes, size_t n, uint64_t x)
+		{
+			for(size_t i = 0; i < n; ++i)
+			{
+				x = (x ^ static_cast<unsigned char>(bytes[i])) * 1099511628211ULL;
+			}
+
+			return x;
+		}
+
+		template<size_t... Is> static uint32_t checksumAt(Values& values, FederateIndexSequence<Is...>)
+		{
+			SuppressWarningUnusedVariable(values);
+			return FederatePackedArgs::checksum(std::get<Is>(values)...);
+		}
+
+		template<size_t... Is, typename... CallArgs> static void writeAt(char* out, FederateIndexSequence<Is...>, CallArgs&... args)
+		{
+			int expand[] = {0, (std::memcpy(out + offset(Is), &args, sizeof(args)), 0)...};
+			SuppressWarningUnusedVariable(expand);
+		}
+
+		template<size_t... Is> static void readAt(const char* in, Values& values, FederateIndexSequence<Is...>)
+		{
+			int expand[] = {0, (std::memcpy(&std::get<Is>(values), in + offset(Is), sizeof(std::get<Is>(values))), 0)...};
+			SuppressWarningUnusedVariable(expand);
+			SuppressWarningUnusedVariable(in);
+		}
+
+		template<typename F, size_t... Is> static void invokeAt(F& federate, Values& values, FederateIndexSequence<Is...>)
+		{
+			federate.invoke(std::get<Is>(values)...);
+			SuppressWarningUnusedVariable(values);
+		}
+};
+
+///
+/// The type of a Federate's recording hook: its function type, returning void.
+///
+template<typename T> struct FederateRecordHook
+{
+};
+
+template<typename R, typename... Args> struct FederateRecordHook<FederateMoveOnlyFunction<R(Args...)>>
+{
+	typedef FederateMoveOnlyFunction<void(Args...)> type;
+};
+
+///
+/// The arguments of one invocation of a Federate, by value, as "waitNext" and "nextAsync" deliver them.
+///
+template<typename T> struct FederateArguments
+{
+};
+
+template<typename R, typename... Args> struct FederateArguments<FederateMoveOnlyFunction<R(Args...)>>
+{
+	typedef std::tuple<typename std::decay<Args>::type...> type;
+};
+
+///
+/// Threads and futures waiting for the next invocation of a Federate.
+///
+/// Kept apart from the Federate's functions: a wait adds no slot, no std::function and nothing to clean, and
+/// invocations pay one relaxed load while nobody waits.  A blocked thread's record lives on its own stack and it
+/// sleeps on a futex in that record (a condition variable where there are no futexes).  Has its own mutex, so it
+/// may be used alongside invocations of Federates which are not ThreadSafe.
+///
+template<typename Values> class FederateWaiters
+{
+	public:
+		FederateWaiters() : head(nullptr), waiting(0)
+		{
+		}
+
+		FederateWaiters(const FederateWaiters&) = delete;
+		FederateWaiters& operator=(const FederateWaiters&) = delete;
+
+		///
+		/// Blocks until "deliver" or until "timeout" passes.  Returns false, leaving "values" alone, on timeout.
+		/// A timeout too long for the clock, such as nanoseconds::max(), never passes.
+		///
+		bool wait(Values& values, std::chrono::nanoseconds timeout)
+		{
+			return this->waitUntil(values, FederateWaiters::deadlineAfter(timeout));
+		}
+
+		///
+		/// Blocks until "deliver".
+		///
+		void wait(Values& values)
+		{
+			this->waitUntil(values, std::chrono::steady_clock::time_point::max());
+		}
+
+		///
+		/// Blocks until "deliver" or until "deadline".  Returns false, leaving "values" alone, at the deadline.
+		/// time_point::max() waits without a deadline.
+		///
+		bool waitUntil(Values& values, std::chrono::steady_clock::time_point deadline)
+		{
+			Waiter waiter;
+
+			{
+				std::lock_guard<std::mutex> scopedLock(this->mutex);
+				waiter.next = this->head;
+				this->head = &waiter;
+				this->waiting.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			if(this->block(waiter, deadline) == false)
+			{
+				std::lock_guard<std::mutex> scopedLock(this->mutex);
+
+				// "deliver" may have got in between the timeout and the lock.
+				if(waiter.state.load(std::memory_order_acquire) == 0)
+				{
+					this->unlink(&waiter);
+					return false;
+				}
+			}
+
+			values = std::move(*waiter.values());
+			waiter.values()->~Values();
+			return true;
+		}
+
+		///
+		/// Returns a future which "deliver" completes.
+		///
+		std::future<Values> next()
+		{
+			std::lock_guard<std::mutex> scopedLock(this->mutex);
+			this->promises.emplace_back();
+			this->waiting.fetch_add(1, std::memory_order_relaxed);
+			return this->promises.back().get_future();
+		}
+
+		///
+		/// Hands a copy of "args" to everything waiting and wakes it.  Cheap when nothing waits.
+		///
+		template<typename... CallArgs> void deliver(CallArgs&... args)
+		{
+			if(this->waiting.load(std::memory_order_relaxed) == 0)
+			{
+				return;
+			}
+
+			std::lock_guard<std::mutex> scopedLock(this->mutex);
+
+			for(auto waiter = this->head; waiter != nullptr;)
+			{
+				// A woken waiter returns without the lock and takes its record with it: read on before waking it.
+				auto next = waiter->next;
+				new(&waiter->storage) Values(args...);
+				waiter->state.store(1, std::memory_order_release);
+				FederateWaiters::wake(waiter);
+				waiter = next;
+			}
+
+			this->head = nullptr;
+
+			for(auto& promise : this->promises)
+			{
+				promise.set_value(Values(args...));
+			}
+
+			this->promises.clear();
+			this->waiting.store(0, std::memory_order_relaxed);
+
+#if !defined(__linux__)
+			this->ready.notify_all();
+#endif
+		}
+
+	protected:
+		///
+		/// One blocked thread.  "state" becomes 1 once "storage" holds the arguments.
+		///
+		struct Waiter
+		{
+			Waiter() : state(0), next(nullptr)
+			{
+			}
+
+			Values* values()
+			{
+				return reinterpret_cast<Values*>(&this->storage);
+			}
+
+			std::atomic<uint32_t> state;
+			typename std::aligned_storage<sizeof(Values), std::alignment_of<Values>::value>::type storage;
+			Waiter* next;
+		};
+
+		void unlink(Waiter* waiter)
+		{
+			for(auto link = &this->head; *link != nullptr; link = &(*link)->next)
+			{
+				if(*link == waiter)
+				{
+					*link = waiter->next;
+					this->waiting.fetch_sub(1, std::memory_order_relaxed);
+					return;
+				}
+			}
+		}
+
+		///
+		/// Returns the time "timeout" from now, clamped to the clock's range rather than overflowing.
+		///
+		static std::chrono::steady_clock::time_point deadlineAfter(std::chrono::nanoseconds timeout)
+		{
+			typedef std::chrono::steady_clock::time_point TimePoint;
+
+			const auto now = std::chrono::steady_clock::now();
+
+			if(timeout <= std::chrono::nanoseconds::zero())
+			{
+				return now;
+			}
+
+			if(timeout >= std::chrono::duration_cast<std::chrono::nanoseconds>(TimePoint::max() - now))
+			{
+				return TimePoint::max();
+			}
+
+			return now + std::chrono::duration_cast<TimePoint::duration>(timeout);
+		}
+
+#if defined(__linux__)
+		bool block(Waiter& waiter, std::chrono::steady_clock::time_point deadline)
+		{
+			static_assert(sizeof(std::atomic<uint32_t>) == sizeof(int), "futexes need a 32 bit word.");
+
+			for(;;)
+			{
+				if(waiter.state.load(std::memory_order_acquire) != 0)
+				{
+					return true;
+				}
+
+				if(deadline == std::chrono::steady_clock::time_point::max())
+				{
+					::syscall(SYS_futex, &waiter.state, FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+					continue;
+				}
+
+				const auto now = std::chrono::steady_clock::now();
+
+				if(now >= deadline)
+				{
+					return false;
+				}
+
+				const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+				struct timespec relative;
+				relative.tv_sec = static_cast<time_t>(std::chrono::duration_cast<std::chrono::seconds>(remaining).count());
+				relative.tv_nsec = static_cast<long>((remaining - std::chrono::seconds(relative.tv_sec)).count());
+				::syscall(SYS_futex, &waiter.state, FUTEX_WAIT_PRIVATE, 0, &relative, nullptr, 0);
+			}
+		}
+
+		static void wake(Waiter* waiter)
+		{
+			// A private futex is keyed by address alone, so this is harmless if the waiter has already gone.
+			::syscall(SYS_futex, &waiter->state, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+		}
+#else
+		bool block(Waiter& waiter, std::chrono::steady_clock::time_point deadline)
+		{
+			std::unique_lock<std::mutex> scopedLock(this->mutex);
+
+			auto delivered = [&waiter]
+			{
+				return waiter.state.load(std::memory_order_acquire) != 0;
+			};
+
+			// wait_until may convert the deadline to another clock, which overflows at time_point::max().
+			if(deadline == std::chrono::steady_clock::time_point::max())
+			{
+				this->ready.wait(scopedLock, delivered);
+				return true;
+			}
+
+			return this->ready.wait_until(scopedLock, deadline, delivered);
+		}
+
+		static void wake(Waiter*)
+		{
+		}
+
+		std::condition_variable ready;
+#endif
+
+		std::mutex mutex;
+		Waiter* head;
+		std::vector<std::promise<Values>> promises;
+		std::atomic<size_t> waiting;
+};
+
+///
+/// Nothing waits on a Federate whose arguments cannot be copied.  See FederateCopyableArguments.
+///
+template<> class FederateWaiters<void>
+{
+};
+
+#ifdef FEDERATE_HAS_COROUTINES
+
+///
+/// Resumes a coroutine on some thread.  Used to start awaitable slots concurrently.
+/// An empty scheduler starts each slot inline on the awaiting thread.
+///
+typedef std::function<void(std::coroutine_handle<>)> FederateScheduler;
+
+///
+/// Promise state shared by every FederateTask.
+/// Tasks are lazy: they do not run until awaited, and resume their awaiter when complete.
+///
+struct FederateTaskPromiseBase
+{
+	struct FinalAwaiter
+	{
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		template<typename Promise> std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> coroutine) noexcept
+		{
+			auto continuation = coroutine.promise().continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+
+		void await_resume() noexcept
+		{
+		}
+	};
+
+	std::suspend_always initial_suspend() noexcept
+	{
+		return {};
+	}
+
+	FinalAwaiter final_suspend() noexcept
+	{
+		return {};
+	}
+
+	void unhandled_exception()
+	{
+		this->exception = std::current_exception();
+	}
+
+	std::coroutine_handle<> continuation;
+	std::exception_ptr exception;
+};
+
+template<typename T> class FederateTask;
+
+///
+/// Promise for a FederateTask producing a value.
+///
+template<typename T> struct FederateTaskPromise : public FederateTaskPromiseBase
+{
+	FederateTask<T> get_return_object();
+
+	template<typename U> void return_value(U&& x)
+	{
+		this->value.emplace(std::forward<U>(x));
+	}
+
+	T result()
+	{
+		if(this->exception != nullptr)
+		{
+			std::rethrow_exception(this->exception);
+		}
+
+		return std::move(*this->value);
+	}
+
+	std::optional<T> value;
+};
+
+///
+/// Promise for a FederateTask producing no value.
+///
+template<> struct FederateTaskPromise<void> : public FederateTaskPromiseBase
+{
+	FederateTask<void> get_return_object();
+
+	void return_void()
+	{
+	}
+
+	void result()
+	{
+		if(this->exception != nullptr)
+		{
+			std::rethrow_exception(this->exception);
+		}
+	}
+};
+
+///
+/// A lazily-started coroutine returning T.
+/// Use it as the return type of coroutine slots, i.e. "Federate<FederateTask<int>(int)>",
+/// and as the awaitable returned by Federate::invokeCoro.
+///
+template<typename T> class FederateTask
+{
+	public:
+		typedef FederateTaskPromise<T> promise_type;
+
+		FederateTask() = default;
+
+		explicit FederateTask(std::coroutine_handle<promise_type> x) : coroutine(x)
+		{
+		}
+
+		FederateTask(FederateTask&& other) noexcept : coroutine(other.coroutine)
+		{
+			other.coroutine = nullptr;
+		}
+
+		FederateTask& operator=(FederateTask&& other) noexcept
+		{
+			if(this != &other)
+			{
+				this->destroy();
+				this->coroutine = other.coroutine;
+				other.coroutine = nullptr;
+			}
+
+			return *this;
+		}
+
+		FederateTask(const FederateTask&) = delete;
+		FederateTask& operator=(const FederateTask&) = delete;
+
+		~FederateTask()
+		{
+			this->destroy();
+		}
+
+		bool await_ready() const noexcept
+		{
+			return !this->coroutine || this->coroutine.done();
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			this->coroutine.promise().continuation = awaiting;
+			return this->coroutine;
+		}
+
+		T await_resume()
+		{
+			return this->coroutine.promise().result();
+		}
+
+	private:
+		void destroy()
+		{
+			if(this->coroutine)
+			{
+				this->coroutine.destroy();
+				this->coroutine = nullptr;
+			}
+		}
+
+		std::coroutine_handle<promise_type> coroutine;
+};
+
+template<typename T> inline FederateTask<T> FederateTaskPromise<T>::get_return_object()
+{
+	return FederateTask<T>(std::coroutine_handle<FederateTaskPromise<T>>::from_promise(*this));
+}
+
+inline FederateTask<void> FederateTaskPromise<void>::get_return_object()
+{
+	return FederateTask<void>(std::coroutine_handle<FederateTaskPromise<void>>::from_promise(*this));
+}
+
+///
+/// Counts outstanding slots for FederateWhenAll.
+/// Starts at "slots + 1" so the awaiting coroutine holds a reference while it starts the slots.
+///
+struct FederateWhenAllCounter
+{
+	/// Returns true if this was the last outstanding reference.
+	bool release() noexcept
+	{
+		return this->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+
+	std::atomic<size_t> remaining{0};
+	std::coroutine_handle<> continuation;
+};
+
+///
+/// A coroutine which awaits one slot's task on behalf of FederateWhenAll.
+/// It suspends at its end so the owning FederateWhenAll can collect the result and destroy it.
+///
+class FederateWhenAllDriver
+{
+	public:
+		struct promise_type
+		{
+			struct FinalAwaiter
+			{
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept
+				{
+					auto counter = coroutine.promise().counter;
+					return counter->release() ? counter->continuation : std::noop_coroutine();
+				}
+
+				void await_resume() noexcept
+				{
+				}
+			};
+
+			FederateWhenAllDriver get_return_object()
+			{
+				return FederateWhenAllDriver(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			FinalAwaiter final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void return_void()
+			{
+			}
+
+			void unhandled_exception()
+			{
+				this->exception = std::current_exception();
+			}
+
+			FederateWhenAllCounter* counter = nullptr;
+			std::exception_ptr exception;
+		};
+
+		explicit FederateWhenAllDriver(std::coroutine_handle<promise_type> x) : coroutine(x)
+		{
+		}
+
+		FederateWhenAllDriver(FederateWhenAllDriver&& other) noexcept : coroutine(other.coroutine)
+		{
+			other.coroutine = nullptr;
+		}
+
+		FederateWhenAllDriver(const FederateWhenAllDriver&) = delete;
+		FederateWhenAllDriver& operator=(const FederateWhenAllDriver&) = delete;
+		FederateWhenAllDriver& operator=(FederateWhenAllDriver&&) = delete;
+
+		~FederateWhenAllDriver()
+		{
+			if(this->coroutine)
+			{
+				this->coroutine.destroy();
+			}
+		}
+
+		std::coroutine_handle<promise_type> coroutine;
+};
+
+///
+/// Starts every driver (on the scheduler, if one was given) and resumes the awaiting coroutine once all have finished.
+///
+struct FederateWhenAllAwaiter
+{
+	bool await_ready() const noexcept
+	{
+		return this->drivers.empty();
+	}
+
+	bool await_suspend(std::coroutine_handle<> awaiting)
+	{
+		this->counter.remaining.store(this->drivers.size() + 1, std::memory_order_relaxed);
+		this->counter.continuation = awaiting;
+
+		for(auto& driver : this->drivers)
+		{
+			driver.coroutine.promise().counter = &this->counter;
+
+			if(this->scheduler)
+			{
+				this->scheduler(driver.coroutine);
+			}
+			else
+			{
+				driver.coroutine.resume();
+			}
+		}
+
+		// If every slot finished before we got here, continue without suspending.
+		return !this->counter.release();
+	}
+
+	void await_resume()
+	{
+		for(auto& driver : this->drivers)
+		{
+			if(driver.coroutine.promise().exception != nullptr)
+			{
+				std::rethrow_exception(driver.coroutine.promise().exception);
+			}
+		}
+	}
+
+	std::vector<FederateWhenAllDriver>& drivers;
+	const FederateScheduler& scheduler;
+	FederateWhenAllCounter counter;
+};
+
+template<typename T> FederateWhenAllDriver FederateWhenAllRun(FederateTask<T>& task, std::optional<T>& result)
+{
+	result.emplace(co_await task);
+}
+
+inline FederateWhenAllDriver FederateWhenAllRun(FederateTask<void>& task)
+{
+	co_await task;
+}
+
+///
+/// Runs all tasks concurrently and completes when every one of them has finished.
+/// Results are returned in the same order as the tasks.  The first exception thrown by a task is rethrown.
+///
+template<typename T> FederateTask<std::vector<T>> FederateWhenAll(std::vector<FederateTask<T>> tasks, FederateScheduler scheduler)
+{
+	std::vector<std::optional<T>> partial(tasks.size());
+	std::vector<FederateWhenAllDriver> drivers;
+	drivers.reserve(tasks.size());
+
+	for(size_t i = 0; i < tasks.size(); ++i)
+	{
+		drivers.emplace_back(FederateWhenAllRun(tasks[i], partial[i]));
+	}
+
+	co_await FederateWhenAllAwaiter{drivers, scheduler, {}};
+
+	std::vector<T> results;
+	results.reserve(partial.size());
+
+	for(auto& x : partial)
+	{
+		results.push_back(std::move(*x));
+	}
+
+	co_return results;
+}
+
+///
+/// Runs all tasks concurrently and completes when every one of them has finished.
+/// The first exception thrown by a task is rethrown.
+///
+inline FederateTask<void> FederateWhenAll(std::vector<FederateTask<void>> tasks, FederateScheduler scheduler)
+{
+	std::vector<FederateWhenAllDriver> drivers;
+	drivers.reserve(tasks.size());
+
+	for(auto& task : tasks)
+	{
+		drivers.emplace_back(FederateWhenAllRun(task));
+	}
+
+	co_await FederateWhenAllAwaiter{drivers, scheduler, {}};
+}
+
+///
+/// Wraps an already-computed value in a FederateTask.
+///
+template<typename T> FederateTask<T> FederateReadyTask(T x)
+{
+	co_return std::move(x);
+}
+
+///
+/// A FederateTask which completes immediately.
+///
+inline FederateTask<void> FederateReadyTask()
+{
+	co_return;
+}
+
+///
+/// A fire-and-forget coroutine used to bridge from synchronous code.  It starts eagerly and frees itself when done.
+///
+struct FederateDetachedTask
+{
+	struct promise_type
+	{
+		FederateDetachedTask get_return_object()
+		{
+			return {};
+		}
+
+		std::suspend_never initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void return_void()
+		{
+		}
+
+		void unhandled_exception()
+		{
+			std::terminate();
+		}
+	};
+};
+
+///
+/// Signals a thread blocked in FederateSyncWait.
+///
+struct FederateSyncWaitLatch
+{
+	void finish()
+	{
+		std::lock_guard<std::mutex> scopedLock(this->access);
+		this->done = true;
+		this->finished.notify_all();
+	}
+
+	void wait()
+	{
+		std::unique_lock<std::mutex> scopedLock(this->access);
+		this->finished.wait(scopedLock, [this]{ return this->done; });
+	}
+
+	std::mutex access;
+	std::condition_variable finished;
+	bool done = false;
+	std::exception_ptr exception;
+};
+
+template<typename T> struct FederateSyncWaitState : public FederateSyncWaitLatch
+{
+	std::optional<T> value;
+};
+
+template<typename T> FederateDetachedTask FederateSyncWaitRun(FederateTask<T>& task, FederateSyncWaitState<T>& state)
+{
+	try
+	{
+		state.value.emplace(co_await task);
+	}
+	catch(...)
+	{
+		state.exception = std::current_exception();
+	}
+
+	state.finish();
+}
+
+inline FederateDetachedTask FederateSyncWaitRun(FederateTask<void>& task, FederateSyncWaitLatch& state)
+{
+	try
+	{
+		co_await task;
+	}
+	catch(...)
+	{
+		state.exception = std::current_exception();
+	}
+
+	state.finish();
+}
+
+///
+/// Blocks the calling thread until a FederateTask completes and returns its result.
+/// This is the bridge from synchronous code into coroutines; do not call it from a coroutine.
+///
+template<typename T> T FederateSyncWait(FederateTask<T> task)
+{
+	FederateSyncWaitState<T> state;
+	FederateSyncWaitRun(task, state);
+	state.wait();
+
+	if(state.exception != nullptr)
+	{
+		std::rethrow_exception(state.exception);
+	}
+
+	return std::move(*state.value);
+}
+
+///
+/// Blocks the calling thread until a FederateTask completes.
+/// This is the bridge from synchronous code into coroutines; do not call it from a coroutine.
+///
+inline void FederateSyncWait(FederateTask<void> task)
+{
+	FederateSyncWaitLatch state;
+	FederateSyncWaitRun(task, state);
+	state.wait();
+
+	if(state.exception != nullptr)
+	{
+		std::rethrow_exception(state.exception);
+	}
+}
+
+///
+/// Traits selecting how invokeCoro handles a slot result type.
+/// Plain results are computed inline; FederateTask results are run concurrently via FederateWhenAll.
+///
+template<typename R> struct FederateCoroTraits
+{
+	typedef std::vector<R> ResultType;
+	typedef std::false_type IsTask;
+};
+
+template<> struct FederateCoroTraits<void>
+{
+	typedef void ResultType;
+	typedef std::false_type IsTask;
+};
+
+template<typename T> struct FederateCoroTraits<FederateTask<T>>
+{
+	typedef std::vector<T> ResultType;
+	typedef std::true_type IsTask;
+};
+
+template<> struct FederateCoroTraits<FederateTask<void>>
+{
+	typedef void ResultType;
+	typedef std::true_type IsTask;
+};
+
+#endif
+
+///
+/// An object which a FederateReclaimer can take without allocating: it carries the link of the reclaimer's list and
+/// how to destroy itself.
+///
+struct FederateRetiredNode
+{
+	explicit FederateRetiredNode(void (*d)(FederateRetiredNode*)) : next(nullptr), destroy(d)
+	{
+	}
+
+	FederateRetiredNode* next;
+	void (*destroy)(FederateRetiredNode*);
+};
+
+///
+/// What a Tracker owns: the function, and the node which retires it.
+///
+template<typename F> struct FederateTrackedSlot : public FederateRetiredNode
+{
+	explicit FederateTrackedSlot(F f) : FederateRetiredNode(&FederateTrackedSlot::destroy), function(std::move(f))
+	{
+	}
+
+	static void destroy(FederateRetiredNode* x)
+	{
+		delete static_cast<FederateTrackedSlot*>(x);
+	}
+
+	F function;
+};
+
+///
+/// Collects retired slot state so that its destructors run at a time and on a thread of the owner's choosing.
+///
+/// A Federate with a reclaimer never destroys a slot on an invoking thread: whichever thread drops the last
+/// reference to a slot hands it to "retire", and the destructor runs at the next "reclaim" -- called explicitly or by
+/// the optional background thread.  The reclaimer must outlive every Federate that uses it, every future they return
+/// and every Tracker they hand out.
+///
+class FederateReclaimer
+{
+	public:
+		FederateReclaimer() : retiredNodes(nullptr), retiredNodeCount(0), stopping(false)
+		{
+		}
+
+		~FederateReclaimer()
+		{
+			this->stopBackground();
+			this->reclaim();
+		}
+
+		FederateReclaimer(const FederateReclaimer&) = delete;
+		FederateReclaimer& operator=(const FederateReclaimer&) = delete;
+
+		///
+		/// Takes ownership of an object without destroying it.  Only a pointer is moved under a short lock.
+		///
+		void retire(std::shared_ptr<void> x)
+		{
+			std::lock_guard<std::mutex> scopedLock(this->access);
+			this->retired.push_back(std::move(x));
+		}
+
+		///
+		/// Takes ownership of the object "x" is part of, without allocating or locking: it is pushed on a lock-free list.
+		/// This is how a Tracker's last reference retires its slot.
+		///
+		void retire(FederateRetiredNode* x)
+		{
+			auto head = this->retiredNodes.load(std::memory_order_relaxed);
+
+			do
+			{
+				x->next = head;
+			}
+			while(this->retiredNodes.compare_exchange_weak(head, x, std::memory_order_release, std::memory_order_relaxed) == false);
+
+			this->retiredNodeCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		///
+		/// Drops every retired object on the calling thread.
+		/// Returns the number of objects released.
+		///
+		size_t reclaim()
+		{
+			std::vector<std::shared_ptr<void>> batch;
+
+			{
+				std::lock_guard<std::mutex> scopedLock(this->access);
+				batch.swap(this->retired);
+			}
+
+			// Taking the whole list at once leaves nothing for a concurrent "retire" to race with.
+			auto node = this->retiredNodes.exchange(nullptr, std::memory_order_acquire);
+			size_t nodes = 0;
+
+			while(node != nullptr)
+			{
+				auto next = node->next;
+				node->destroy(node);
+				node = next;
+				++nodes;
+			}
+
+			this->retiredNodeCount.fetch_sub(nodes, std::memory_order_relaxed);
+			return batch.size() + nodes;
+		}
+
+		///
+		/// Returns the number of objects waiting for "reclaim".
+		///
+		size_t retiredSize() const
+		{
+			std::lock_guard<std::mutex> scopedLock(this->access);
+			return this->retired.size() + this->retiredNodeCount.load(std::memory_order_relaxed);
+		}
+
+		///
+		/// Starts a thread which calls "reclaim" every "interval".
+		///
+		void startBackground(std::chrono::steady_clock::duration interval)
+		{
+			this->stopBackground();
+			this->stopping = false;
+
+			this->background = std::thread([this, interval]()
+			{
+				std::unique_lock<std::mutex> scopedLock(this->backgroundAccess);
+
+				while(this->stopping == false)
+				{
+					this->wake.wait_for(scopedLock, interval);
+					this->reclaim();
+				}
+			});
+		}
+
+		///
+		/// Stops the background thread, if one is running.
+		///
+		void stopBackground()
+		{
+			if(this->background.joinable() == true)
+			{
+				{
+					std::lock_guard<std::mutex> scopedLock(this->backgroundAccess);
+					this->stopping = true;
+				}
+
+				this->wake.notify_all();
+				this->background.join();
+			}
+		}
+
+	private:
+		mutable std::mutex access;
+		std::vector<std::shared_ptr<void>> retired;
+
+		/// The objects retired by Trackers, as a lock-free stack, and how many there are.
+		std::atomic<FederateRetiredNode*> retiredNodes;
+		std::atomic<size_t> retiredNodeCount;
+
+		std::mutex backgroundAccess;
+		std::condition_variable wake;
+		std::thread background;
+		bool stopping;
+};
+
+///
+/// The deleter of every Tracker.  When the last reference goes, wherever that is, the slot is handed to the
+/// Federate's reclaimer if it has one at that moment, and deleted in place otherwise.  Handing it over pushes the
+/// slot's own node on the reclaimer's lock-free list, so the releasing thread neither allocates nor locks.
+/// "reclaimer" is shared with the Federate so that "setReclaimer" reaches Trackers already handed out.
+///
+struct FederateTrackerDeleter
+{
+	explicit FederateTrackerDeleter(std::shared_ptr<std::atomic<FederateReclaimer*>> r) : reclaimer(std::move(r))
+	{
+	}
+
+	template<typename F> void operator()(FederateTrackedSlot<F>* x) const
+	{
+		auto r = (this->reclaimer != nullptr) ? this->reclaimer->load(std::memory_order_acquire) : nullptr;
+
+		if(r == nullptr)
+		{
+			delete x;
+			return;
+		}
+
+		r->retire(static_cast<FederateRetiredNode*>(x));
+	}
+
+	std::shared_ptr<std::atomic<FederateReclaimer*>> reclaimer;
+};
+
+///
+/// Calls a non-tracked slot.
+///
+template<typename F, typename... Args> auto FederateCall(F& f, Args&... args) -> decltype(f(args...))
+{
+	return f(args...);
+}
+
+///
+/// Calls a tracked slot.
+///
+template<typename F, typename... Args> auto FederateCall(std::shared_ptr<F>& f, Args&... args) -> decltype((*f)(args...))
+{
+	return (*f)(args...);
+}
+
+///
+/// How a Federate handles an exception thrown by one of its functions during a serial invocation.
+///
+enum class FederateErrorPolicy
+{
+	/// The exception leaves "invoke"; later functions are not called.  This is the default.
+	Propagate,
+
+	/// The throwing function is skipped and the error is kept for "takeErrors".
+	Collect,
+
+	/// The throwing function is skipped and the error is passed to the error handler.
+	Handler
+};
+
+///
+/// An exception thrown by a function, and that function's position in the Federate which holds it.
+///
+struct FederateError
+{
+	size_t slot;
+	std::exception_ptr error;
+};
+
+///
+/// The results of "invokeChecked": whatever the functions returned, plus the errors from those that threw.
+///
+template<typename R> struct FederateInvokeResult
+{
+	std::vector<R> results;
+	std::vector<FederateError> errors;
+};
+
+///
+/// The results of "invokeChecked" for functions returning void.
+///
+template<> struct FederateInvokeResult<void>
+{
+	std::vector<FederateError> errors;
+};
+
+///
+/// A vector of trivially copyable results which keeps the first "N" inline and moves to the heap only past that.
+/// Unlike std::vector<bool>, a buffer of bools is a plain array of bytes with a "data" pointer.
+///
+template<typename T, size_t N> class FederateSmallBuffer
+{
+	public:
+		typedef T value_type;
+		typedef T* iterator;
+		typedef const T* const_iterator;
+
+		static_assert(std::is_trivially_copyable<T>::value, "FederateSmallBuffer holds trivially copyable values.");
+
+		FederateSmallBuffer() : capacity(N), count(0)
+		{
+		}
+
+		FederateSmallBuffer(const FederateSmallBuffer& x) : capacity(N), count(0)
+		{
+			*this = x;
+		}
+
+		FederateSmallBuffer(FederateSmallBuffer&& x) : capacity(N), count(0)
+		{
+			*this = std::move(x);
+		}
+
+		FederateSmallBuffer& operator=(const FederateSmallBuffer& x)
+		{
+			if(this != &x)
+			{
+				this->clear();
+				this->reserve(x.count);
+				std::memcpy(this->data(), x.data(), x.count * sizeof(T));
+				this->count = x.count;
+			}
+
+			return *this;
+		}
+
+		FederateSmallBuffer& operator=(FederateSmallBuffer&& x)
+		{
+			if(this != &x)
+			{
+				if(x.heap)
+				{
+					this->heap = std::move(x.heap);
+					this->capacity = x.capacity;
+					this->count = x.count;
+				}
+				else
+				{
+					this->heap.reset();
+					this->capacity = N;
+					this->count = x.count;
+					std::memcpy(this->local, x.local, x.count * sizeof(T));
+				}
+
+				x.capacity = N;
+				x.count = 0;
+			}
+
+			return *this;
+		}
+
+		void push_back(const T& x)
+		{
+			if(this->count == this->capacity)
+			{
+				this->reserve(this->capacity * 2);
+			}
+
+			this->data()[this->count++] = x;
+		}
+
+		///
+		/// Makes room for "n" values, moving them to the heap if that is more than fit inline.
+		///
+		void reserve(size_t n)
+		{
+			if(n > this->capacity)
+			{
+				std::unique_ptr<T[]> grown(new T[n]);
+				std::memcpy(grown.get(), this->data(), this->count * sizeof(T));
+				this->heap = std::move(grown);
+				this->capacity = n;
+			}
+		}
+
+		/// Removes the values.  Heap storage is kept for reuse.
+		void clear()
+		{
+			this->count = 0;
+		}
+
+		/// Returns true while the values are held inline.
+		bool inlined() const
+		{
+			return !this->heap;
+		}
+
+		size_t size() const
+		{
+			return this->count;
+		}
+
+		bool empty() const
+		{
+			return this->count == 0;
+		}
+
+		T* data()
+		{
+			return this->heap ? this->heap.get() : this->local;
+		}
+
+		const T* data() const
+		{
+			return this->heap ? this->heap.get() : this->local;
+		}
+
+		T& operator[](size_t i)
+		{
+			return this->data()[i];
+		}
+
+		const T& operator[](size_t i) const
+		{
+			return this->data()[i];
+		}
+
+		iterator begin()
+		{
+			return this->data();
+		}
+
+		iterator end()
+		{
+			return this->data() + this->count;
+		}
+
+		const_iterator begin() const
+		{
+			return this->data();
+		}
+
+		const_iterator end() const
+		{
+			return this->data() + this->count;
+		}
+
+	private:
+		T local[N];
+		std::unique_ptr<T[]> heap;
+		size_t capacity;
+		size_t count;
+};
+
+///
+/// Writes results to caller-provided memory for "invokeSpan".  Results past "capacity" are counted but not stored.
+///
+template<typename T> class FederateSpanWriter
+{
+	public:
+		FederateSpanWriter(T* out, size_t capacity) : out(out), capacity(capacity), count(0)
+		{
+		}
+
+		void push_back(T x)
+		{
+			if(this->count < this->capacity)
+			{
+				this->out[this->count] = std::move(x);
+			}
+
+			++this->count;
+		}
+
+		void reserve(size_t)
+		{
+		}
+
+		size_t size() const
+		{
+			return this->count;
+		}
+
+	private:
+		T* out;
+		size_t capacity;
+		size_t count;
+};
+
+///
+/// Chooses at compile time how "invokeBuffered" stores the results of functions returning "R".
+/// Arithmetic results (bools included, as bytes) use a buffer which holds a cache line of them inline; anything else uses a vector.
+///
+template<typename R, bool Small = std::is_arithmetic<R>::value> struct FederateResultTraits
+{
+	typedef std::vector<R> Buffer;
+};
+
+template<typename R> struct FederateResultTraits<R, true>
+{
+	static const size_t InlineCapacity = (sizeof(R) < 64) ? (64 / sizeof(R)) : 1;
+	typedef FederateSmallBuffer<R, InlineCapacity> Buffer;
+};
+
+///
+/// Lends "invokeScratch" a result vector from a per-thread pool for one invocation.
+/// Each nesting depth has its own vector, so a function may itself call invokeScratch; the vectors keep their capacity
+/// for the thread's lifetime, so steady-state invocations do not allocate.
+///
+template<typename R> class FederateScratch
+{
+	public:
+		FederateScratch()
+		{
+			auto& p = FederateScratch::pool();
+			auto& d = FederateScratch::depth();
+
+			if(p.size() == d)
+			{
+				p.emplace_back();
+			}
+
+			this->vec = &p[d++];
+			this->vec->clear();
+		}
+
+		~FederateScratch()
+		{
+			--FederateScratch::depth();
+		}
+
+		FederateScratch(const FederateScratch&) = delete;
+		FederateScratch& operator=(const FederateScratch&) = delete;
+
+		std::vector<R>& results()
+		{
+			return *this->vec;
+		}
+
+	private:
+		/// A deque, so lending a deeper vector never moves the shallower ones.
+		static std::deque<std::vector<R>>& pool()
+		{
+			static thread_local std::deque<std::vector<R>> x;
+			return x;
+		}
+
+		static size_t& depth()
+		{
+			static thread_local size_t x = 0;
+			return x;
+		}
+
+		std::vector<R>* vec;
+};
+
+///
+/// The memory a Federate is using, in bytes, as reported by "memoryUsage".
+///
+struct FederateMemoryUsage
+{
+	FederateMemoryUsage() : slots(0), trackers(0), captures(0)
+	{
+	}
+
+	size_t total() const
+	{
+		return this->slots + this->trackers + this->captures;
+	}
+
+	/// The Federate's own vectors, by capacity: functions, per-slot state, errors and connections.
+	size_t slots;
+
+	/// The shared blocks behind Trackers, including those kept alive by expired slots until "clean".
+	/// This is an estimate, as the control block layout belongs to the standard library.
+	size_t trackers;
+
+	/// The heap blocks holding each live function and its captures.
+	size_t captures;
+};
+
+template<typename FederateFunction, bool Tracked, bool ThreadSafe> class FederateBase;
+
+///
+/// Disconnects one function from a non-tracked Federate when it is destroyed.  Returned by "push_back_scoped".
+///
+/// The Federate keeps a pointer back to this object and updates its position as other functions come and go, so
+/// disconnecting erases the function at once: there is no Tracker to allocate and nothing is left for "clean".
+/// If the Federate is cleared or destroyed first, the connection simply becomes disconnected.
+///
+/// Do not destroy a connection from inside an invocation of its own Federate, or while another thread destroys the Federate.
+///
+class FederateScopedConnection
+{
+	public:
+		FederateScopedConnection() : owner(nullptr), manage(nullptr), index(0)
+		{
+		}
+
+		FederateScopedConnection(FederateScopedConnection&& x) : owner(nullptr), manage(nullptr), index(0)
+		{
+			this->take(x);
+		}
+
+		FederateScopedConnection& operator=(FederateScopedConnection&& x)
+		{
+			if(this != &x)
+			{
+				this->disconnect();
+				this->take(x);
+			}
+
+			return *this;
+		}
+
+		~FederateScopedConnection()
+		{
+			this->disconnect();
+		}
+
+		FederateScopedConnection(const FederateScopedConnection&) = delete;
+		FederateScopedConnection& operator=(const FederateScopedConnection&) = delete;
+
+		///
+		/// Removes the function from its Federate now.
+		///
+		void disconnect()
+		{
+			auto federate = this->owner.load();
+
+			if(federate != nullptr)
+			{
+				this->manage(federate, this, nullptr, Disconnect);
+			}
+		}
+
+		///
+		/// Leaves the function in its Federate for good, and disconnects this object from it.
+		///
+		void release()
+		{
+			auto federate = this->owner.load();
+
+			if(federate != nullptr)
+			{
+				this->manage(federate, this, nullptr, Move);
+			}
+		}
+
+		///
+		/// Returns true while the function is in its Federate.
+		///
+		bool connected() const
+		{
+			return this->owner.load() != nullptr;
+		}
+
+	private:
+		friend class FederateCore;
+		template<typename, bool, bool> friend class FederateBase;
+
+		enum Operation
+		{
+			Disconnect,
+			Move
+		};
+
+		void take(FederateScopedConnection& x)
+		{
+			auto federate = x.owner.load();
+
+			if(federate != nullptr)
+			{
+				x.manage(federate, &x, this, Move);
+			}
+		}
+
+		/// The Federate, or nullptr once disconnected.  Only changed under the Federate's lock.
+		std::atomic<void*> owner;
+
+		/// Disconnects "self", or moves its slot's back pointer to "to" (which may be nullptr to release it).
+		void (*manage)(void* owner, FederateScopedConnection* self, FederateScopedConnection* to, Operation op);
+
+		/// The function's position in the Federate.  Only read or changed under the Federate's lock.
+		size_t index;
+};
+
+///
+/// Serializes changes to the connections between Federates.  Each Federate counts the changes below it in an
+/// atomic generation, so a change only invalidates the dispatch lists of the Federates upstream of it, and never
+/// takes a Federate's lock.
+///
+struct FederateTopology
+{
+	static std::mutex& mutex()
+	{
+		static std::mutex m;
+		return m;
+	}
+};
+
+///
+/// Runs the functions started by "invokeAsync" once it is set with "setExecutor", in place of a thread per task.
+/// See FederateThreadPool.
+///
+class FederateExecutor
+{
+	public:
+		virtual ~FederateExecutor()
+		{
+		}
+
+		///
+		/// Runs "task" soon on one of the executor's threads.  "node" is the NUMA node the function prefers to run on,
+		/// as given to "push_back_on_node", or -1 if it has no preference.
+		///
+		virtual void execute(FederateMoveOnlyFunction<void()> task, int node) = 0;
+};
+
+///
+/// True if a slot visitor takes what an asynchronous call holds of the slot, "AsyncSlot", and the slot's preferred
+/// NUMA node, rather than the function.
+///
+template<typename Visitor, typename AsyncSlot> struct FederateVisitsSlot
+{
+	template<typename V> static auto test(int) -> decltype(std::declval<V&>()(std::declval<const AsyncSlot&>(), 0), std::true_type());
+	template<typename V> static std::false_type test(...);
+
+	typedef decltype(test<Visitor>(0)) type;
+};
+
+///
+/// Mixin with conditional template parameter.
+/// A Federate which is not ThreadSafe takes no lock: "acquire" returns a dummy value, and the member costs nothing.
+///
+template<bool> struct MutexMember
+{
+	int acquire() const
+	{
+		return 0;
+	}
+};
+
+///
+/// Mixin with conditional template parameter.
+/// A copy is a new mutex: the mutex itself is never copied.
+///
+template<> struct MutexMember<true>
+{
+	MutexMember()
+	{
+	}
+
+	MutexMember(const MutexMember&)
+	{
+	}
+
+	MutexMember& operator=(const MutexMember&)
+	{
+		return *this;
+	}
+
+	std::unique_lock<std::mutex> acquire() const
+	{
+		return std::unique_lock<std::mutex>(this->access);
+	}
+
+	mutable std::mutex access;
+};
+
+///
+/// Mixin with conditional template parameter.
+///
+template<bool, typename T> struct VectorMember
+{
+	std::vector<T> vec;
+};
+
+///
+/// Mixin with conditional template parameter.
+/// Tracked functions also need the cell their Trackers' deleters read the reclaimer from.  A copy has its own cell.
+///
+template<typename T> struct VectorMember<true, T>
+{
+	VectorMember() : reclaimer(std::make_shared<std::atomic<FederateReclaimer*>>(nullptr))
+	{
+	}
+
+	VectorMember(const VectorMember& x) : vec(x.vec), reclaimer(std::make_shared<std::atomic<FederateReclaimer*>>(x.reclaimer->load()))
+	{
+	}
+
+	///
+	/// The moved Trackers keep reading the moved cell; "x" starts afresh with a cell of its own.
+	///
+	VectorMember(VectorMember&& x) : vec(std::move(x.vec)), reclaimer(std::move(x.reclaimer))
+	{
+		x.reclaimer = std::make_shared<std::atomic<FederateReclaimer*>>(this->reclaimer->load());
+	}
+
+	VectorMember& operator=(const VectorMember& x)
+	{
+		this->vec = x.vec;
+		this->reclaimer->store(x.reclaimer->load());
+		return *this;
+	}
+
+	///
+	/// The old Trackers keep the old cell; those of "x" move here with its cell, and "x" starts afresh.
+	///
+	VectorMember& operator=(VectorMember&& x)
+	{
+		this->vec = std::move(x.vec);
+		this->reclaimer = std::move(x.reclaimer);
+		x.reclaimer = std::make_shared<std::atomic<FederateReclaimer*>>(this->reclaimer->load());
+		return *this;
+	}
+
+	std::vector<std::weak_ptr<T>> vec;
+
+	/// What the deleters of the Trackers read the reclaimer from.
+	std::shared_ptr<std::atomic<FederateReclaimer*>> reclaimer;
+};
+
+///
+/// Everything in a Federate which does not depend on its signature: the state of the slots which need it, timers,
+/// the error policy, the reclaimer, connections to other Federates, hot reordering and asynchronous scheduling.
+/// This is compiled once, whatever the number of signatures.
+///
+/// All of it is in an extension allocated the first time something needs it, so a Federate which only adds and
+/// invokes functions is its functions, one pointer and, if ThreadSafe, its mutex.  The loops check that pointer once
+/// per invocation and, while it is null, call the functions and nothing else.
+///
+/// The functions themselves are not here.  FederateBase keeps them contiguous, by value (or as weak references to
+/// the Trackers' functions when tracked), and its loops call them directly; the core sees slots only by position.
+///
+class FederateCore
+{
+	protected:
+		///
+		/// The state of one slot, for the slots which need it.
+		///
+		struct SlotState
+		{
+			enum Kind
+			{
+				Plain,
+				Throttled,
+				Debounced,
+
+				/// Disconnected: the function is gone, and the slot waits to be compacted away.
+				Dead
+			};
+
+			SlotState() : kind(Plain), period(0), limit(0), calls(0), queued(false), connection(nullptr), node(-1), pinned(false), hits(0), visits(0)
+			{
+			}
+
+			Kind kind;
+
+			/// The throttle interval or the debounce quiet time.
+			std::chrono::steady_clock::duration period;
+
+			/// The end of the current throttle window, or when the pending debounced call is due.
+			std::chrono::steady_clock::time_point deadline;
+
+			size_t limit;
+			size_t calls;
+
+			/// The debounced call waiting for "pollTimers", bound to the latest arguments.  Called with the function.
+			std::function<void(void*)> pending;
+
+			/// True while the slot has an entry in "timers".
+			bool queued;
+
+			/// The connection which removes this slot when it is destroyed, if it was added by push_back_scoped.
+			FederateScopedConnection* connection;
+
+			/// The NUMA node the executor should run this slot on, or -1.
+			int node;
+
+			/// True if reordering by hotness must leave this slot where it is.
+			bool pinned;
+
+			/// How often "invokeFirst" found this slot's result true, out of how often it called it, while reordering.
+			uint32_t hits;
+			uint32_t visits;
+		};
+
+		///
+		/// Whether a slot runs in an invocation: it does, it does not, or, being debounced, it keeps the invocation's
+		/// arguments for "pollTimers" instead.
+		///
+		enum Admission
+		{
+			Admit,
+			Reject,
+			Defer
+		};
+
+		///
+		/// A debounced slot's entry in "timers".  Invocations move the slot's deadline without touching its entry, so
+		/// the slot is due at "deadline" or later.
+		///
+		struct Timer
+		{
+			std::chrono::steady_clock::time_point deadline;
+			size_t slot;
+		};
+
+		///
+		/// The part of the extension which depends on the signature: the recorder and the waiters.  FederateBase
+		/// derives its own, allocated the first time one of them is used.
+		///
+		struct TypedExtension
+		{
+			virtual ~TypedExtension()
+			{
+			}
+		};
+
+		static const size_t MinPruneAt = 16;
+
+		///
+		/// What a Federate allocates the first time it needs more than its functions.  See FederateCore.
+		///
+		struct Extension
+		{
+			Extension() :
+				hasTimedSlots(false),
+				deadSlots(0),
+				errorPolicy(FederateErrorPolicy::Propagate),
+				reclaimer(nullptr),
+				asyncGrain(1),
+				asyncPruneAt(FederateCore::MinPruneAt),
+				reorderInterval(0),
+				reorderCountdown(0),
+				linked(false),
+				topologyGeneration(1),
+				dispatchGeneration(1),
+				activeWalk(0),
+				watchers(0),
+				typed(nullptr)
+			{
+			}
+
+			~Extension()
+			{
+				delete this->typed.load(std::memory_order_acquire);
+			}
+
+			Extension(const Extension&) = delete;
+			Extension& operator=(const Extension&) = delete;
+
+			/// Empty until the first slot which needs state is added, and parallel to the slots after that.
+			std::vector<SlotState> slotInfo;
+
+			/// The debounced slots with a pending call, as a min-heap on the deadline.  Empty when there are none.
+			std::vector<Timer> timers;
+
+			/// True once a throttled or debounced slot has been added, so invocations need the clock.
+			bool hasTimedSlots;
+
+			/// The slots disconnected since the last compaction, left in place so a disconnection costs no shifting.
+			size_t deadSlots;
+
+			FederateErrorPolicy errorPolicy;
+			std::function<void(const FederateError&)> errorHandler;
+			std::vector<FederateError> collectedErrors;
+			FederateReclaimer* reclaimer;
+
+			/// Functions per asynchronous task, or 0 to adapt to "asyncCost", the average nanoseconds per function.
+			size_t asyncGrain;
+			std::shared_ptr<std::atomic<uint64_t>> asyncCost;
+
+			/// The tasks started by "runBatches" which may still be running.  Destroying them waits for them.
+			std::vector<std::future<void>> asyncTasks;
+
+			/// The size of "asyncTasks" at which "runBatches" next drops the finished tasks.
+			size_t asyncPruneAt;
+
+			std::shared_ptr<FederateExecutor> executor;
+
+			size_t reorderInterval;
+			size_t reorderCountdown;
+
+			/// Connections made by "connect".  Only read or changed under the topology mutex.
+			std::vector<FederateCore*> downstream;
+			std::vector<FederateCore*> upstream;
+
+			/// True once this Federate has been connected, so destruction takes the topology mutex to undo it.
+			std::atomic<bool> linked;
+
+			/// Counts the connection changes below this Federate.  Only changed under the topology mutex.
+			std::atomic<uint64_t> topologyGeneration;
+
+			/// Every Federate downstream of this one, flattened, as of "dispatchGeneration".  Only used under the lock.
+			std::vector<FederateCore*> dispatch;
+			uint64_t dispatchGeneration;
+
+			/// The generation of the dispatch list an invocation of this ThreadSafe Federate is walking, or 0.
+			std::atomic<uint64_t> activeWalk;
+
+			/// The disconnections waiting for this Federate's walks.  It is not destroyed until they have finished.
+			std::atomic<uint32_t> watchers;
+
+			/// The recorder and waiters, once one is used.
+			std::atomic<TypedExtension*> typed;
+		};
+
+		FederateCore() : ext(nullptr)
+		{
+		}
+
+		///
+		/// Moves the settings and slot state.  Connections to and from "x" are moved to this Federate.
+		/// Not thread safe: nothing else may use "x" during the move.
+		///
+		FederateCore(FederateCore&& x) : ext(nullptr)
+		{
+			this->moveSettings(x);
+			this->attachScoped();
+			this->takeConnections(x);
+		}
+
+		FederateCore(const FederateCore&) = delete;
+		FederateCore& operator=(const FederateCore&) = delete;
+		FederateCore& operator=(FederateCore&&) = delete;
+
+		///
+		/// Disconnects this Federate from everything upstream and downstream of it, waiting for the invocations of
+		/// ThreadSafe Federates upstream of it which may still reach it to finish.  It must not be destroyed from one
+		/// of those invocations.
+		///
+		~FederateCore()
+		{
+			this->detachScoped();
+			this->disconnectAll();
+			delete this->ext.load(std::memory_order_acquire);
+		}
+
+		///
+		/// Returns the extension, or nullptr if nothing has needed it yet.
+		///
+		Extension* extension() const
+		{
+			return this->ext.load(std::memory_order_acquire);
+		}
+
+		///
+		/// Returns the extension, allocating it the first time.  Safe without the lock, as "connect" extends the
+		/// Federates it connects: if two threads race, one allocation wins and the other is dropped.
+		///
+		Extension& extend()
+		{
+			auto current = this->ext.load(std::memory_order_acquire);
+
+			if(current != nullptr)
+			{
+				return *current;
+			}
+
+			std::unique_ptr<Extension> fresh(new Extension());
+
+			if(this->ext.compare_exchange_strong(current, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire) == true)
+			{
+				return *fresh.release();
+			}
+
+			return *current;
+		}
+
+		///
+		/// Copies the settings and slot state of "x", for a copy of it.  The copy has no connections, scoped
+		/// connections, collected errors or waiters.  The caller must hold the lock of "x".
+		///
+		void copySettings(const FederateCore& x)
+		{
+			auto from = x.extension();
+
+			if(from == nullptr)
+			{
+				return;
+			}
+
+			auto& e = this->extend();
+			e.timers = from->timers;
+			e.hasTimedSlots = from->hasTimedSlots;
+			e.deadSlots = from->deadSlots;
+			e.errorPolicy = from->errorPolicy;
+			e.errorHandler = from->errorHandler;
+			e.reclaimer = from->reclaimer;
+			e.asyncGrain = from->asyncGrain;
+			e.executor = from->executor;
+			e.reorderInterval = from->reorderInterval;
+			e.reorderCountdown = from->reorderCountdown;
+			e.slotInfo = from->slotInfo;
+
+			for(auto& info : e.slotInfo)
+			{
+				info.connection = nullptr;
+			}
+		}
+
+		///
+		/// Takes the settings and slot state of "x", for a move, once this Federate's own scoped connections are
+		/// detached and its own tasks taken out, to be waited for once the lock is released.  The caller must hold the
+		/// lock.  The connections, the recorder and the waiters are not taken here.
+		///
+		void moveSettings(FederateCore& x)
+		{
+			auto from = x.extension();
+
+			if(from == nullptr)
+			{
+				auto e = this->extension();
+
+				if(e != nullptr)
+				{
+					this->resetSlotInfo(0);
+					e->errorPolicy = FederateErrorPolicy::Propagate;
+					e->errorHandler = nullptr;
+					e->collectedErrors.clear();
+					e->reclaimer = nullptr;
+					e->asyncGrain = 1;
+					e->asyncCost = nullptr;
+					e->executor = nullptr;
+					e->reorderInterval = 0;
+					e->reorderCountdown = 0;
+				}
+
+				return;
+			}
+
+			auto& e = this->extend();
+			e.slotInfo = std::move(from->slotInfo);
+			e.timers = std::move(from->timers);
+			e.hasTimedSlots = from->hasTimedSlots;
+			e.deadSlots = from->deadSlots;
+			from->deadSlots = 0;
+			from->hasTimedSlots = false;
+			e.errorPolicy = from->errorPolicy;
+			e.errorHandler = std::move(from->errorHandler);
+			e.collectedErrors = std::move(from->collectedErrors);
+			e.reclaimer = from->reclaimer;
+			e.asyncGrain = from->asyncGrain;
+			e.asyncCost = std::move(from->asyncCost);
+			e.asyncTasks = std::move(from->asyncTasks);
+			e.asyncPruneAt = from->asyncPruneAt;
+			e.executor = std::move(from->executor);
+			e.reorderInterval = from->reorderInterval;
+			e.reorderCountdown = from->reorderCountdown;
+			e.dispatchGeneration = 0;
+		}
+
+		///
+		/// Moves the tasks started by "runBatches" to "x", to be waited for without the lock.  The caller must hold
+		/// the lock.
+		///
+		void takeTasks(std::vector<std::future<void>>& x)
+		{
+			auto e = this->extension();
+
+			if(e != nullptr)
+			{
+				x.swap(e->asyncTasks);
+			}
+		}
+
+		///
+		/// Returns the reclaimer slots are retired to, or nullptr.  The caller must hold the lock.
+		///
+		FederateReclaimer* slotReclaimer() const
+		{
+			auto e = this->extension();
+			return (e != nullptr) ? e->reclaimer : nullptr;
+		}
+
+		///
+		/// Returns true once a throttled or debounced slot has been added.  The caller must hold the lock.
+		///
+		bool timedSlots() const
+		{
+			auto e = this->extension();
+			return e != nullptr && e->hasTimedSlots == true;
+		}
+
+		///
+		/// Keeps "slotInfo" parallel to the "count" slots, the last of which was just added with "info", once any slot
+		/// needs it.  The caller must hold the lock.
+		///
+		void pushSlotInfo(SlotState info, size_t count)
+		{
+			auto current = this->extension();
+			const auto tracking = current != nullptr && (current->slotInfo.empty() == false || current->reorderInterval != 0);
+
+			if(tracking == false && info.kind == SlotState::Plain && info.connection == nullptr && info.node < 0 && info.pinned == false)
+			{
+				return;
+			}
+
+			auto& e = this->extend();
+			e.hasTimedSlots = e.hasTimedSlots || (info.kind != SlotState::Plain);
+
+			e.slotInfo.resize(count - 1);
+			e.slotInfo.push_back(std::move(info));
+		}
+
+		///
+		/// Keeps "slotInfo" parallel to the "count" slots after slots were appended in bulk.  The caller must hold the lock.
+		///
+		void growSlotInfo(size_t count)
+		{
+			auto e = this->extension();
+
+			if(e != nullptr && (e->slotInfo.empty() == false || e->reorderInterval != 0))
+			{
+				e->slotInfo.resize(count);
+			}
+		}
+
+		///
+		/// Forgets the state of every slot, as the slots have been replaced by "count" new ones.  The caller must hold the lock.
+		///
+		void resetSlotInfo(size_t count)
+		{
+			auto e = this->extension();
+
+			if(e == nullptr)
+			{
+				return;
+			}
+
+			this->detachScoped();
+			e->slotInfo.clear();
+			e->hasTimedSlots = false;
+			e->deadSlots = 0;
+			e->timers.clear();
+
+			if(e->reorderInterval != 0)
+			{
+				e->slotInfo.resize(count);
+			}
+		}
+
+		///
+		/// Marks slot "i", whose function is gone, as dead, to be dropped by the next compaction.  Returns true once
+		/// more than half the slots are dead, when the caller should compact them.  A slot only dies by its scoped
+		/// connection, so it has state.  The caller must hold the lock.
+		///
+		bool killSlotInfo(size_t i)
+		{
+			auto& e = *this->extension();
+			e.slotInfo[i] = SlotState();
+			e.slotInfo[i].kind = SlotState::Dead;
+			++e.deadSlots;
+			return e.deadSlots * 2 > e.slotInfo.size();
+		}
+
+		///
+		/// Returns the number of slots disconnected and not yet compacted away.
+		///
+		size_t deadCount() const
+		{
+			auto e = this->extension();
+			return (e != nullptr) ? e->deadSlots : 0;
+		}
+
+		///
+		/// Returns true if slot "i" was disconnected and not yet compacted away.
+		///
+		bool deadSlot(size_t i) const
+		{
+			auto e = this->extension();
+			return e != nullptr && e->deadSlots != 0 && e->slotInfo[i].kind == SlotState::Dead;
+		}
+
+		///
+		/// Returns the position slot "i" has among the live slots, as reported to the caller.
+		///
+		size_t livePosition(size_t i) const
+		{
+			auto e = this->extension();
+
+			if(e == nullptr || e->deadSlots == 0)
+			{
+				return i;
+			}
+
+			return i - static_cast<size_t>(std::count_if(std::begin(e->slotInfo), std::begin(e->slotInfo) + i, [](const SlotState& info)->bool
+			{
+				return info.kind == SlotState::Dead;
+			}));
+		}
+
+		///
+		/// Moves the state of slot "from" to "to", an earlier position, while compacting the slots.
+		///
+		void moveSlotInfo(size_t from, size_t to)
+		{
+			auto e = this->extension();
+
+			if(e != nullptr && e->slotInfo.empty() == false)
+			{
+				e->slotInfo[to] = std::move(e->slotInfo[from]);
+
+				if(e->slotInfo[to].connection != nullptr)
+				{
+					e->slotInfo[to].connection->index = to;
+				}
+			}
+		}
+
+		///
+		/// Drops the state of the slots from "count" on, after they were compacted, none of them dead any more.
+		///
+		void truncateSlotInfo(size_t count)
+		{
+			auto e = this->extension();
+
+			if(e == nullptr)
+			{
+				return;
+			}
+
+			e->deadSlots = 0;
+
+			if(e->slotInfo.empty() == false)
+			{
+				e->slotInfo.erase(std::begin(e->slotInfo) + count, std::end(e->slotInfo));
+				this->requeueTimers();
+			}
+		}
+
+		///
+		/// Returns the preferred NUMA node of slot "i", or -1.
+		///
+		int slotNode(size_t i) const
+		{
+			auto e = this->extension();
+			return (e == nullptr || e->slotInfo.empty() == true) ? -1 : e->slotInfo[i].node;
+		}
+
+		///
+		/// Reserves room for the state of "n" slots, if any slot has state.
+		///
+		void reserveSlotInfo(size_t n)
+		{
+			auto e = this->extension();
+
+			if(e != nullptr && e->slotInfo.empty() == false)
+			{
+				e->slotInfo.reserve(n);
+			}
+		}
+
+		///
+		/// Releases the unused capacity of the core's own vectors.
+		///
+		void shrinkState()
+		{
+			auto e = this->extension();
+
+			if(e != nullptr)
+			{
+				e->slotInfo.shrink_to_fit();
+				e->timers.shrink_to_fit();
+				e->collectedErrors.shrink_to_fit();
+				e->dispatch.shrink_to_fit();
+			}
+		}
+
+		///
+		/// The memory used by the extension and its vectors, by capacity.
+		///
+		size_t stateMemory() const
+		{
+			auto e = this->extension();
+
+			if(e == nullptr)
+			{
+				return 0;
+			}
+
+			return sizeof(Extension)
+				+ e->slotInfo.capacity() * sizeof(SlotState)
+				+ e->timers.capacity() * sizeof(Timer)
+				+ e->collectedErrors.capacity() * sizeof(FederateError)
+				+ this->topologyMemory(*e);
+		}
+
+		///
+		/// The memory used by the connections and the flattened dispatch list.
+		///
+		static size_t topologyMemory(const Extension& e)
+		{
+			if(e.linked.load(std::memory_order_acquire) == false)
+			{
+				return e.dispatch.capacity() * sizeof(FederateCore*);
+			}
+
+			std::lock_guard<std::mutex> topology(FederateTopology::mutex());
+			return (e.downstream.capacity() + e.upstream.capacity() + e.dispatch.capacity()) * sizeof(FederateCore*);
+		}
+
+		///
+		/// Hands every slot in "vec" to "r", leaving it empty.
+		///
+		template<typename Slots> static void retireTo(FederateReclaimer* r, Slots& vec)
+		{
+			if(vec.empty() == false)
+			{
+				auto retired = std::make_shared<Slots>();
+				retired->swap(vec);
+				r->retire(std::move(retired));
+			}
+		}
+
+		///
+		/// Points "connection" at slot "i", just added with the connection in its state.  The caller must hold the lock.
+		///
+		void bindScoped(FederateScopedConnection& connection, size_t i, void (*manage)(void*, FederateScopedConnection*, FederateScopedConnection*, FederateScopedConnection::Operation))
+		{
+			connection.owner = this;
+			connection.manage = manage;
+			connection.index = i;
+		}
+
+		///
+		/// Marks "self" as disconnected and returns its slot, for a FederateScopedConnection's request.  Returns false
+		/// if the Federate was cleared since the caller looked.  The caller must hold the lock.
+		///
+		static bool claimScoped(FederateScopedConnection* self, size_t& i)
+		{
+			if(self->owner.load() == nullptr)
+			{
+				return false;
+			}
+
+			i = self->index;
+			self->owner = nullptr;
+			return true;
+		}
+
+		///
+		/// Moves the back pointer of slot "i" to "to", which may be nullptr to release the slot for good.
+		/// The caller must hold the lock.
+		///
+		void moveScoped(size_t i, FederateScopedConnection* self, FederateScopedConnection* to)
+		{
+			this->extension()->slotInfo[i].connection = to;
+
+			if(to != nullptr)
+			{
+				to->manage = self->manage;
+				to->index = i;
+				to->owner = static_cast<FederateCore*>(this);
+			}
+		}
+
+		///
+		/// Points every scoped connection at this Federate, after a move.
+		///
+		void attachScoped()
+		{
+			auto e = this->extension();
+
+			if(e == nullptr)
+			{
+				return;
+			}
+
+			for(auto& info : e->slotInfo)
+			{
+				if(info.connection != nullptr)
+				{
+					info.connection->owner = this;
+				}
+			}
+		}
+
+		///
+		/// Marks every scoped connection as disconnected, before its slot goes away.  The caller must hold the lock.
+		///
+		void detachScoped()
+		{
+			auto e = this->extension();
+
+			if(e == nullptr)
+			{
+				return;
+			}
+
+			for(auto& info : e->slotInfo)
+			{
+				if(info.connection != nullptr)
+				{
+					info.connection->owner = nullptr;
+					info.connection = nullptr;
+				}
+			}
+		}
+
+		///
+		/// Starts reordering by hotness every "interval" calls to "invokeFirst", for "count" slots.
+		/// The caller must hold the lock.
+		///
+		void startReordering(size_t interval, size_t count)
+		{
+			if(interval == 0 && this->extension() == nullptr)
+			{
+				return;
+			}
+
+			auto& e = this->extend();
+			e.reorderInterval = interval;
+			e.reorderCountdown = interval;
+
+			// The statistics live in "slotInfo", so keep it parallel to the functions from now on.
+			if(interval != 0)
+			{
+				e.slotInfo.resize(count);
+			}
+		}
+
+		///
+		/// Returns true if "invokeFirst" counts hits for reordering by hotness.  The caller must hold the lock.
+		///
+		bool reorders() const
+		{
+			auto e = this->extension();
+			return e != nullptr && e->reorderInterval != 0;
+		}
+
+		///
+		/// Counts down to the next reorder by hotness of "count" slots.  Returns the new order, as the position each slot
+		/// moves from, or an empty vector if the slots stay where they are.  The caller must hold the lock.
+		///
+		std::vector<size_t> nextHotOrder(size_t count)
+		{
+			auto e = this->extension();
+
+			if(e == nullptr || e->reorderInterval == 0 || --e->reorderCountdown != 0)
+			{
+				return std::vector<size_t>();
+			}
+
+			e->reorderCountdown = e->reorderInterval;
+			return this->hotOrder(*e, count);
+		}
+
+		///
+		/// Stably sorts the unpinned slots by their estimated chance of matching, leaving pinned slots in place, then
+		/// halves the statistics so the order follows changes in traffic.  The slot state is moved already; the caller
+		/// moves the functions by the returned order, which is empty if nothing moves.
+		///
+		std::vector<size_t> hotOrder(Extension& e, size_t n)
+		{
+			std::vector<size_t> movable;
+
+			for(size_t i = 0; i < n; ++i)
+			{
+				if(e.slotInfo[i].pinned == false)
+				{
+					movable.push_back(i);
+				}
+			}
+
+			auto order = movable;
+
+			std::stable_sort(std::begin(order), std::end(order), [&e](size_t a, size_t b)
+			{
+				return FederateCore::hotter(e.slotInfo[a], e.slotInfo[b]);
+			});
+
+			for(auto& info : e.slotInfo)
+			{
+				FederateCore::cool(info);
+			}
+
+			if(order == movable)
+			{
+				return std::vector<size_t>();
+			}
+
+			std::vector<size_t> source(n);
+
+			for(size_t i = 0; i < source.size(); ++i)
+			{
+				source[i] = i;
+			}
+
+			for(size_t k = 0; k < movable.size(); ++k)
+			{
+				source[movable[k]] = order[k];
+			}
+
+			FederateCore::permute(e.slotInfo, source);
+
+			for(size_t i = 0; i < n; ++i)
+			{
+				if(e.slotInfo[i].connection != nullptr)
+				{
+					e.slotInfo[i].connection->index = i;
+				}
+			}
+
+			this->requeueTimers();
+
+			return source;
+		}
+
+		///
+		/// Moves element source[i] of "vec" to position i, unless "vec" is empty.
+		///
+		template<typename Vector> static void permute(Vector& vec, const std::vector<size_t>& source)
+		{
+			if(vec.empty() == true)
+			{
+				return;
+			}
+
+			Vector x;
+			x.reserve(vec.capacity());
+
+			for(auto i : source)
+			{
+				x.push_back(std::move(vec[i]));
+			}
+
+			vec.swap(x);
+		}
+
+		///
+		/// Counts a call of slot "i" by "invokeFirst", and whether it matched, while reordering by hotness.
+		///
+		void countHit(size_t i, bool matched)
+		{
+			auto& info = this->extension()->slotInfo[i];
+			++info.visits;
+
+			if(matched == true)
+			{
+				++info.hits;
+			}
+		}
+
+		///
+		/// Returns true if "x" is more likely to match than "y": (hits + 1) / (visits + 2), compared without dividing,
+		/// so untried slots start at even odds.
+		///
+		static bool hotter(const SlotState& x, const SlotState& y)
+		{
+			return (uint64_t(x.hits) + 1) * (uint64_t(y.visits) + 2) > (uint64_t(y.hits) + 1) * (uint64_t(x.visits) + 2);
+		}
+
+		///
+		/// Halves a slot's statistics after a reorder, so the order follows changes in traffic.
+		///
+		static void cool(SlotState& info)
+		{
+			info.hits /= 2;
+			info.visits /= 2;
+		}
+
+		///
+		/// Adds debounced slot "i" to "timers" at its current deadline.
+		///
+		static void queueTimer(Extension& e, size_t i)
+		{
+			auto& info = e.slotInfo[i];
+			info.queued = true;
+
+			Timer timer;
+			timer.deadline = info.deadline;
+			timer.slot = i;
+			e.timers.push_back(timer);
+			std::push_heap(std::begin(e.timers), std::end(e.timers), &FederateCore::laterTimer);
+		}
+
+		///
+		/// Removes the earliest entry from "timers".  Returns true, with its slot in "i", if the slot's pending call is
+		/// due at "now".  An entry which invocations made early is queued again at the slot's deadline.
+		///
+		bool popTimer(std::chrono::steady_clock::time_point now, size_t& i)
+		{
+			auto& e = *this->extension();
+			std::pop_heap(std::begin(e.timers), std::end(e.timers), &FederateCore::laterTimer);
+			i = e.timers.back().slot;
+			e.timers.pop_back();
+
+			auto& info = e.slotInfo[i];
+			info.queued = false;
+
+			if(!info.pending)
+			{
+				return false;
+			}
+
+			if(info.deadline > now)
+			{
+				FederateCore::queueTimer(e, i);
+				return false;
+			}
+
+			return true;
+		}
+
+		///
+		/// Returns true if the earliest entry in "timers" is due at "now".
+		///
+		bool timerDue(std::chrono::steady_clock::time_point now) const
+		{
+			auto e = this->extension();
+			return e != nullptr && e->timers.empty() == false && e->timers.front().deadline <= now;
+		}
+
+		///
+		/// Rebuilds "timers" from the pending calls, after slots moved.  A pending call always has an entry, so there
+		/// is nothing to do without entries.
+		///
+		void requeueTimers()
+		{
+			auto e = this->extension();
+
+			if(e == nullptr || e->timers.empty() == true)
+			{
+				return;
+			}
+
+			e->timers.clear();
+
+			for(size_t i = 0; i < e->slotInfo.size(); ++i)
+			{
+				e->slotInfo[i].queued = false;
+
+				if(e->slotInfo[i].pending)
+				{
+					FederateCore::queueTimer(*e, i);
+				}
+			}
+		}
+
+		///
+		/// Orders "timers" as a min-heap on the deadline.
+		///
+		static bool laterTimer(const Timer& x, const Timer& y)
+		{
+			return x.deadline > y.deadline;
+		}
+
+		///
+		/// Decides whether timed slot "i" runs at "now".  A debounced slot never does: its deadline moves, and the
+		/// caller binds the invocation's arguments as its pending call.
+		///
+		Admission admitSlot(size_t i, std::chrono::steady_clock::time_point now)
+		{
+			auto& e = *this->extension();
+			auto& info = e.slotInfo[i];
+
+			switch(info.kind)
+			{
+				case SlotState::Throttled:
+					return FederateCore::admitThrottled(info, now) ? Admit : Reject;
+
+				case SlotState::Debounced:
+					info.deadline = now + info.period;
+
+					// A queued entry is due no later than the new deadline; "pollTimers" requeues it if it is early.
+					if(info.queued == false)
+					{
+						FederateCore::queueTimer(e, i);
+					}
+
+					return Defer;
+
+				default:
+					return Admit;
+			}
+		}
+
+		///
+		/// Decides whether a throttled slot runs at "now", counting the call if it does.
+		///
+		static bool admitThrottled(SlotState& info, std::chrono::steady_clock::time_point now)
+		{
+			if(now >= info.deadline)
+			{
+				info.deadline = now + info.period;
+				info.calls = 0;
+			}
+
+			if(info.calls < info.limit)
+			{
+				++info.calls;
+				return true;
+			}
+
+			return false;
+		}
+
+		///
+		/// Where the error policy sends exceptions, if they are to be collected.
+		///
+		std::vector<FederateError>* errorSink()
+		{
+			auto e = this->extension();
+			return (e != nullptr && e->errorPolicy == FederateErrorPolicy::Collect) ? &e->collectedErrors : nullptr;
+		}
+
+		///
+		/// Returns true if exceptions are collected into "errors" or handled rather than propagated.
+		///
+		bool isolatesErrors(std::vector<FederateError>* errors) const
+		{
+			if(errors != nullptr)
+			{
+				return true;
+			}
+
+			auto e = this->extension();
+			return e != nullptr && e->errorPolicy == FederateErrorPolicy::Handler && e->errorHandler;
+		}
+
+		///
+		/// Records the exception being handled, thrown by slot "i".  Only call this from a catch block.
+		///
+		void reportError(size_t i, std::vector<FederateError>* errors)
+		{
+			FederateError error;
+			error.slot = this->livePosition(i);
+			error.error = std::current_exception();
+
+			if(errors != nullptr)
+			{
+				errors->push_back(error);
+			}
+			else
+			{
+				this->extension()->errorHandler(error);
+			}
+		}
+
+		///
+		/// Makes "x" part of this Federate, for "connect".  Returns false, and changes nothing, if that would make a cycle.
+		///
+		bool connectTo(FederateCore& x)
+		{
+			auto& e = this->extend();
+			auto& xe = x.extend();
+
+			std::lock_guard<std::mutex> topology(FederateTopology::mutex());
+
+			if(&x == this || x.reaches(this) == true)
+			{
+				return false;
+			}
+
+			e.downstream.push_back(&x);
+			xe.upstream.push_back(this);
+			e.linked.store(true, std::memory_order_release);
+			xe.linked.store(true, std::memory_order_release);
+			this->invalidateUpstream(nullptr);
+			return true;
+		}
+
+		///
+		/// Removes one connection made by "connectTo".  Returns false if "x" was not connected.
+		///
+		bool disconnectFrom(FederateCore& x)
+		{
+			auto e = this->extension();
+
+			if(e == nullptr)
+			{
+				return false;
+			}
+
+			std::lock_guard<std::mutex> topology(FederateTopology::mutex());
+
+			auto found = std::find(std::begin(e->downstream), std::end(e->downstream), &x);
+
+			if(found == std::end(e->downstream))
+			{
+				return false;
+			}
+
+			auto& upstream = x.extension()->upstream;
+			e->downstream.erase(found);
+			upstream.erase(std::find(std::begin(upstream), std::end(upstream), this));
+			this->invalidateUpstream(nullptr);
+			return true;
+		}
+
+		///
+		/// Moves the connections to and from "x" to this Federate, which has none.  Returns once no invocation upstream
+		/// can still reach "x".
+		///
+		void takeConnections(FederateCore& x)
+		{
+			auto from = x.extension();
+
+			if(from == nullptr || from->linked.load(std::memory_order_acquire) == false)
+			{
+				return;
+			}
+
+			auto& e = this->extend();
+			std::vector<std::pair<FederateCore*, uint64_t>> watched;
+
+			{
+				std::lock_guard<std::mutex> topology(FederateTopology::mutex());
+
+				e.upstream.swap(from->upstream);
+				e.downstream.swap(from->downstream);
+				e.linked.store(true, std::memory_order_release);
+
+				for(auto node : e.upstream)
+				{
+					auto& down = node->extension()->downstream;
+					std::replace(std::begin(down), std::end(down), &x, this);
+				}
+
+				for(auto node : e.downstream)
+				{
+					auto& up = node->extension()->upstream;
+					std::replace(std::begin(up), std::end(up), &x, this);
+				}
+
+				from->topologyGeneration.fetch_add(1);
+				e.topologyGeneration.fetch_add(1);
+
+				for(auto node : e.upstream)
+				{
+					node->invalidateUpstream(&watched);
+				}
+			}
+
+			FederateCore::awaitWalks(watched);
+		}
+
+		///
+		/// Disconnects this Federate from everything upstream and downstream of it.  Returns once no invocation
+		/// upstream can still reach it, and nothing is waiting on its own invocations.
+		///
+		void disconnectAll()
+		{
+			auto e = this->extension();
+
+			if(e == nullptr || e->linked.load(std::memory_order_acquire) == false)
+			{
+				return;
+			}
+
+			std::vector<std::pair<FederateCore*, uint64_t>> watched;
+
+			{
+				std::lock_guard<std::mutex> topology(FederateTopology::mutex());
+
+				std::vector<FederateCore*> formerUpstream;
+				formerUpstream.swap(e->upstream);
+
+				for(auto node : formerUpstream)
+				{
+					auto& down = node->extension()->downstream;
+					down.erase(std::remove(std::begin(down), std::end(down), this), std::end(down));
+				}
+
+				for(auto node : e->downstream)
+				{
+					auto& up = node->extension()->upstream;
+					up.erase(std::remove(std::begin(up), std::end(up), this), std::end(up));
+				}
+
+				e->downstream.clear();
+				e->topologyGeneration.fetch_add(1);
+
+				for(auto node : formerUpstream)
+				{
+					node->invalidateUpstream(&watched);
+				}
+			}
+
+			FederateCore::awaitWalks(watched);
+
+			// Another disconnection may still be reading this Federate's walk, having found it upstream of itself.
+			while(e->watchers.load(std::memory_order_acquire) != 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		///
+		/// Counts a change below this Federate, and below each Federate upstream of it, so their next invocations
+		/// rebuild their dispatch lists.  Takes no lock but the topology mutex, which the caller must hold, so a
+		/// function may connect and disconnect Federates in the middle of an invocation.  When "watched" is not null,
+		/// each Federate is added to it with its new generation, to wait for the walks of older lists; see "awaitWalks".
+		///
+		void invalidateUpstream(std::vector<std::pair<FederateCore*, uint64_t>>* watched)
+		{
+			auto& e = *this->extension();
+			const auto generation = e.topologyGeneration.fetch_add(1) + 1;
+
+			if(watched != nullptr)
+			{
+				e.watchers.fetch_add(1);
+				watched->emplace_back(this, generation);
+			}
+
+			for(auto node : e.upstream)
+			{
+				node->invalidateUpstream(watched);
+			}
+		}
+
+		///
+		/// Waits until none of the Federates in "watched" is walking a dispatch list older than its generation there,
+		/// then lets them go.  Call it without the topology mutex: a walk may be waiting for a lock held by an
+		/// invocation which is about to rebuild its own list.
+		///
+		static void awaitWalks(std::vector<std::pair<FederateCore*, uint64_t>>& watched)
+		{
+			for(auto& entry : watched)
+			{
+				auto& e = *entry.first->extension();
+
+				for(;;)
+				{
+					const auto walking = e.activeWalk.load();
+
+					if(walking == 0 || walking >= entry.second)
+					{
+						break;
+					}
+
+					std::this_thread::yield();
+				}
+
+				e.watchers.fetch_sub(1, std::memory_order_release);
+			}
+		}
+
+		///
+		/// Brings the flattened list of downstream Federates up to date and, if "threadSafe", publishes its generation
+		/// as being walked until "endWalk", so that a disconnection which frees a Federate on it waits.  Returns false,
+		/// with nothing to end, if nothing is downstream.  The caller must hold the lock.
+		///
+		bool beginWalk(bool threadSafe)
+		{
+			auto e = this->extension();
+
+			if(e == nullptr || e->linked.load(std::memory_order_acquire) == false)
+			{
+				return false;
+			}
+
+			for(;;)
+			{
+				this->refreshDispatch(*e);
+
+				if(e->dispatch.empty() == true)
+				{
+					return false;
+				}
+
+				if(threadSafe == false)
+				{
+					return true;
+				}
+
+				// Either the disconnection sees this walk, or this sees its new generation and rebuilds the list.
+				e->activeWalk.store(e->dispatchGeneration);
+
+				if(e->topologyGeneration.load() == e->dispatchGeneration)
+				{
+					return true;
+				}
+
+				e->activeWalk.store(0, std::memory_order_release);
+			}
+		}
+
+		void endWalk()
+		{
+			this->extension()->activeWalk.store(0, std::memory_order_release);
+		}
+
+		///
+		/// Rebuilds the flattened list of downstream Federates if a connection below this one has changed.  The caller
+		/// must hold the lock.
+		///
+		void refreshDispatch(Extension& e)
+		{
+			if(e.topologyGeneration.load(std::memory_order_acquire) != e.dispatchGeneration)
+			{
+				std::lock_guard<std::mutex> topology(FederateTopology::mutex());
+
+				e.dispatch.clear();
+				this->appendDownstream(e.dispatch);
+				e.dispatchGeneration = e.topologyGeneration.load(std::memory_order_relaxed);
+			}
+		}
+
+		///
+		/// Appends every Federate downstream of this one, depth first.  The caller must hold the topology mutex.
+		///
+		void appendDownstream(std::vector<FederateCore*>& nodes) const
+		{
+			for(auto node : this->extension()->downstream)
+			{
+				nodes.push_back(node);
+				node->appendDownstream(nodes);
+			}
+		}
+
+		///
+		/// Returns true if "x" is this Federate or downstream of it.  The caller must hold the topology mutex.
+		///
+		bool reaches(const FederateCore* x) const
+		{
+			if(x == this)
+			{
+				return true;
+			}
+
+			for(auto node : this->extension()->downstream)
+			{
+				if(node->reaches(x) == true)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		///
+		/// Picks how many functions each asynchronous task calls.
+		///
+		size_t asyncGrainFor(size_t n) const
+		{
+			auto e = this->extension();
+			const auto fixed = (e != nullptr) ? e->asyncGrain : 1;
+
+			if(fixed != 0 || n == 0)
+			{
+				return (std::max)(fixed, size_t(1));
+			}
+
+			// Aim for tasks long enough that starting one is a small fraction of running it.
+			const uint64_t target = 50000;
+			const auto cost = (e->asyncCost != nullptr) ? e->asyncCost->load(std::memory_order_relaxed) : 0;
+
+			if(cost >= target)
+			{
+				return 1;
+			}
+
+			// Never use more tasks than there are cores to run them.
+			const auto workers = FederateCore::hardwareThreads();
+			auto grain = (n + workers - 1) / workers;
+
+			if(cost != 0)
+			{
+				grain = (std::max)(grain, static_cast<size_t>(target / cost));
+			}
+
+			return (std::min)(grain, n);
+		}
+
+		///
+		/// The number of threads the hardware runs at once, at least 1.  Read once: the call is not free.
+		///
+		static size_t hardwareThreads()
+		{
+			static const size_t threads = (std::max)(std::thread::hardware_concurrency(), 1u);
+			return threads;
+		}
+
+		///
+		/// Calls "call(i)" for every i below "n" on new threads, "grain" calls per thread, and folds the time per call
+		/// into "asyncCost" when the grain adapts.  Each thread has its own copy of "call".
+		/// The Federate owns the threads and waits for them when it is destroyed, as a future from std::async would;
+		/// they may outlive the futures and the Federate's functions, so "call" must own everything it uses.
+		///
+		void runBatches(size_t n, size_t grain, std::function<void(size_t)> call)
+		{
+			auto& e = this->extend();
+			auto cost = e.asyncCost;
+
+			// Forget the tasks which have finished once the list has doubled since the last time, so that it only grows
+			// with the tasks still running and each task is looked at a constant number of times on average.
+			if(e.asyncTasks.size() >= e.asyncPruneAt)
+			{
+				e.asyncTasks.erase(std::remove_if(std::begin(e.asyncTasks), std::end(e.asyncTasks), [](const std::future<void>& x)
+				{
+					return x.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+				}), std::end(e.asyncTasks));
+
+				e.asyncPruneAt = (std::max)(e.asyncTasks.size() * 2, size_t(FederateCore::MinPruneAt));
+			}
+
+			for(size_t first = 0; first < n; first += grain)
+			{
+				const auto last = (std::min)(first + grain, n);
+
+				e.asyncTasks.push_back(std::async(std::launch::async, [call, first, last, cost]() mutable
+				{
+					const auto start = std::chrono::steady_clock::now();
+
+					for(auto i = first; i < last; ++i)
+					{
+						call(i);
+					}
+
+					FederateCore::foldCost(cost, start, last - first);
+				}));
+			}
+		}
+
+		///
+		/// Calls "call(i)" for the index of every entry of "order", a preferred node and an index, on the executor.  The
+		/// entries are sorted so that a node's calls are adjacent and in order, then batched by the grain size into one
+		/// task per batch, run on the batch's node.  Each task has its own copy of "call", which must own everything it uses.
+		///
+		void runOnExecutor(std::vector<std::pair<int, size_t>> order, std::function<void(size_t)> call)
+		{
+			std::sort(std::begin(order), std::end(order));
+
+			auto& e = *this->extension();
+			auto sorted = std::make_shared<std::vector<std::pair<int, size_t>>>(std::move(order));
+			const auto grain = this->asyncGrainFor(sorted->size());
+			auto cost = e.asyncCost;
+
+			for(size_t first = 0; first < sorted->size();)
+			{
+				const auto node = (*sorted)[first].first;
+				auto last = first + 1;
+
+				while(last < sorted->size() && last - first < grain && (*sorted)[last].first == node)
+				{
+					++last;
+				}
+
+				e.executor->execute([call, sorted, first, last, cost]() mutable
+				{
+					const auto start = std::chrono::steady_clock::now();
+
+					for(auto i = first; i < last; ++i)
+					{
+						call((*sorted)[i].second);
+					}
+
+					FederateCore::foldCost(cost, start, last - first);
+				}, node);
+
+				first = last;
+			}
+		}
+
+		///
+		/// Folds the time per call of a task that made "calls" calls since "start" into "cost", if the grain adapts.
+		///
+		static void foldCost(const std::shared_ptr<std::atomic<uint64_t>>& cost, std::chrono::steady_clock::time_point start, size_t calls)
+		{
+			if(cost != nullptr)
+			{
+				const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				const auto sample = static_cast<uint64_t>(elapsed) / calls;
+				const auto average = cost->load(std::memory_order_relaxed);
+				cost->store((average == 0) ? sample : (average * 7 + sample) / 8, std::memory_order_relaxed);
+			}
+		}
+
+	private:
+		/// Everything but the functions, once anything needs it.  See "extend".
+		std::atomic<Extension*> ext;
+};
+
+///
+/// Base class for all Federate classes.
+/// This consolodates some of the copy-paste implementation that would otherwise be required.
+///
+/// The functions are kept here, contiguous and by value: owned when not tracked, weak references to the Trackers'
+/// functions when tracked.  The loops walk them by position and call each one directly.  Everything else, which
+/// does not need the signature, is in FederateCore.
+///
+/// Asynchronous invocations ("invokeAsync", "invokeAsyncInto") share each function with the Federate: a task holds a
+/// reference to the function, not a copy, whether it is tracked or not and whether it can be copied or not.  Only
+/// they share: the first one moves a function stored in place to a heap block its tasks can reference, and serial
+/// invocations never allocate for the functions.  Tasks of one invocation, of later invocations and serial
+/// invocations may all call the same function at once, so a function with state must be safe to call concurrently
+/// to be invoked asynchronously.  In exchange, the Federate may be cleared, and its functions removed, while the
+/// futures are pending.  Destroying it waits for its tasks, as dropping the futures of std::async would.
+///
+template<typename FederateFunction, bool Tracked, bool ThreadSafe> class FederateBase : public FederateCore
+{
+	public:
+		typedef std::shared_ptr<FederateFunction> Tracker;
+		typedef std::weak_ptr<FederateFunction> WeakTracker;
+		typedef typename FederateFunctionTraits<FederateFunction>::ResultType ResultType;
+
+		/// What the dispatch loops hand to each call: the function, which the slot keeps alive for the call.
+		typedef FederateFunction Slot;
+
+		/// What an asynchronous call holds: a reference to the function, shared with the Federate.  See "asyncSlot".
+		typedef typename std::conditional<Tracked, Tracker, FederateFunction>::type AsyncSlot;
+
+		/// Returned by push_back and its variants.
+		typedef typename std::conditional<Tracked, Tracker, void>::type PushResult;
+
+		/// Called with the arguments of every invocation, before any function, while recording.  See "setRecorder".
+		typedef typename FederateRecordHook<FederateFunction>::type Recorder;
+
+		/// The arguments of an invocation, by value.  See "waitNext".
+		typedef typename FederateArguments<FederateFunction>::type Arguments;
+
+		/// Returned by assign and push_back_range: a Tracker per function added, when tracked.
+		typedef typename std::conditional<Tracked, std::vector<Tracker>, void>::type PushRangeResult;
+
+	protected:
+		///
+		/// The recorder and the waiters, in the extension, allocated the first time either is used.
+		///
+		struct Extras : FederateCore::TypedExtension
+		{
+			Recorder recorder;
+
+			/// Not moved: threads waiting on a Federate being moved from stay with it.
+			typename std::conditional<FederateCopyableArguments<FederateFunction>::value, FederateWaiters<Arguments>, FederateWaiters<void>>::type waiters;
+		};
+
+	public:
+		FederateBase()
+		{
+		}
+
+		///
+		/// Copies the functions and settings of "x" under its lock.  Non-tracked functions are copied, except move-only
+		/// ones, which the copies share.  Tracked functions are shared, as their Trackers own them.
+		/// The copy has no connections, scoped connections, collected errors or waiters.
+		///
+		FederateBase(const FederateBase& x) : FederateCore()
+		{
+			auto scopedLock = x.lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			this->copySettings(x);
+			this->functions = x.functions;
+
+			auto from = x.extras();
+
+			if(from != nullptr && from->recorder)
+			{
+				this->extendExtras().recorder = from->recorder;
+			}
+		}
+
+		///
+		/// Moves the functions and settings.  Connections to and from "x" are moved to this Federate.
+		/// Not thread safe: nothing else may use "x" during the move.
+		///
+		FederateBase(FederateBase&& x) : FederateCore(std::move(x)), functions(std::move(x.functions))
+		{
+			this->takeRecorder(x);
+		}
+
+		///
+		/// Disconnects this Federate before its functions go, so nothing upstream reaches them.
+		///
+		~FederateBase()
+		{
+			this->detachScoped();
+			this->disconnectAll();
+		}
+
+		///
+		/// Replaces the functions and settings with copies of those of "x", as the copy constructor makes them.
+		/// This Federate's own functions are destroyed (or retired) and its connections and scoped connections dropped.
+		///
+		FederateBase& operator=(const FederateBase& x)
+		{
+			if(this != &x)
+			{
+				FederateBase copy(x);
+				*this = std::move(copy);
+			}
+
+			return *this;
+		}
+
+		///
+		/// Replaces the functions and settings with those of "x", and takes over its connections, as the move
+		/// constructor does.  This Federate's own functions are destroyed (or retired) and its connections and scoped
+		/// connections dropped.  Not thread safe: nothing else may use "x" during the move.
+		///
+		FederateBase& operator=(FederateBase&& x)
+		{
+			if(this == &x)
+			{
+				return *this;
+			}
+
+			this->disconnectAll();
+
+			// Destroyed after the lock is released, unless retired.  Destroying the tasks waits for them, and they may
+			// need the lock to finish.
+			std::vector<std::future<void>> oldTasks;
+			decltype(this->functions) old;
+
+			{
+				auto scopedLock = this->lock.acquire();
+				SuppressWarningUnusedVariable(scopedLock);
+
+				this->detachScoped();
+				old.vec.swap(this->functions.vec);
+				this->takeTasks(oldTasks);
+
+				auto r = this->slotReclaimer();
+				this->functions = std::move(x.functions);
+				this->takeRecorder(x);
+				this->moveSettings(x);
+
+				if(r != nullptr)
+				{
+					FederateCore::retireTo(r, old.vec);
+				}
+			}
+
+			this->attachScoped();
+			this->takeConnections(x);
+			return *this;
+		}
+
+		///
+		/// Defers the destruction of slots released by this Federate to "r".  Pass nullptr to destroy them in place.
+		/// Slots released by "clear" or "erase", and tracked slots whose last reference goes anywhere (a Tracker, an
+		/// in-flight invocation), are retired.
+		///
+		void setReclaimer(FederateReclaimer* r)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			if(r != nullptr || this->extension() != nullptr)
+			{
+				this->extend().reclaimer = r;
+			}
+
+			FederateBase::publishReclaimer(this->functions, r);
+		}
+
+		///
+		/// Sets how many functions each task started by "invokeAsync" calls.  1, the default, starts a task per function:
+		/// without an executor that is one std::async thread per function per invocation, which only pays off for
+		/// functions that block or run for a long time.  0 picks the grain from the measured cost of the functions:
+		/// cheap functions are batched into at most a task per core, so the cost of starting tasks is amortized, while
+		/// expensive functions still get a task each.
+		/// Every function still has its own future, which holds its result or exception.
+		///
+		void setAsyncGrainSize(size_t n)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			auto& e = this->extend();
+			e.asyncGrain = n;
+
+			if(n == 0 && e.asyncCost == nullptr)
+			{
+				e.asyncCost = std::make_shared<std::atomic<uint64_t>>(0);
+			}
+		}
+
+		///
+		/// Runs the functions started by "invokeAsync" on "x", each on the node it was added for.  Functions preferring
+		/// the same node are batched by the grain size (see "setAsyncGrainSize") into one task per batch.
+		/// Pass nullptr to go back to a thread per task.
+		///
+		void setExecutor(std::shared_ptr<FederateExecutor> x)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			this->extend().executor = std::move(x);
+		}
+
+		///
+		/// Sets how serial invocations handle a function that throws.
+		///
+		void setErrorPolicy(FederateErrorPolicy x)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			this->extend().errorPolicy = x;
+		}
+
+		///
+		/// Sets the handler used by FederateErrorPolicy::Handler.  Without one, errors propagate.
+		///
+		void setErrorHandler(std::function<void(const FederateError&)> x)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			this->extend().errorHandler = std::move(x);
+		}
+
+		///
+		/// Returns and forgets the errors kept under FederateErrorPolicy::Collect.
+		///
+		std::vector<FederateError> takeErrors()
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			std::vector<FederateError> x;
+			auto e = this->extension();
+
+			if(e != nullptr)
+			{
+				x.swap(e->collectedErrors);
+			}
+
+			return x;
+		}
+
+		///
+		/// Adds a new function to the end of the Federate.
+		/// Non-Tracked Version.
+		///
+		template<bool T = Tracked, typename = typename std::enable_if<!T>::type>
+		void push_back(FederateFunction f)
+		{
+			this->pushSlot(std::move(f), SlotState(), std::false_type());
+		}
+
+		///
+		/// Adds a new function to the end of the Federate.
+		/// Tracked Version.
+		///
+		template<bool T = Tracked, typename = typename std::enable_if<T>::type>
+		Tracker push_back(FederateFunction f)
+		{
+			return this->pushSlot(std::move(f), SlotState(), std::true_type());
+		}
+
+		///
+		/// Adds a new function to the end of the Federate, which is removed when the returned connection is destroyed.
+		/// The function is stored by value like any other, and the connection only holds its position, so connecting
+		/// and disconnecting allocate nothing beyond the growth of the Federate's vectors.
+		/// Non-Tracked Version.
+		///
+		template<bool T = Tracked, typename = typename std::enable_if<!T>::type>
+		FederateScopedConnection push_back_scoped(FederateFunction f)
+		{
+			FederateScopedConnection connection;
+			this->insertScoped(std::move(f), connection);
+			return connection;
+		}
+
+		///
+		/// Replaces every function in the Federate with the functions in [first, last).
+		/// The new list is built without the lock, then swapped in under one lock acquisition, so a concurrent invoke
+		/// sees either the old functions or the new ones and never a mix.  The old functions are destroyed after the lock
+		/// is released, or retired to the reclaimer if one is set.
+		///
+		template<typename Iterator> PushRangeResult assign(Iterator first, Iterator last)
+		{
+			return this->pushRange(first, last, true, std::integral_constant<bool, Tracked>());
+		}
+
+		///
+		/// Adds the functions in [first, last) to the end of the Federate under one lock acquisition.
+		///
+		template<typename Iterator> PushRangeResult push_back_range(Iterator first, Iterator last)
+		{
+			return this->pushRange(first, last, false, std::integral_constant<bool, Tracked>());
+		}
+
+		///
+		/// Adds a function which is called at most "maxCalls" times per "interval".
+		/// Invocations beyond the limit skip it, so it contributes no result to them.
+		///
+		PushResult push_back_throttled(FederateFunction f, size_t maxCalls, std::chrono::steady_clock::duration interval)
+		{
+			SlotState info;
+			info.kind = SlotState::Throttled;
+			info.limit = maxCalls;
+			info.period = interval;
+			return this->pushSlot(std::move(f), std::move(info), std::integral_constant<bool, Tracked>());
+		}
+
+		///
+		/// Adds a function which is only called once invocations have been quiet for "quiet", with the latest arguments.
+		///
+		/// The function never fires unless the caller runs "pollTimers".  Invocations only rebind the deferred call, and
+		/// nothing in the Federate, its executor or its connections drives the timer: call "pollTimers" from a frame
+		/// loop, a periodic timer or an idle handler, at least as often as the latency you can accept.
+		///
+		PushResult push_back_debounced(FederateFunction f, std::chrono::steady_clock::duration quiet)
+		{
+			static_assert(FederateCopyableArguments<FederateFunction>::value, "push_back_debounced keeps the latest arguments, so they must be copy-constructible.");
+
+			SlotState info;
+			info.kind = SlotState::Debounced;
+			info.period = quiet;
+			return this->pushSlot(std::move(f), std::move(info), std::integral_constant<bool, Tracked>());
+		}
+
+		///
+		/// Adds a function which prefers to run on NUMA node "node" when invoked asynchronously through an executor.
+		/// Serial invocations call it in place, as any other.
+		///
+		PushResult push_back_on_node(FederateFunction f, int node)
+		{
+			SlotState info;
+			info.node = node;
+			return this->pushSlot(std::move(f), std::move(info), std::integral_constant<bool, Tracked>());
+		}
+
+		///
+		/// Adds a function which reordering by hotness never moves, such as a catch-all at the end of a filter chain.
+		///
+		PushResult push_back_pinned(FederateFunction f)
+		{
+			SlotState info;
+			info.pinned = true;
+			return this->pushSlot(std::move(f), std::move(info), std::integral_constant<bool, Tracked>());
+		}
+
+		///
+		/// Reorders the functions by hotness every "interval" calls to "invokeFirst": those whose results are most
+		/// often true move ahead of those which usually reject, so fewer run before a match.  Pinned functions keep
+		/// their positions, and ties keep their current order.  0, the default, turns reordering off.
+		/// Reordering changes the order of the results of "invoke" and the positions in FederateError.
+		///
+		void setHotReordering(size_t interval)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			this->startReordering(interval, this->functions.vec.size());
+		}
+
+		///
+		/// Makes every debounced call that has come due.  Returns the number of functions called.
+		/// The pending calls are kept in a heap by deadline, so a poll costs O(log n) per due call and only compares one
+		/// deadline when nothing is due: it can be called from a frame loop or a periodic timer.
+		/// It is the only thing that calls debounced functions; see "push_back_debounced".
+		///
+		size_t pollTimers()
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			const auto now = std::chrono::steady_clock::now();
+
+			if(this->timerDue(now) == false)
+			{
+				return 0;
+			}
+
+			size_t fired = 0;
+			auto errors = this->errorSink();
+			const auto isolate = this->isolatesErrors(errors);
+
+			while(this->timerDue(now) == true)
+			{
+				size_t i = 0;
+
+				if(this->popTimer(now, i) == false)
+				{
+					continue;
+				}
+
+				if(isolate == false)
+				{
+					fired += this->callPending(i) ? 1 : 0;
+					continue;
+				}
+
+				try
+				{
+					fired += this->callPending(i) ? 1 : 0;
+				}
+				catch(...)
+				{
+					this->reportError(i, errors);
+				}
+			}
+
+			return fired;
+		}
+
+		///
+		/// Reserves room for "n" functions, so adding up to that many does not reallocate.
+		///
+		void reserve(size_t n)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			this->functions.vec.reserve(n);
+			this->reserveSlotInfo(n);
+		}
+
+		///
+		/// Releases unused capacity.  For tracked Federates, call "clean" first to drop expired functions.
+		///
+		void shrink_to_fit()
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			this->functions.vec.shrink_to_fit();
+			this->shrinkState();
+		}
+
+		///
+		/// Returns the memory this Federate is using.
+		///
+		FederateMemoryUsage memoryUsage() const
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			FederateMemoryUsage x;
+			x.slots = this->functions.vec.capacity() * sizeof(this->functions.vec[0]) + this->stateMemory();
+			this->measureSlots(x);
+			return x;
+		}
+
+		///
+		/// Returns the number of functions in the Federate.
+		///
+		size_t size() const
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			return this->functions.vec.size() - this->deadCount();
+		}
+
+		///
+		/// Clears the functions in the Federate.
+		///
+		void clear()
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			auto r = this->slotReclaimer();
+
+			if(r != nullptr)
+			{
+				FederateCore::retireTo(r, this->functions.vec);
+			}
+			else
+			{
+				this->functions.vec.clear();
+			}
+
+			this->resetSlotInfo(0);
+		}
+
+		///
+		/// Returns true if the Federate is empty.
+		///
+		bool empty() const
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			return this->functions.vec.size() == this->deadCount();
+		}
+
+		///
+		/// Determines how many tracked objects are expired.
+		/// The non-tracked version will always return 0.
+		///
+		size_t garbageSize() const
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			return std::count_if(std::begin(this->functions.vec), std::end(this->functions.vec), [](const StoredSlot& f)->bool
+			{
+				return FederateBase::expired(f);
+			});
+		}
+
+		///
+		/// Removes all tracked objects that are expired.
+		///
+		void clean()
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			this->cleanExpired();
+		}
+
+		///
+		/// Makes "downstream" part of this Federate: invoking this Federate also calls the downstream Federate's functions,
+		/// after its own, as if they had been added here.  This replaces relaying with a function which invokes "downstream".
+		///
+		/// Chains are flattened into one list of Federates, rebuilt only when a connection below this one changes, so a
+		/// deep relay chain costs one more walk per Federate and no extra function call, lock hop or result vector.
+		/// A downstream Federate may be destroyed while this one is invoked from another thread: its destruction waits.
+		/// A function may connect and disconnect Federates, this one included, while it is invoked; the change takes
+		/// effect from the next invocation.
+		/// Downstream functions run under the downstream Federate's lock and slot state, and this Federate's error policy.
+		/// "invokeLazy" and "pollTimers" only cover this Federate's own functions.
+		///
+		/// Returns false, and changes nothing, if the connection would make a cycle.
+		///
+		bool connect(FederateBase& x)
+		{
+			return this->connectTo(x);
+		}
+
+		///
+		/// Removes one connection made by "connect".  Returns false if "downstream" was not connected.
+		///
+		bool disconnect(FederateBase& x)
+		{
+			return this->disconnectFrom(x);
+		}
+
+		///
+		/// Calls "r" with the arguments of every invocation (serial, asynchronous, checked, lazy or coroutine) before
+		/// any function runs, for example to write them to a FederateRecorder.  Pass nullptr to stop recording.
+		///
+		void setRecorder(Recorder r)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			if(r || this->extras() != nullptr)
+			{
+				this->extendExtras().recorder = std::move(r);
+			}
+		}
+
+		///
+		/// Blocks until this Federate is next invoked, from another thread, and copies the arguments into "args".
+		/// Returns false, leaving "args" alone, if that does not happen within "timeout".
+		/// A wait adds no function: use this rather than a one-shot push_back for signal/await.
+		///
+		bool waitNext(Arguments& args, std::chrono::nanoseconds timeout)
+		{
+			static_assert(FederateCopyableArguments<FederateFunction>::value, "waitNext copies the arguments, so they must be copy-constructible.");
+
+			return this->extendExtras().waiters.wait(args, timeout);
+		}
+
+		///
+		/// Blocks until this Federate is next invoked, from another thread, and copies the arguments into "args".
+		///
+		void waitNext(Arguments& args)
+		{
+			static_assert(FederateCopyableArguments<FederateFunction>::value, "waitNext copies the arguments, so they must be copy-constructible.");
+
+			this->extendExtras().waiters.wait(args);
+		}
+
+		///
+		/// Returns a future for the arguments of this Federate's next invocation.
+		///
+		std::future<Arguments> nextAsync()
+		{
+			static_assert(FederateCopyableArguments<FederateFunction>::value, "nextAsync copies the arguments, so they must be copy-constructible.");
+
+			return this->extendExtras().waiters.next();
+		}
+
+		///
+		/// Invokes each of the functions in the Federate serially, whatever the error policy, calling every function
+		/// even if some throw.  Returns the results of those that did not throw alongside the errors of those that did.
+		///
+		template<typename... CallArgs> FederateInvokeResult<ResultType> invokeChecked(CallArgs&&... args)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			FederateInvokeResult<ResultType> checked;
+			this->invokeCheckedSlots(checked, std::is_void<ResultType>(), args...);
+			return checked;
+		}
+
+		///
+		/// Invokes the functions in order until one returns a result which converts to true, and returns it; the rest
+		/// are not called.  Returns a value-initialized result if none matches.  This suits filter chains whose
+		/// functions usually reject; see "setHotReordering".
+		/// Only this Federate's own functions are called, not those of connected Federates.  Exceptions follow the error policy.
+		///
+		template<typename... CallArgs> ResultType invokeFirst(CallArgs&&... args)
+		{
+			static_assert(std::is_void<ResultType>::value == false, "invokeFirst needs functions which return a value.");
+
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			this->observe(args...);
+
+			auto result = ResultType();
+
+			auto first = [&](Slot& f)->bool
+			{
+				auto r = FederateCall(f, args...);
+
+				if(static_cast<bool>(r) == false)
+				{
+					return false;
+				}
+
+				result = std::move(r);
+				return true;
+			};
+
+			auto bind = [&](SlotState& info)
+			{
+				FederateBase::bindPending(info, FederateCopyableArguments<FederateFunction>(), args...);
+			};
+
+			this->dispatchFirst(first, bind);
+			return result;
+		}
+
+		///
+		/// As invokeAsync, but the futures replace the contents of "futures", whose capacity is reused from one call to the next.
+		///
+		template<typename... CallArgs> void invokeAsyncInto(std::vector<std::future<ResultType>>& futures, CallArgs&&... args)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			futures.clear();
+			this->dispatchAsyncInto(futures, args...);
+		}
+
+		///
+		/// The results of "invokeLazy": an input range which calls the next live function each time it is advanced.
+		/// Only the current result is held, so memory does not grow with the number of functions.
+		///
+		/// Each step takes the Federate's lock only while it finds and calls the next function, so the loop body may use
+		/// the same Federate, and other threads may change it between steps.  The range walks the functions by
+		/// position: functions added at the end before the range reaches them are called, and removing or reordering
+		/// functions mid-iteration may skip one or call one twice.  The Federate must outlive the range.
+		/// Exceptions follow the error policy: under Propagate they leave "begin" or "++", and iteration may continue.
+		///
+		/// Arguments are held as the Federate's parameters are declared: by value, or by reference to the caller's
+		/// objects, which the functions see as they would under "invoke".  Objects passed to reference parameters must
+		/// outlive the range, so do not pass temporaries to them in a range-based for.
+		///
+		template<typename Parameters> class LazyResults
+		{
+			public:
+				static_assert(std::is_void<ResultType>::value == false, "invokeLazy needs functions which return a value.");
+
+				class iterator
+				{
+					public:
+						typedef std::input_iterator_tag iterator_category;
+						typedef ResultType value_type;
+						typedef std::ptrdiff_t difference_type;
+						typedef const ResultType* pointer;
+						typedef const ResultType& reference;
+
+						explicit iterator(LazyResults* r) : range(r)
+						{
+						}
+
+						reference operator*() const
+						{
+							return this->range->current;
+						}
+
+						pointer operator->() const
+						{
+							return &this->range->current;
+						}
+
+						iterator& operator++()
+						{
+							this->range->advance();
+							return *this;
+						}
+
+						void operator++(int)
+						{
+							this->range->advance();
+						}
+
+						bool operator==(const iterator& x) const
+						{
+							return this->atEnd() == x.atEnd();
+						}
+
+						bool operator!=(const iterator& x) const
+						{
+							return this->atEnd() != x.atEnd();
+						}
+
+					private:
+						bool atEnd() const
+						{
+							return this->range == nullptr || this->range->done == true;
+						}
+
+						LazyResults* range;
+				};
+
+				template<typename... CallArgs> LazyResults(FederateBase* o, CallArgs&&... a) :
+					owner(o),
+					args(std::forward<CallArgs>(a)...),
+					next(0),
+					started(false),
+					done(false),
+					hasValue(false)
+				{
+					auto scopedLock = o->lock.acquire();
+					SuppressWarningUnusedVariable(scopedLock);
+
+					// One clock read covers every timed slot, as in an invocation.
+					if(o->timedSlots() == true)
+					{
+						this->now = std::chrono::steady_clock::now();
+					}
+
+					this->record(Indices());
+				}
+
+				LazyResults(LazyResults&& x) :
+					owner(x.owner),
+					args(std::move(x.args)),
+					now(x.now),
+					next(x.next),
+					started(x.started),
+					done(x.done),
+					hasValue(false)
+				{
+					if(x.hasValue == true)
+					{
+						this->emplace(std::move(x.current));
+						x.reset();
+					}
+
+					x.done = true;
+				}
+
+				~LazyResults()
+				{
+					this->reset();
+				}
+
+				LazyResults(const LazyResults&) = delete;
+				LazyResults& operator=(const LazyResults&) = delete;
+				LazyResults& operator=(LazyResults&&) = delete;
+
+				///
+				/// Calls the first live function.  Only the first call does any work.
+				///
+				iterator begin()
+				{
+					if(this->started == false)
+					{
+						this->started = true;
+						this->advance();
+					}
+
+					return iterator(this);
+				}
+
+				iterator end()
+				{
+					return iterator(nullptr);
+				}
+
+			private:
+				void advance()
+				{
+					this->reset();
+
+					auto call = [this](Slot& f)
+					{
+						this->emplace(this->callSlot(f, Indices()));
+					};
+
+					auto bind = [this](SlotState& info)
+					{
+						this->bindSlot(info, Indices());
+					};
+
+					auto scopedLock = this->owner->lock.acquire();
+					SuppressWarningUnusedVariable(scopedLock);
+
+					while(this->next < this->owner->functions.vec.size())
+					{
+						this->owner->dispatchAt(this->next++, call, bind, this->now);
+
+						if(this->hasValue == true)
+						{
+							return;
+						}
+					}
+
+					this->done = true;
+				}
+
+				template<size_t... Is> void record(FederateIndexSequence<Is...>)
+				{
+					this->owner->observe(std::get<Is>(this->args)...);
+				}
+
+				template<size_t... Is> ResultType callSlot(Slot& f, FederateIndexSequence<Is...>)
+				{
+					return FederateCall(f, std::get<Is>(this->args)...);
+				}
+
+				template<size_t... Is> void bindSlot(SlotState& info, FederateIndexSequence<Is...>)
+				{
+					FederateBase::bindPending(info, FederateCopyableArguments<FederateFunction>(), std::get<Is>(this->args)...);
+				}
+
+				void emplace(ResultType x)
+				{
+					new(&this->current) ResultType(std::move(x));
+					this->hasValue = true;
+				}
+
+				void reset()
+				{
+					if(this->hasValue == true)
+					{
+						this->current.~ResultType();
+						this->hasValue = false;
+					}
+				}
+
+				typedef typename FederateMakeIndexSequence<std::tuple_size<Parameters>::value>::type Indices;
+
+				FederateBase* owner;
+				Parameters args;
+				std::chrono::steady_clock::time_point now;
+				size_t next;
+				bool started;
+				bool done;
+				bool hasValue;
+
+				union
+				{
+					ResultType current;
+				};
+		};
+
+		///
+		/// Invokes the functions in the Federate one at a time, as the returned range is iterated.
+		/// Stopping early (with "break") leaves the remaining functions uncalled.
+		///
+		template<typename... CallArgs> LazyResults<typename FederateFunctionTraits<FederateFunction>::Parameters> invokeLazy(CallArgs&&... args)
+		{
+			return LazyResults<typename FederateFunctionTraits<FederateFunction>::Parameters>(this, std::forward<CallArgs>(args)...);
+		}
+
+#ifdef FEDERATE_HAS_COROUTINES
+		///
+		/// Invokes each of the functions in the Federate and returns a task which completes when all of them have finished.
+		/// Plain functions run inline, now.  Functions returning a FederateTask are started when the returned task is
+		/// awaited and run concurrently; the task's result holds their results in order.
+		///
+		template<typename... CallArgs> FederateTask<typename FederateCoroTraits<ResultType>::ResultType> invokeCoro(CallArgs&&... args)
+		{
+			return this->invokeCoroOn(FederateScheduler(), std::forward<CallArgs>(args)...);
+		}
+
+		///
+		/// As invokeCoro, but functions returning a FederateTask are started on the given scheduler
+		/// rather than inline on the awaiting thread.
+		///
+		template<typename... CallArgs> FederateTask<typename FederateCoroTraits<ResultType>::ResultType> invokeCoroOn(FederateScheduler scheduler, CallArgs&&... args)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			return this->invokeCoroTask(std::move(scheduler), typename FederateCoroTraits<ResultType>::IsTask(), args...);
+		}
+#endif
+
+	protected:
+		/// A slot as stored: the function, or a weak reference to the Tracker's function when tracked.
+		typedef typename std::conditional<Tracked, WeakTracker, FederateFunction>::type StoredSlot;
+
+		///
+		/// Calls "visit" on each live slot of this Federate and then of the Federates connected downstream, in order.
+		/// Expired tracked functions, throttled functions over their limit and debounced functions are skipped; "bind"
+		/// keeps the invocation's arguments as a debounced slot's pending call.  Exceptions are collected into "errors"
+		/// when it is not null, and otherwise handled by the error policy.  The caller must hold the lock.
+		///
+		template<typename Visitor, typename Binder> void dispatchAll(Visitor& visit, Binder& bind, std::vector<FederateError>* errors)
+		{
+			// Without the extension there is no slot state, error policy or connection: just call the functions.
+			if(this->extension() == nullptr && errors == nullptr)
+			{
+				for(size_t i = 0; i < this->functions.vec.size(); ++i)
+				{
+					this->visitSlot(i, visit, bind, false, std::chrono::steady_clock::time_point());
+				}
+
+				return;
+			}
+
+			this->dispatchOwn(*this, visit, bind, errors);
+
+			if(this->beginWalk(ThreadSafe) == false)
+			{
+				return;
+			}
+
+			// Ends the walk however it is left, so that a disconnection waiting for it is not stranded by an exception.
+			struct Walk
+			{
+				~Walk()
+				{
+					this->owner->endWalk();
+				}
+
+				FederateBase* owner;
+			} walk = {this};
+
+			SuppressWarningUnusedVariable(walk);
+
+			// "connect" only takes Federates of this type.
+			for(auto node : this->extension()->dispatch)
+			{
+				auto& x = static_cast<FederateBase&>(*node);
+				auto nodeLock = x.lock.acquire();
+				SuppressWarningUnusedVariable(nodeLock);
+				x.dispatchOwn(*this, visit, bind, errors);
+			}
+		}
+
+		///
+		/// Calls "visit" on each of this Federate's own live slots, handling exceptions by the error policy of "policy".
+		/// The loop has no exception handling of its own unless errors are being collected or handled.
+		///
+		template<typename Visitor, typename Binder> void dispatchOwn(FederateBase& policy, Visitor& visit, Binder& bind, std::vector<FederateError>* errors)
+		{
+			const auto timed = this->timedSlots();
+
+			// One clock read per invocation covers every timed slot.
+			const auto now = (timed == true) ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+			if(policy.isolatesErrors(errors) == false)
+			{
+				for(size_t i = 0; i < this->functions.vec.size(); ++i)
+				{
+					this->visitSlot(i, visit, bind, timed, now);
+				}
+
+				return;
+			}
+
+			for(size_t i = 0; i < this->functions.vec.size(); ++i)
+			{
+				try
+				{
+					this->visitSlot(i, visit, bind, timed, now);
+				}
+				catch(...)
+				{
+					policy.reportError(i, errors);
+				}
+			}
+		}
+
+		///
+		/// Calls "visit" on each own slot in order until it returns true, counting hits for reordering by hotness.
+		/// Exceptions follow the error policy.  The caller must hold the lock.
+		///
+		template<typename Visitor, typename Binder> void dispatchFirst(Visitor& visit, Binder& bind)
+		{
+			const auto timed = this->timedSlots();
+			const auto now = (timed == true) ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+			auto errors = this->errorSink();
+			const auto isolate = this->isolatesErrors(errors);
+			const auto reorder = this->reorders();
+			size_t current = 0;
+
+			auto counted = [&](Slot& f)->bool
+			{
+				const auto matched = visit(f);
+				this->countHit(current, matched);
+				return matched;
+			};
+
+			auto matched = false;
+
+			for(; current < this->functions.vec.size() && matched == false; ++current)
+			{
+				if(isolate == false)
+				{
+					matched = this->visitFirst(current, visit, counted, bind, reorder, timed, now);
+					continue;
+				}
+
+				try
+				{
+					matched = this->visitFirst(current, visit, counted, bind, reorder, timed, now);
+				}
+				catch(...)
+				{
+					this->reportError(current, errors);
+				}
+			}
+
+			const auto order = this->nextHotOrder(this->functions.vec.size());
+
+			if(order.empty() == false)
+			{
+				FederateCore::permute(this->functions.vec, order);
+			}
+		}
+
+		template<typename Visitor, typename Counted, typename Binder> bool visitFirst(size_t i, Visitor& visit, Counted& counted, Binder& bind, bool reorder, bool timed, std::chrono::steady_clock::time_point now)
+		{
+			if(reorder == false)
+			{
+				return this->visitSlot(i, visit, bind, timed, now);
+			}
+
+			return this->visitSlot(i, counted, bind, timed, now);
+		}
+
+		///
+		/// Calls "visit" on slot "i", as the loops do, handling an exception by the error policy.  For a caller walking
+		/// the slots itself, one at a time.  "now" is the time timed slots are admitted at.  The caller must hold the lock.
+		///
+		template<typename Visitor, typename Binder> void dispatchAt(size_t i, Visitor& visit, Binder& bind, std::chrono::steady_clock::time_point now)
+		{
+			auto errors = this->errorSink();
+
+			if(this->isolatesErrors(errors) == false)
+			{
+				this->visitSlot(i, visit, bind, this->timedSlots(), now);
+				return;
+			}
+
+			try
+			{
+				this->visitSlot(i, visit, bind, this->timedSlots(), now);
+			}
+			catch(...)
+			{
+				this->reportError(i, errors);
+			}
+		}
+
+		///
+		/// Calls "visit" on slot "i" if it is live and, if "timed", admitted at "now".  Returns what "visit" returned.
+		///
+		template<typename Visitor, typename Binder> bool visitSlot(size_t i, Visitor& visit, Binder& bind, bool timed, std::chrono::steady_clock::time_point now)
+		{
+			return this->visitStored(this->functions.vec[i], i, visit, bind, timed, now);
+		}
+
+		template<typename Visitor, typename Binder> bool visitStored(FederateFunction& f, size_t i, Visitor& visit, Binder& bind, bool timed, std::chrono::steady_clock::time_point now)
+		{
+			// A dead slot's function is gone.
+			return f && this->visitLive(f, i, visit, bind, timed, now);
+		}
+
+		template<typename Visitor, typename Binder> bool visitStored(WeakTracker& slot, size_t i, Visitor& visit, Binder& bind, bool timed, std::chrono::steady_clock::time_point now)
+		{
+			auto f = slot.lock();
+			return f != nullptr && this->visitLive(f, i, visit, bind, timed, now);
+		}
+
+		template<typename Live, typename Visitor, typename Binder> bool visitLive(Live& f, size_t i, Visitor& visit, Binder& bind, bool timed, std::chrono::steady_clock::time_point now)
+		{
+			if(timed == true)
+			{
+				const auto admission = this->admitSlot(i, now);
+
+				if(admission != FederateCore::Admit)
+				{
+					if(admission == FederateCore::Defer)
+					{
+						bind(this->extension()->slotInfo[i]);
+					}
+
+					return false;
+				}
+			}
+
+			return this->callSlot(visit, f, i, typename FederateVisitsSlot<Visitor, AsyncSlot>::type());
+		}
+
+		///
+		/// Calls a visitor which takes the function.  Only "invokeFirst"'s visitor returns whether to stop.
+		///
+		template<typename Visitor> static bool callSlot(Visitor& visit, FederateFunction& f, size_t, std::false_type)
+		{
+			return FederateBase::finish(visit, f, std::is_same<decltype(visit(f)), bool>());
+		}
+
+		template<typename Visitor> static bool callSlot(Visitor& visit, Tracker& f, size_t, std::false_type)
+		{
+			return FederateBase::finish(visit, *f, std::is_same<decltype(visit(*f)), bool>());
+		}
+
+		///
+		/// Calls a visitor which takes what an asynchronous call holds, and the slot's preferred node.
+		///
+		template<typename Visitor> bool callSlot(Visitor& visit, FederateFunction& f, size_t i, std::true_type)
+		{
+			visit(FederateBase::asyncSlot(f), this->slotNode(i));
+			return false;
+		}
+
+		template<typename Visitor> bool callSlot(Visitor& visit, Tracker& f, size_t i, std::true_type)
+		{
+			visit(f, this->slotNode(i));
+			return false;
+		}
+
+		template<typename Visitor> static bool finish(Visitor& visit, FederateFunction& f, std::true_type)
+		{
+			return visit(f);
+		}
+
+		template<typename Visitor> static bool finish(Visitor& visit, FederateFunction& f, std::false_type)
+		{
+			visit(f);
+			return false;
+		}
+
+		///
+		/// Makes slot "i"'s pending debounced call, if its function is still live.  The caller must hold the lock.
+		///
+		bool callPending(size_t i)
+		{
+			auto& info = this->extension()->slotInfo[i];
+			auto call = std::move(info.pending);
+			info.pending = nullptr;
+			return this->callPending(this->functions.vec[i], call);
+		}
+
+		bool callPending(FederateFunction& f, std::function<void(void*)>& call)
+		{
+			call(&f);
+			return true;
+		}
+
+		bool callPending(WeakTracker& slot, std::function<void(void*)>& call)
+		{
+			auto f = slot.lock();
+
+			if(f == nullptr)
+			{
+				return false;
+			}
+
+			call(f.get());
+			return true;
+		}
+
+		///
+		/// Points the Trackers' deleters at "r", when tracked.
+		///
+		static void publishReclaimer(VectorMember<true, FederateFunction>& x, FederateReclaimer* r)
+		{
+			x.reclaimer->store(r, std::memory_order_release);
+		}
+
+		static void publishReclaimer(VectorMember<false, FederateFunction>&, FederateReclaimer*)
+		{
+		}
+
+		///
+		/// Wraps "f" in a Tracker whose deleter hands it to the reclaimer.
+		///
+		template<typename = void> Tracker makeTracker(FederateFunction f) const
+		{
+			std::shared_ptr<FederateTrackedSlot<FederateFunction>> slot(new FederateTrackedSlot<FederateFunction>(std::move(f)), FederateTrackerDeleter(this->functions.reclaimer));
+			return Tracker(slot, &slot->function);
+		}
+
+		template<typename = void> Tracker pushSlot(FederateFunction f, SlotState info, std::true_type)
+		{
+			auto tracker = this->makeTracker(std::move(f));
+			this->insertSlot(WeakTracker(tracker), std::move(info));
+			return tracker;
+		}
+
+		template<typename = void> void pushSlot(FederateFunction f, SlotState info, std::false_type)
+		{
+			this->insertSlot(std::move(f), std::move(info));
+		}
+
+		///
+		/// Adds "f" with its state under the lock.
+		///
+		void insertSlot(StoredSlot f, SlotState info)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			this->addSlot(std::move(f), std::move(info));
+		}
+
+		///
+		/// Adds "f" with its state.  A tracked slot may have expired already.  The caller must hold the lock.
+		///
+		void addSlot(StoredSlot f, SlotState info)
+		{
+			this->functions.vec.push_back(std::move(f));
+			this->pushSlotInfo(std::move(info), this->functions.vec.size());
+		}
+
+		///
+		/// Adds "f", which is removed when "connection" is destroyed.  Not tracked.
+		///
+		template<typename = void> void insertScoped(FederateFunction f, FederateScopedConnection& connection)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			SlotState info;
+			info.connection = &connection;
+			this->addSlot(std::move(f), std::move(info));
+			this->bindScoped(connection, this->functions.vec.size() - 1, &FederateBase::manageScoped);
+		}
+
+		///
+		/// Carries out a FederateScopedConnection's request.
+		///
+		static void manageScoped(void* owner, FederateScopedConnection* self, FederateScopedConnection* to, FederateScopedConnection::Operation op)
+		{
+			auto federate = static_cast<FederateBase*>(static_cast<FederateCore*>(owner));
+			auto scopedLock = federate->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			size_t i = 0;
+
+			// The Federate may have been cleared since the caller looked.
+			if(FederateCore::claimScoped(self, i) == false)
+			{
+				return;
+			}
+
+			if(op == FederateScopedConnection::Disconnect)
+			{
+				federate->eraseSlot(i);
+			}
+			else
+			{
+				federate->moveScoped(i, self, to);
+			}
+		}
+
+		///
+		/// Removes slot "i".  The caller must hold the lock.  Only scoped connections erase, and they are never tracked.
+		/// The function goes now, but the slot is only marked dead, and the slots are compacted once most are dead,
+		/// so destroying many connections costs linear time, not quadratic.
+		///
+		void eraseSlot(size_t i)
+		{
+			auto& vec = this->functions.vec;
+			auto r = this->slotReclaimer();
+
+			if(r != nullptr)
+			{
+				r->retire(std::make_shared<StoredSlot>(std::move(vec[i])));
+			}
+			else
+			{
+				vec[i] = StoredSlot();
+			}
+
+			if(this->killSlotInfo(i) == true)
+			{
+				this->cleanExpired();
+			}
+		}
+
+		template<typename Iterator> std::vector<Tracker> pushRange(Iterator first, Iterator last, bool replace, std::true_type)
+		{
+			std::vector<Tracker> trackers;
+			std::vector<WeakTracker> slots;
+			this->reserveRange(trackers, first, last, typename std::iterator_traits<Iterator>::iterator_category());
+			this->reserveRange(slots, first, last, typename std::iterator_traits<Iterator>::iterator_category());
+
+			for(; first != last; ++first)
+			{
+				trackers.push_back(this->makeTracker(*first));
+				slots.push_back(trackers.back());
+			}
+
+			this->installSlots(slots, replace);
+			return trackers;
+		}
+
+		template<typename Iterator> void pushRange(Iterator first, Iterator last, bool replace, std::false_type)
+		{
+			std::vector<FederateFunction> slots;
+			this->reserveRange(slots, first, last, typename std::iterator_traits<Iterator>::iterator_category());
+
+			for(; first != last; ++first)
+			{
+				slots.emplace_back(*first);
+			}
+
+			this->installSlots(slots, replace);
+		}
+
+		template<typename Vector, typename Iterator> void reserveRange(Vector& x, Iterator first, Iterator last, std::forward_iterator_tag)
+		{
+			x.reserve(static_cast<size_t>(std::distance(first, last)));
+		}
+
+		template<typename Vector, typename Iterator> void reserveRange(Vector&, Iterator, Iterator, std::input_iterator_tag)
+		{
+		}
+
+		///
+		/// Swaps "slots" in for the current functions, or appends them, under the lock.
+		/// When replacing, "slots" holds the old functions afterwards and they are destroyed or retired without the lock.
+		///
+		void installSlots(std::vector<StoredSlot>& slots, bool replace)
+		{
+			FederateReclaimer* r = nullptr;
+
+			{
+				auto scopedLock = this->lock.acquire();
+				SuppressWarningUnusedVariable(scopedLock);
+
+				auto& vec = this->functions.vec;
+
+				if(replace == true)
+				{
+					vec.swap(slots);
+					this->resetSlotInfo(vec.size());
+					r = this->slotReclaimer();
+				}
+				else
+				{
+					vec.reserve(vec.size() + slots.size());
+					std::move(std::begin(slots), std::end(slots), std::back_inserter(vec));
+					this->growSlotInfo(vec.size());
+					slots.clear();
+				}
+			}
+
+			if(r != nullptr)
+			{
+				FederateCore::retireTo(r, slots);
+			}
+		}
+
+		void measureSlots(FederateMemoryUsage& x) const
+		{
+			for(auto& slot : this->functions.vec)
+			{
+				FederateBase::measure(x, slot);
+			}
+		}
+
+		static void measure(FederateMemoryUsage& x, const FederateFunction& f)
+		{
+			x.captures += f.targetSize();
+		}
+
+		///
+		/// A Tracker's slot holds the function and its retire node; its control block two reference counts, a vtable
+		/// pointer, the slot's address and the deleter.
+		///
+		static void measure(FederateMemoryUsage& x, const WeakTracker& slot)
+		{
+			auto f = slot.lock();
+
+			if(f != nullptr)
+			{
+				x.captures += f->targetSize();
+			}
+
+			x.trackers += sizeof(FederateTrackedSlot<FederateFunction>) + 2 * sizeof(long) + 2 * sizeof(void*) + sizeof(FederateTrackerDeleter);
+		}
+
+		static bool expired(const FederateFunction&)
+		{
+			return false;
+		}
+
+		static bool expired(const WeakTracker& slot)
+		{
+			return slot.expired();
+		}
+
+		///
+		/// Drops the expired tracked slots and the dead slots, keeping the order of the others.  The caller must hold
+		/// the lock.
+		///
+		void cleanExpired()
+		{
+			auto& vec = this->functions.vec;
+			size_t kept = 0;
+
+			for(size_t i = 0; i < vec.size(); ++i)
+			{
+				if(FederateBase::expired(vec[i]) == false && this->deadSlot(i) == false)
+				{
+					if(kept != i)
+					{
+						vec[kept] = std::move(vec[i]);
+						this->moveSlotInfo(i, kept);
+					}
+
+					++kept;
+				}
+			}
+
+			vec.erase(std::begin(vec) + kept, std::end(vec));
+			this->truncateSlotInfo(kept);
+		}
+
+		///
+		/// Calls "visit" on each live slot in the Federate, in order, with the function or, if "visit" takes them, what an
+		/// asynchronous call holds of the slot and its preferred node.  See "dispatchAll".  The arguments are only used to
+		/// bind a debounced call.  The caller must hold the lock.
+		///
+		template<typename Visitor, typename... CallArgs> void forEachSlot(Visitor&& visit, CallArgs&... args)
+		{
+			this->forEachSlotReporting(visit, this->errorSink(), args...);
+		}
+
+		///
+		/// Appends the result of each live slot to "results": a std::vector, FederateSmallBuffer or FederateSpanWriter.
+		/// The caller must hold the lock.
+		///
+		template<typename Results, typename... CallArgs> void collectResults(Results& results, CallArgs&... args)
+		{
+			results.reserve(this->functions.vec.size());
+
+			this->forEachSlot([&](Slot& f)
+			{
+				results.push_back(FederateCall(f, args...));
+			}, args...);
+		}
+
+		///
+		/// Passes the arguments of an invocation to the recorder and to anything waiting for it, before any function runs.
+		///
+		template<typename... CallArgs> void observe(CallArgs&... args)
+		{
+			auto x = this->extras();
+
+			if(x == nullptr)
+			{
+				return;
+			}
+
+			if(x->recorder)
+			{
+				x->recorder(args...);
+			}
+
+			this->deliverWaiters(*x, FederateCopyableArguments<FederateFunction>(), args...);
+		}
+
+		template<typename... CallArgs> void deliverWaiters(Extras& x, std::true_type, CallArgs&... args)
+		{
+			x.waiters.deliver(args...);
+		}
+
+		///
+		/// Arguments which cannot be copied have no waiters: waitNext and nextAsync reject them.
+		///
+		template<typename... CallArgs> void deliverWaiters(Extras&, std::false_type, CallArgs&...)
+		{
+		}
+
+		///
+		/// Returns the recorder and waiters, or nullptr if neither has been used.
+		///
+		Extras* extras() const
+		{
+			auto e = this->extension();
+			return (e != nullptr) ? static_cast<Extras*>(e->typed.load(std::memory_order_acquire)) : nullptr;
+		}
+
+		///
+		/// Returns the recorder and waiters, allocating them the first time.  Safe without the lock, as "waitNext" uses it.
+		///
+		Extras& extendExtras()
+		{
+			auto& e = this->extend();
+			auto current = e.typed.load(std::memory_order_acquire);
+
+			if(current == nullptr)
+			{
+				std::unique_ptr<Extras> fresh(new Extras());
+
+				if(e.typed.compare_exchange_strong(current, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire) == true)
+				{
+					return *fresh.release();
+				}
+			}
+
+			return *static_cast<Extras*>(current);
+		}
+
+		///
+		/// Takes the recorder of "x", for a move.  The waiters stay with "x".
+		///
+		void takeRecorder(FederateBase& x)
+		{
+			auto from = x.extras();
+
+			if(from != nullptr && from->recorder)
+			{
+				this->extendExtras().recorder = std::move(from->recorder);
+				from->recorder = Recorder();
+			}
+			else if(this->extras() != nullptr)
+			{
+				this->extras()->recorder = Recorder();
+			}
+		}
+
+		///
+		/// As forEachSlot, but exceptions are collected into "errors" when it is not null.
+		/// Functions of connected downstream Federates follow this Federate's own.
+		///
+		template<typename Visitor, typename... CallArgs> void forEachSlotReporting(Visitor& visit, std::vector<FederateError>* errors, CallArgs&... args)
+		{
+			this->observe(args...);
+
+			auto bind = [&](SlotState& info)
+			{
+				FederateBase::bindPending(info, FederateCopyableArguments<FederateFunction>(), args...);
+			};
+
+			this->dispatchAll(visit, bind, errors);
+		}
+
+		///
+		/// Keeps a copy of the arguments as a debounced slot's pending call.
+		///
+		template<typename... CallArgs> static void bindPending(SlotState& info, std::true_type, CallArgs&... args)
+		{
+			info.pending = [args...](void* f) mutable
+			{
+				FederateCall(*static_cast<FederateFunction*>(f), args...);
+			};
+		}
+
+		///
+		/// Arguments which cannot be copied never reach here: push_back_debounced rejects them.
+		///
+		template<typename... CallArgs> static void bindPending(SlotState&, std::false_type, CallArgs&...)
+		{
+		}
+
+		///
+		/// One function called by a batched asynchronous task, and where its result goes.
+		///
+		struct AsyncCall
+		{
+			explicit AsyncCall(AsyncSlot f) : slot(std::move(f))
+			{
+			}
+
+			AsyncSlot slot;
+			std::promise<ResultType> promise;
+		};
+
+		///
+		/// Starts the live functions asynchronously and returns their futures.  The caller must hold the lock.
+		///
+		template<typename... CallArgs> std::vector<std::future<ResultType>> dispatchAsync(CallArgs&... args)
+		{
+			std::vector<std::future<ResultType>> futures;
+			this->dispatchAsyncInto(futures, args...);
+			return futures;
+		}
+
+		///
+		/// Starts the live functions asynchronously, "asyncGrain" functions per task, appending their futures to "futures".
+		/// The caller must hold the lock.
+		///
+		template<typename... CallArgs> void dispatchAsyncInto(std::vector<std::future<ResultType>>& futures, CallArgs&... args)
+		{
+			futures.reserve(futures.size() + this->functions.vec.size());
+
+			auto e = this->extension();
+
+			if(e == nullptr || (e->executor == nullptr && e->asyncGrain == 1))
+			{
+				this->forEachSlot([&](const AsyncSlot& s, int)
+				{
+					auto f = s;
+
+					futures.emplace_back(std::async(std::launch::async,
+						[f, args...]() mutable ->ResultType
+					{
+						// Released on return, before the future is ready; see "fulfil".
+						auto slot = std::move(f);
+						return FederateCall(slot, args...);
+					}));
+				}, args...);
+
+				return;
+			}
+
+			auto calls = std::make_shared<std::vector<AsyncCall>>();
+			calls->reserve(this->functions.vec.size());
+
+			// Each call's preferred node and index, for the executor.
+			std::vector<std::pair<int, size_t>> order;
+
+			this->forEachSlot([&](const AsyncSlot& s, int node)
+			{
+				order.emplace_back(node, calls->size());
+				calls->emplace_back(s);
+				futures.push_back(calls->back().promise.get_future());
+			}, args...);
+
+			// Each function's future is fulfilled by its promise, and the Federate waits for the tasks when it is destroyed.
+			// Each AsyncCall holds a reference to its function, so dropping the futures and clearing the Federate is safe.
+			auto call = [calls, args...](size_t i) mutable
+			{
+				FederateBase::fulfil((*calls)[i], std::is_void<ResultType>(), args...);
+			};
+
+			if(e->executor != nullptr)
+			{
+				this->runOnExecutor(std::move(order), std::move(call));
+			}
+			else
+			{
+				this->runBatches(calls->size(), this->asyncGrainFor(calls->size()), std::move(call));
+			}
 		}
 
 		///
-		/// Returns the number of functions in the Federate.
+		/// What an asynchronous call holds on to of a non-tracked function: a wrapper sharing the callable with the
+		/// slot, so no task copies it.  Only the first asynchronous invocation of a callable stored in place allocates,
+		/// to move it where the tasks can share it.  See the class description.
 		///
-		size_t size() const
+		static FederateFunction asyncSlot(FederateFunction& f)
 		{
-			auto scopedLock = this->lock.acquire();
-			SuppressWarningUnusedVariable(scopedLock);
-			return this->functions.vec.size();
+			return f.share();
 		}
 
 		///
-		/// Clears the functions in the Federate.
+		/// Calls one function and completes its future.  The function is released first: once the caller has every
+		/// result it may destroy the Federate and its reclaimer, so a Tracker must not be retired after that.
 		///
-		void clear()
+		template<typename... CallArgs> static void fulfil(AsyncCall& call, std::false_type, CallArgs&... args)
 		{
-			auto scopedLock = this->lock.acquire();
-			SuppressWarningUnusedVariable(scopedLock);
-			this->functions.vec.clear();
+			try
+			{
+				auto result = FederateCall(call.slot, args...);
+				call.slot = AsyncSlot();
+				call.promise.set_value(std::move(result));
+			}
+			catch(...)
+			{
+				call.slot = AsyncSlot();
+				call.promise.set_exception(std::current_exception());
+			}
 		}
 
-		///
-		/// Returns true if the Federate is empty.
-		///
-		bool empty() const
+		template<typename... CallArgs> static void fulfil(AsyncCall& call, std::true_type, CallArgs&... args)
 		{
-			auto scopedLock = this->lock.acquire();
-			SuppressWarningUnusedVariable(scopedLock);
-			return this->functions.vec.empty();
+			try
+			{
+				FederateCall(call.slot, args...);
+				call.slot = AsyncSlot();
+				call.promise.set_value();
+			}
+			catch(...)
+			{
+				call.slot = AsyncSlot();
+				call.promise.set_exception(std::current_exception());
+			}
 		}
 
-		///
-		/// Determines how many tracked objects are expired.
-		/// The non-tracked version will always return 0.
-		///
-		size_t garbageSize() const
+		template<typename... CallArgs> void invokeCheckedSlots(FederateInvokeResult<ResultType>& checked, std::false_type, CallArgs&... args)
 		{
-			return this->garbageSizeTracked(std::integral_constant<bool, Tracked>());
+			checked.results.reserve(this->functions.vec.size());
+
+			auto call = [&](Slot& f)
+			{
+				checked.results.push_back(FederateCall(f, args...));
+			};
+
+			this->forEachSlotReporting(call, &checked.errors, args...);
 		}
 
-		///
-		/// Removes all tracked objects that are expired.
-		///
-		void clean()
+		template<typename... CallArgs> void invokeCheckedSlots(FederateInvokeResult<ResultType>& checked, std::true_type, CallArgs&... args)
 		{
-			this->cleanTracked(std::integral_constant<bool, Tracked>());
+			auto call = [&](Slot& f)
+			{
+				FederateCall(f, args...);
+			};
+
+			this->forEachSlotReporting(call, &checked.errors, args...);
 		}
 
-	protected:
-		void cleanTracked(std::true_type)
+#ifdef FEDERATE_HAS_COROUTINES
+		template<typename... CallArgs> FederateTask<typename FederateCoroTraits<ResultType>::ResultType> invokeCoroTask(FederateScheduler scheduler, std::true_type, CallArgs&... args)
 		{
-			auto scopedLock = this->lock.acquire();
-			SuppressWarningUnusedVariable(scopedLock);
-			this->functions.vec.erase(std::remove_if(std::begin(this->functions.vec), std::end(this->functions.vec),
-				[](WeakTracker& f)->bool
+			std::vector<ResultType> tasks;
+			tasks.reserve(this->functions.vec.size());
+
+			this->forEachSlot([&](Slot& f)
 			{
-				return f.lock() == nullptr;
-			}), std::end(this->functions.vec));
+				tasks.push_back(FederateCall(f, args...));
+			}, args...);
+
+			return FederateWhenAll(std::move(tasks), std::move(scheduler));
 		}
 
-		void cleanTracked(std::false_type)
+		template<typename... CallArgs> FederateTask<typename FederateCoroTraits<ResultType>::ResultType> invokeCoroTask(FederateScheduler, std::false_type, CallArgs&... args)
 		{
+			return this->invokeCoroPlain(std::is_void<ResultType>(), args...);
 		}
 
-		size_t garbageSizeTracked(std::true_type) const
+		template<typename... CallArgs> FederateTask<void> invokeCoroPlain(std::true_type, CallArgs&... args)
 		{
-			auto scopedLock = this->lock.acquire();
-			SuppressWarningUnusedVariable(scopedLock);
-
-			return std::count_if(std::begin(this->functions.vec), std::end(this->functions.vec),
-				[](const WeakTracker& f)->bool
+			this->forEachSlot([&](Slot& f)
 			{
-				return f.lock() == nullptr;
-			});
+				FederateCall(f, args...);
+			}, args...);
+
+			return FederateReadyTask();
 		}
 
-		size_t garbageSizeTracked(std::false_type) const
+		template<typename... CallArgs> FederateTask<std::vector<ResultType>> invokeCoroPlain(std::false_type, CallArgs&... args)
 		{
-			return 0;
+			std::vector<ResultType> results;
+			results.reserve(this->functions.vec.size());
+
+			this->forEachSlot([&](Slot& f)
+			{
+				results.push_back(FederateCall(f, args...));
+			}, args...);
+
+			return FederateReadyTask(std::move(results));
 		}
+#endif
 
+		/// The functions, contiguous and by value, or weak references to the Trackers' functions when tracked.
 		VectorMember<Tracked, FederateFunction> functions;
+
+		/// A ThreadSafe Federate's mutex.  Nothing, when not ThreadSafe.
 		MutexMember<ThreadSafe> lock;
 };
 
 ///
 ///
 ///
-template<typename T, bool Tracked = false, bool ThreadSafe = false> class Federate
+template<typename T, bool Tracked, bool ThreadSafe> class Federate
 {
 };
 
@@ -191,11 +5455,12 @@ template<typename T, bool Tracked = false, bool ThreadSafe = false> class Federa
 /// A non-thread safe Federate of non-tracked function objects.
 /// For functions with the signature "R (Args...)"
 ///
-template<typename R, typename... Args, bool Tracked, bool ThreadSafe> class Federate<R(Args...), Tracked, ThreadSafe> : public FederateBase<std::function<R(Args...)>, Tracked, ThreadSafe>
+template<typename R, typename... Args, bool Tracked, bool ThreadSafe> class Federate<R(Args...), Tracked, ThreadSafe> : public FederateBase<FederateMoveOnlyFunction<R(Args...)>, Tracked, ThreadSafe>
 {
 	public:
 		/// To clean up the spelling throughout the function, define a type for our Federate functions.
-		typedef std::function<R(Args...)> FederateFunction;
+		typedef FederateMoveOnlyFunction<R(Args...)> FederateFunction;
+		typedef typename FederateBase<FederateFunction, Tracked, ThreadSafe>::Slot Slot;
 
 		///
 		/// Invokes each of the functions in the Federate serially.
@@ -206,87 +5471,89 @@ template<typename R, typename... Args, bool Tracked, bool ThreadSafe> class Fede
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
 
-			return this->invokeTracked(args..., std::integral_constant<bool, Tracked>());
+			return this->invokeSlots(args...);
 		}
 
 		///
-		/// Invokes each of the functions in the Federate asynchronously.  
-		/// Invokes each of the functions in the Federate asynchronously with tracking.
-		/// Returns a vector of futures for the functions.
+		/// As invoke, but the results are stored as FederateResultTraits chooses for "R": inline, without allocating,
+		/// for a small number of arithmetic results, and as plain bytes rather than std::vector<bool> for bool.
 		///
-		std::vector<std::future<R>> invokeAsync(Args... args)
+		typename FederateResultTraits<R>::Buffer invokeBuffered(Args... args)
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
 
-			return this->invokeAsyncTracked(args..., std::integral_constant<bool, Tracked>());
+			typename FederateResultTraits<R>::Buffer results;
+			this->collectResults(results, args...);
+			return results;
 		}
 
-	protected:
-		std::vector<R> invokeTracked(Args... args, std::true_type)
+		///
+		/// As invoke, but writes the results to "out", which has room for "capacity" of them, and never allocates.
+		/// Returns the number of results.  If that is more than "capacity", every function was still called,
+		/// but only the first "capacity" results were kept.
+		///
+		size_t invokeSpan(R* out, size_t capacity, Args... args)
 		{
-			std::vector<R> results;
-
-			for(auto& f : this->functions.vec)
-			{
-				auto func = f.lock();
-
-				if(func != nullptr)
-				{
-					results.push_back(func->operator()(args...));
-				}
-			}
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
 
-			return results;
+			FederateSpanWriter<R> results(out, capacity);
+			this->collectResults(results, args...);
+			return results.size();
 		}
 
-		std::vector<R> invokeTracked(Args... args, std::false_type)
+		///
+		/// As invoke, but the results replace the contents of "results", whose capacity is reused from one call to the next.
+		///
+		void invokeInto(std::vector<R>& results, Args... args)
 		{
-			std::vector<R> results;
-
-			for(auto& f : this->functions.vec)
-			{
-				results.push_back(f(args...));
-			}
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
 
-			return results;
+			results.clear();
+			this->collectResults(results, args...);
 		}
 
-		std::vector<std::future<R>> invokeAsyncTracked(Args... args, std::true_type)
+		///
+		/// As invoke, but the results are kept in a vector owned by the calling thread and reused, so once it has grown
+		/// to fit, invoking allocates nothing.  The reference is valid until this thread next calls invokeScratch on a
+		/// Federate returning "R" (nested calls from inside a function use their own vector).
+		///
+		const std::vector<R>& invokeScratch(Args... args)
 		{
-			std::vector<std::future<R>> futures;
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
 
-			for(auto& f : this->functions.vec)
-			{
-				auto func = f.lock();
+			FederateScratch<R> scratch;
+			this->collectResults(scratch.results(), args...);
+			return scratch.results();
+		}
 
-				if(func != nullptr)
-				{
-					futures.emplace_back(std::async(std::launch::async,
-						[func, args]()->R
-					{
-						return func(args...);
-					}));
-				}
-			}
+		///
+		/// Invokes each of the functions in the Federate asynchronously.
+		/// Invokes each of the functions in the Federate asynchronously with tracking.
+		/// Returns a vector of futures for the functions.
+		///
+		std::vector<std::future<R>> invokeAsync(Args... args)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
 
-			return futures;
+			return this->invokeAsyncSlots(args...);
 		}
 
-		std::vector<std::future<R>> invokeAsyncTracked(Args... args, std::false_type)
+	protected:
+		std::vector<R> invokeSlots(Args... args)
 		{
-			std::vector<std::future<R>> futures;
-
-			for(auto& f : this->functions.vec)
-			{
-				futures.emplace_back(std::async(std::launch::async,
-					[f, args]()->R
-				{
-					return f(args...);
-				}));
-			}
+			std::vector<R> results;
+			this->collectResults(results, args...);
+			return results;
+		}
 
-			return futures;
+		std::vector<std::future<R>> invokeAsyncSlots(Args... args)
+		{
+			return this->dispatchAsync(args...);
 		}
 };
 
@@ -294,11 +5561,12 @@ template<typename R, typename... Args, bool Tracked, bool ThreadSafe> class Fede
 /// A non-thread safe Federate of non-tracked function objects.
 /// For functions with the signature "void (Args...)"
 ///
-template<typename... Args, bool Tracked, bool ThreadSafe> class Federate<void(Args...), Tracked, ThreadSafe> : public FederateBase<std::function<void(Args...)>, Tracked, ThreadSafe>
+template<typename... Args, bool Tracked, bool ThreadSafe> class Federate<void(Args...), Tracked, ThreadSafe> : public FederateBase<FederateMoveOnlyFunction<void(Args...)>, Tracked, ThreadSafe>
 {
 	public:
 		/// To clean up the spelling throughout the function, define a type for our Federate functions.
-		typedef std::function<void (Args...)> FederateFunction;
+		typedef FederateMoveOnlyFunction<void(Args...)> FederateFunction;
+		typedef typename FederateBase<FederateFunction, Tracked, ThreadSafe>::Slot Slot;
 
 		///
 		/// Invokes each of the functions in the Federate serially.
@@ -308,11 +5576,11 @@ template<typename... Args, bool Tracked, bool ThreadSafe> class Federate<void(Ar
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
 
-			this->invokeTracked(args..., std::integral_constant<bool, Tracked>());
+			this->invokeSlots(args...);
 		}
 
 		///
-		/// Invokes each of the functions in the Federate asynchronously.  
+		/// Invokes each of the functions in the Federate asynchronously.
 		/// Returns a vector of futures for the functions.vec.
 		///
 		std::vector<std::future<void>> invokeAsync(Args... args)
@@ -320,66 +5588,21 @@ template<typename... Args, bool Tracked, bool ThreadSafe> class Federate<void(Ar
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
 
-			return this->invokeAsyncTracked(args..., std::integral_constant<bool, Tracked>());
+			return this->invokeAsyncSlots(args...);
 		}
 
 	protected:
-		void invokeTracked(Args... args, std::true_type)
-		{
-			for(auto& f : this->functions.vec)
-			{
-				auto func = f.lock();
-
-				if(func != nullptr)
-				{
-					func->operator()(args...);
-				}
-			}
-		}
-
-		void invokeTracked(Args... args, std::false_type)
-		{
-			for(auto& f : this->functions.vec)
-			{
-				f(args...);
-			}
-		}
-
-		std::vector<std::future<void>> invokeAsyncTracked(Args... args, std::true_type)
+		void invokeSlots(Args... args)
 		{
-			std::vector<std::future<void>> futures;
-
-			for(auto& f : this->functions.vec)
+			this->forEachSlot([&](Slot& f)
 			{
-				auto func = f.lock();
-
-				if(func != nullptr)
-				{
-					futures.emplace_back(std::async(std::launch::async,
-						[func, args...]()
-					{
-						return func->operator()(args...);
-					}));
-				}
-			}
-
-			return futures;
+				FederateCall(f, args...);
+			}, args...);
 		}
 
-		std::vector<std::future<void>> invokeAsyncTracked(Args... args, std::false_type)
+		std::vector<std::future<void>> invokeAsyncSlots(Args... args)
 		{
-			std::vector<std::future<void>> futures;
-
-			for(auto& f : this->functions.vec)
-			{
-				futures.emplace_back(std::async(std::launch::async,
-					[f, args]()
-				{
-					return f(args...);
-				}));
-			}
-
-			return futures;
+			return this->dispatchAsync(args...);
 		}
 };
 
@@ -387,11 +5610,12 @@ template<typename... Args, bool Tracked, bool ThreadSafe> class Federate<void(Ar
 /// A non-thread safe Federate of non-tracked function objects.
 /// For functions with the signature "R (void)"
 ///
-template<typename R, bool Tracked, bool ThreadSafe> class Federate<R(void), Tracked, ThreadSafe> : public FederateBase<std::function<R(void)>, Tracked, ThreadSafe>
+template<typename R, bool Tracked, bool ThreadSafe> class Federate<R(void), Tracked, ThreadSafe> : public FederateBase<FederateMoveOnlyFunction<R(void)>, Tracked, ThreadSafe>
 {
 	public:
 		/// To clean up the spelling throughout the function, define a type for our Federate functions.
-		typedef std::function<R(void)> FederateFunction;
+		typedef FederateMoveOnlyFunction<R(void)> FederateFunction;
+		typedef typename FederateBase<FederateFunction, Tracked, ThreadSafe>::Slot Slot;
 
 		///
 		/// Invokes each of the functions in the Federate serially.
@@ -401,86 +5625,88 @@ template<typename R, bool Tracked, bool ThreadSafe> class Federate<R(void), Trac
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
 
-			return this->invokeTracked(std::integral_constant<bool, Tracked>());
+			return this->invokeSlots();
 		}
 
 		///
-		/// Invokes each of the functions in the Federate asynchronously.  
-		/// Returns a vector of futures for the functions.vec.
+		/// As invoke, but the results are stored as FederateResultTraits chooses for "R": inline, without allocating,
+		/// for a small number of arithmetic results, and as plain bytes rather than std::vector<bool> for bool.
 		///
-		std::vector<std::future<R>> invokeAsync()
+		typename FederateResultTraits<R>::Buffer invokeBuffered()
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
 
-			return this->invokeAsyncTracked(std::integral_constant<bool, Tracked>());
+			typename FederateResultTraits<R>::Buffer results;
+			this->collectResults(results);
+			return results;
 		}
 
-	protected:
-		std::vector<R> invokeTracked(std::true_type)
+		///
+		/// As invoke, but writes the results to "out", which has room for "capacity" of them, and never allocates.
+		/// Returns the number of results.  If that is more than "capacity", every function was still called,
+		/// but only the first "capacity" results were kept.
+		///
+		size_t invokeSpan(R* out, size_t capacity)
 		{
-			std::vector<R> results;
-
-			for(auto& f : this->functions.vec)
-			{
-				auto func = f.lock();
-
-				if(func != nullptr)
-				{
-					results.push_back(func->operator()());
-				}
-			}
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
 
-			return results;
+			FederateSpanWriter<R> results(out, capacity);
+			this->collectResults(results);
+			return results.size();
 		}
 
-		std::vector<R> invokeTracked(std::false_type)
+		///
+		/// As invoke, but the results replace the contents of "results", whose capacity is reused from one call to the next.
+		///
+		void invokeInto(std::vector<R>& results)
 		{
-			std::vector<R> results;
-
-			for(auto& f : this->functions.vec)
-			{
-				results.push_back(f());
-			}
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
 
-			return results;
+			results.clear();
+			this->collectResults(results);
 		}
 
-		std::vector<std::future<R>> invokeAsyncTracked(std::true_type)
+		///
+		/// As invoke, but the results are kept in a vector owned by the calling thread and reused, so once it has grown
+		/// to fit, invoking allocates nothing.  The reference is valid until this thread next calls invokeScratch on a
+		/// Federate returning "R" (nested calls from inside a function use their own vector).
+		///
+		const std::vector<R>& invokeScratch()
 		{
-			std::vector<std::future<R>> futures;
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
 
-			for(auto& f : this->functions.vec)
-			{
-				auto func = f.lock();
+			FederateScratch<R> scratch;
+			this->collectResults(scratch.results());
+			return scratch.results();
+		}
 
-				if(func != nullptr)
-				{
-					futures.emplace_back(std::async(std::launch::async,
-						[func]()->R
-					{
-						return func();
-					}));
-				}
-			}
+		///
+		/// Invokes each of the functions in the Federate asynchronously.
+		/// Returns a vector of futures for the functions.vec.
+		///
+		std::vector<std::future<R>> invokeAsync()
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
 
-			return futures;
+			return this->invokeAsyncSlots();
 		}
 
-		std::vector<std::future<R>> invokeAsyncTracked(std::false_type)
+	protected:
+		std::vector<R> invokeSlots()
 		{
-			std::vector<std::future<R>> futures;
-
-			for(auto& f : this->functions.vec)
-			{
-				futures.emplace_back(std::async(std::launch::async,
-					[f]()->R
-				{
-					return f();
-				}));
-			}
+			std::vector<R> results;
+			this->collectResults(results);
+			return results;
+		}
 
-			return futures;
+		std::vector<std::future<R>> invokeAsyncSlots()
+		{
+			return this->dispatchAsync();
 		}
 };
 
@@ -488,11 +5714,12 @@ template<typename R, bool Tracked, bool ThreadSafe> class Federate<R(void), Trac
 /// A non-thread safe Federate of non-tracked function objects.
 /// For functions with the signature "void(void)"
 ///
-template<> class Federate<void(void), false, false> : public FederateBase<std::function<void(void)>, false, false>
+template<> class Federate<void(void), false, false> : public FederateBase<FederateMoveOnlyFunction<void(void)>, false, false>
 {
 	public:
 		/// To clean up the spelling throughout the function, define a type for our Federate functions.
-		typedef std::function<void(void)> FederateFunction;
+		typedef FederateMoveOnlyFunction<void(void)> FederateFunction;
+		typedef FederateBase<FederateFunction, false, false>::Slot Slot;
 
 		///
 		/// Invokes each of the functions in the Federate serially.
@@ -501,43 +5728,32 @@ template<> class Federate<void(void), false, false> : public FederateBase<std::f
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
-			this->invokeTrackedFalse();
+			this->invokeSlots();
 		}
 
 		///
-		/// Invokes each of the functions in the Federate asynchronously.  
+		/// Invokes each of the functions in the Federate asynchronously.
 		/// Returns a vector of futures for the functions.vec.
 		///
 		std::vector<std::future<void>> invokeAsync()
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
-			return this->invokeAsyncTrackedFalse();
+			return this->invokeAsyncSlots();
 		}
 
 	protected:
-		void invokeTrackedFalse()
+		void invokeSlots()
 		{
-			for(auto& f : this->functions.vec)
+			this->forEachSlot([](Slot& f)
 			{
-				f();
-			}
+				FederateCall(f);
+			});
 		}
 
-		std::vector<std::future<void>> invokeAsyncTrackedFalse()
+		std::vector<std::future<void>> invokeAsyncSlots()
 		{
-			std::vector<std::future<void>> futures;
-
-			for(auto& f : this->functions.vec)
-			{
-				futures.emplace_back(std::async(std::launch::async,
-					[f]()
-				{
-					f();
-				}));
-			}
-
-			return futures;
+			return this->dispatchAsync();
 		}
 };
 
@@ -545,11 +5761,12 @@ template<> class Federate<void(void), false, false> : public FederateBase<std::f
 /// A non-thread safe Federate of non-tracked function objects.
 /// For functions with the signature "void(void)"
 ///
-template<> class Federate<void(void), false, true> : public FederateBase<std::function<void(void)>, false, true>
+template<> class Federate<void(void), false, true> : public FederateBase<FederateMoveOnlyFunction<void(void)>, false, true>
 {
 	public:
 		/// To clean up the spelling throughout the function, define a type for our Federate functions.
-		typedef std::function<void(void)> FederateFunction;
+		typedef FederateMoveOnlyFunction<void(void)> FederateFunction;
+		typedef FederateBase<FederateFunction, false, true>::Slot Slot;
 
 		///
 		/// Invokes each of the functions in the Federate serially.
@@ -558,43 +5775,32 @@ template<> class Federate<void(void), false, true> : public FederateBase<std::fu
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
-			this->invokeTrackedFalse();
+			this->invokeSlots();
 		}
 
 		///
-		/// Invokes each of the functions in the Federate asynchronously.  
+		/// Invokes each of the functions in the Federate asynchronously.
 		/// Returns a vector of futures for the functions.vec.
 		///
 		std::vector<std::future<void>> invokeAsync()
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
-			return this->invokeAsyncTrackedFalse();
+			return this->invokeAsyncSlots();
 		}
 
 	protected:
-		void invokeTrackedFalse()
+		void invokeSlots()
 		{
-			for(auto& f : this->functions.vec)
+			this->forEachSlot([](Slot& f)
 			{
-				f();
-			}
+				FederateCall(f);
+			});
 		}
 
-		std::vector<std::future<void>> invokeAsyncTrackedFalse()
+		std::vector<std::future<void>> invokeAsyncSlots()
 		{
-			std::vector<std::future<void>> futures;
-
-			for(auto& f : this->functions.vec)
-			{
-				futures.emplace_back(std::async(std::launch::async,
-					[f]()
-				{
-					f();
-				}));
-			}
-
-			return futures;
+			return this->dispatchAsync();
 		}
 };
 
@@ -602,11 +5808,12 @@ template<> class Federate<void(void), false, true> : public FederateBase<std::fu
 /// A non-thread safe Federate of non-tracked function objects.
 /// For functions with the signature "void(void)"
 ///
-template<> class Federate<void(void), true, false> : public FederateBase<std::function<void(void)>, true, false>
+template<> class Federate<void(void), true, false> : public FederateBase<FederateMoveOnlyFunction<void(void)>, true, false>
 {
 	public:
 		/// To clean up the spelling throughout the function, define a type for our Federate functions.
-		typedef std::function<void(void)> FederateFunction;
+		typedef FederateMoveOnlyFunction<void(void)> FederateFunction;
+		typedef FederateBase<FederateFunction, true, false>::Slot Slot;
 
 		///
 		/// Invokes each of the functions in the Federate serially.
@@ -615,66 +5822,45 @@ template<> class Federate<void(void), true, false> : public FederateBase<std::fu
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
-			this->invokeTrackedTrue();
+			this->invokeSlots();
 		}
 
 		///
-		/// Invokes each of the functions in the Federate asynchronously.  
+		/// Invokes each of the functions in the Federate asynchronously.
 		/// Returns a vector of futures for the functions.vec.
 		///
 		std::vector<std::future<void>> invokeAsync()
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
-			return this->invokeAsyncTrackedTrue();
+			return this->invokeAsyncSlots();
 		}
 
 	protected:
-		void invokeTrackedTrue()
+		void invokeSlots()
 		{
-			for(auto& f : this->functions.vec)
+			this->forEachSlot([](Slot& f)
 			{
-				auto func = f.lock();
-
-				if(func != nullptr)
-				{
-					func.get()->operator()();
-				}
-			}
+				FederateCall(f);
+			});
 		}
 
-		std::vector<std::future<void>> invokeAsyncTrackedTrue()
+		std::vector<std::future<void>> invokeAsyncSlots()
 		{
-			std::vector<std::future<void>> futures;
-
-			for(auto& f : this->functions.vec)
-			{
-				auto func = f.lock();
-
-				if(func != nullptr)
-				{
-					futures.emplace_back(std::async(std::launch::async,
-						[func]()
-					{
-						func->operator()();
-					}));
-				}
-			}
-
-			return futures;
+			return this->dispatchAsync();
 		}
 };
 
-
 ///
 /// A non-thread safe Federate of non-tracked function objects.
 /// For functions with the signature "void(void)"
 ///
-template<> class Federate<void(void), true, true> : public FederateBase<std::function<void(void)>, true, true>
+template<> class Federate<void(void), true, true> : public FederateBase<FederateMoveOnlyFunction<void(void)>, true, true>
 {
 	public:
 		/// To clean up the spelling throughout the function, define a type for our Federate functions.
-		typedef std::function<void(void)> FederateFunction;
+		typedef FederateMoveOnlyFunction<void(void)> FederateFunction;
+		typedef FederateBase<FederateFunction, true, true>::Slot Slot;
 
 		///
 		/// Invokes each of the functions in the Federate serially.
@@ -683,54 +5869,40 @@ template<> class Federate<void(void), true, true> : public FederateBase<std::fun
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
-			this->invokeTrackedTrue();
+			this->invokeSlots();
 		}
 
 		///
-		/// Invokes each of the functions in the Federate asynchronously.  
+		/// Invokes each of the functions in the Federate asynchronously.
 		/// Returns a vector of futures for the functions.vec.
 		///
 		std::vector<std::future<void>> invokeAsync()
 		{
 			auto scopedLock = this->lock.acquire();
 			SuppressWarningUnusedVariable(scopedLock);
-			return this->invokeAsyncTrackedTrue();
+			return this->invokeAsyncSlots();
 		}
 
 	protected:
-		void invokeTrackedTrue()
+		void invokeSlots()
 		{
-			for(auto& f : this->functions.vec)
+			this->forEachSlot([](Slot& f)
 			{
-				auto func = f.lock();
-
-				if(func != nullptr)
-				{
-					func->operator()();
-				}
-			}
+				FederateCall(f);
+			});
 		}
 
-		std::vector<std::future<void>> invokeAsyncTrackedTrue()
+		std::vector<std::future<void>> invokeAsyncSlots()
 		{
-			std::vector<std::future<void>> futures;
-
-			for(auto& f : this->functions.vec)
-			{
-				auto func = f.lock();
-
-				if(func != nullptr)
-				{
-					futures.emplace_back(std::async(std::launch::async,
-						[func]()
-					{
-						func->operator()();
-					}));
-				}
-			}
-
-			return futures;
+			return this->dispatchAsync();
 		}
 };
 
+// Targets linking the Federate library use its compiled instantiations of the common signatures.  The library is
+// built as C++11, so a target with coroutines, whose Federates have members the library's lack, instantiates its own.
+#if defined(FEDERATE_EXTERN_TEMPLATES) && !defined(FEDERATE_HAS_COROUTINES)
+#include <Federate/FederateExtern.h>
+FEDERATE_INSTANTIATE(extern template)
+#endif
+
 #endif
@@ -0,0 +1,264 @@
+#ifndef H_HELLEBORECONSULTING_FEDERATEAFFINE_H
+#define H_HELLEBORECONSULTING_FEDERATEAFFINE_H
+
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+#include <Federate/Federate.h>
+
+#include <limits>
+
+// The AVX2 loop is built in whenever the compiler targets AVX2.  GCC and Clang on x86 also build it for other targets,
+// as a function compiled for AVX2, and take it only when the CPU has AVX2.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FEDERATE_AFFINE_AVX2
+#define FEDERATE_AFFINE_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FEDERATE_AFFINE_AVX2
+#define FEDERATE_AFFINE_AVX2_DISPATCH
+#define FEDERATE_AFFINE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+///
+///
+///
+template<typename T, bool ThreadSafe> class FederateAffine
+{
+};
+
+///
+/// A Federate of built-in arithmetic slots rather than functions: scale and offset, optionally clamped, and thresholds.
+///
+/// Every slot is stored as coefficients in parallel arrays and evaluated by one branch-free formula,
+///	y = (x >= threshold) ? clamp((scale == 0 ? 0 : scale * x) + offset, low, high) : below
+/// so "invoke" is a single vectorized pass rather than a function call per slot: AVX2 when the compiler targets it or,
+/// with GCC and Clang on x86, when the CPU has it; otherwise a loop the compiler can vectorize.
+/// Results are in the order the slots were added.
+///
+/// A zero scale ignores x, so thresholds (and constant slots) hold for infinite x rather than giving 0 * inf = NaN.
+/// A NaN from the sum (inf - inf) passes through the clamp, so an affine slot returns NaN as plain arithmetic would.
+/// Both paths give identical results for every input.
+///
+template<bool ThreadSafe> class FederateAffine<float(float), ThreadSafe>
+{
+	public:
+		FederateAffine()
+		{
+		}
+
+		///
+		/// Adds a slot returning "scale * x + offset".
+		///
+		void push_back_affine(float scale, float offset)
+		{
+			const auto infinity = std::numeric_limits<float>::infinity();
+			this->pushSlot(scale, offset, -infinity, infinity, -infinity, std::numeric_limits<float>::quiet_NaN());
+		}
+
+		///
+		/// Adds a slot returning "scale * x + offset" limited to [low, high].
+		///
+		void push_back_clamp(float scale, float offset, float low, float high)
+		{
+			const auto infinity = std::numeric_limits<float>::infinity();
+			this->pushSlot(scale, offset, low, high, -infinity, std::numeric_limits<float>::quiet_NaN());
+		}
+
+		///
+		/// Adds a slot returning "above" when x >= threshold and "below" otherwise (including when x is NaN).
+		///
+		void push_back_threshold(float threshold, float below, float above)
+		{
+			const auto infinity = std::numeric_limits<float>::infinity();
+			this->pushSlot(0.0f, above, -infinity, infinity, threshold, below);
+		}
+
+		///
+		/// Evaluates every slot for "x".  The new vector is zero-filled before the results are written to it;
+		/// "invokeSpan" and "invokeInto" write them to memory the caller already has.
+		///
+		std::vector<float> invoke(float x)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			std::vector<float> results(this->scale.size());
+			this->evaluate(x, results.data(), results.size());
+			return results;
+		}
+
+		///
+		/// As invoke, but writes the results to "out", which has room for "capacity" of them, and never allocates.
+		/// Returns the number of slots.  If that is more than "capacity", only the first "capacity" results are written.
+		///
+		size_t invokeSpan(float* out, size_t capacity, float x)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			const auto n = this->scale.size();
+			this->evaluate(x, out, (std::min)(n, capacity));
+			return n;
+		}
+
+		///
+		/// As invoke, but the results replace the contents of "results".  Once it has held as many results, it is
+		/// neither reallocated nor filled before they are written.
+		///
+		void invokeInto(std::vector<float>& results, float x)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			results.resize(this->scale.size());
+			this->evaluate(x, results.data(), results.size());
+		}
+
+		///
+		/// Returns the number of slots.
+		///
+		size_t size() const
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			return this->scale.size();
+		}
+
+		///
+		/// Returns true if there are no slots.
+		///
+		bool empty() const
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			return this->scale.empty();
+		}
+
+		///
+		/// Removes every slot.
+		///
+		void clear()
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			this->scale.clear();
+			this->offset.clear();
+			this->low.clear();
+			this->high.clear();
+			this->threshold.clear();
+			this->below.clear();
+		}
+
+	protected:
+		void pushSlot(float s, float o, float lo, float hi, float t, float b)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			this->scale.push_back(s);
+			this->offset.push_back(o);
+			this->low.push_back(lo);
+			this->high.push_back(hi);
+			this->threshold.push_back(t);
+			this->below.push_back(b);
+		}
+
+		///
+		/// Writes the results of the first "n" slots to "out".  The caller must hold the lock.
+		///
+		void evaluate(float x, float* out, size_t n) const
+		{
+			size_t i = 0;
+
+#if defined(FEDERATE_AFFINE_AVX2_DISPATCH)
+			if(FederateAffine::hasAvx2() == true)
+			{
+				i = this->evaluateAvx2(x, out, n);
+			}
+#elif defined(FEDERATE_AFFINE_AVX2)
+			i = this->evaluateAvx2(x, out, n);
+#endif
+
+			const auto s = this->scale.data();
+			const auto o = this->offset.data();
+			const auto lo = this->low.data();
+			const auto hi = this->high.data();
+			const auto t = this->threshold.data();
+			const auto b = this->below.data();
+
+			// Each comparison is false for NaN, which keeps "v".
+			for(; i < n; ++i)
+			{
+				auto v = ((s[i] != 0.0f) ? s[i] * x : 0.0f) + o[i];
+				v = (lo[i] > v) ? lo[i] : v;
+				v = (hi[i] < v) ? hi[i] : v;
+				out[i] = (x >= t[i]) ? v : b[i];
+			}
+		}
+
+#if defined(FEDERATE_AFFINE_AVX2)
+		///
+		/// Writes the results of the first "n" slots in whole groups of eight to "out".  Returns the number written.
+		///
+		FEDERATE_AFFINE_TARGET_AVX2 size_t evaluateAvx2(float x, float* out, size_t n) const
+		{
+			const auto s = this->scale.data();
+			const auto o = this->offset.data();
+			const auto lo = this->low.data();
+			const auto hi = this->high.data();
+			const auto t = this->threshold.data();
+			const auto b = this->below.data();
+
+			const auto vx = _mm256_set1_ps(x);
+			const auto zero = _mm256_setzero_ps();
+			size_t i = 0;
+
+			for(; i + 8 <= n; i += 8)
+			{
+				const auto vs = _mm256_loadu_ps(s + i);
+				const auto product = _mm256_and_ps(_mm256_mul_ps(vs, vx), _mm256_cmp_ps(vs, zero, _CMP_NEQ_UQ));
+
+				// max and min return their second operand for NaN, so a NaN sum passes through, as in the scalar loop.
+				auto v = _mm256_add_ps(product, _mm256_loadu_ps(o + i));
+				v = _mm256_min_ps(_mm256_loadu_ps(hi + i), _mm256_max_ps(_mm256_loadu_ps(lo + i), v));
+
+				const auto pass = _mm256_cmp_ps(vx, _mm256_loadu_ps(t + i), _CMP_GE_OQ);
+				_mm256_storeu_ps(out + i, _mm256_blendv_ps(_mm256_loadu_ps(b + i), v, pass));
+			}
+
+			return i;
+		}
+#endif
+
+#if defined(FEDERATE_AFFINE_AVX2_DISPATCH)
+		///
+		/// Returns true if the CPU runs AVX2.  Asked once: the answer does not change.
+		///
+		static bool hasAvx2()
+		{
+			static const bool supported = []()
+			{
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("avx2") != 0;
+			}();
+
+			return supported;
+		}
+#endif
+
+		std::vector<float> scale;
+		std::vector<float> offset;
+		std::vector<float> low;
+		std::vector<float> high;
+		std::vector<float> threshold;
+		std::vector<float> below;
+		MutexMember<ThreadSafe> lock;
+};
+
+#endif
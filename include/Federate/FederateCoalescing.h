@@ -0,0 +1,294 @@
+#ifndef H_HELLEBORECONSULTING_FEDERATECOALESCING_H
+#define H_HELLEBORECONSULTING_FEDERATECOALESCING_H
+
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+#include <Federate/Federate.h>
+
+#include <chrono>
+#include <new>
+#include <tuple>
+#include <type_traits>
+
+///
+///
+///
+template<typename T, bool Tracked, bool ThreadSafe> class FederateCoalescing
+{
+};
+
+///
+/// A Federate which merges rapid repeated emissions into a single pending argument pack.
+/// "emit" only merges; "flush" invokes every function once with the merged arguments.
+/// Listener work is proportional to the number of flushes rather than the number of emits.
+/// The pending arguments are built from the emitted ones, so they need not be default-constructible.
+///
+/// "invoke" and "invokeAsync" are still available and call the functions immediately.
+///
+template<typename... Args, bool Tracked, bool ThreadSafe> class FederateCoalescing<void(Args...), Tracked, ThreadSafe> : public Federate<void(Args...), Tracked, ThreadSafe>
+{
+	public:
+		/// The merged arguments waiting for the next flush.
+		typedef std::tuple<typename std::decay<Args>::type...> Pending;
+
+		///
+		/// Folds a newly emitted argument pack into the pending one.
+		/// It is only called when there is already something pending; the first emit after a flush is stored as-is.
+		///
+		typedef std::function<void(Pending&, Args...)> MergeFunction;
+
+		///
+		/// Keeps only the most recently emitted arguments.
+		///
+		FederateCoalescing() : merge(), window(std::chrono::steady_clock::duration::zero()), coalesced(0)
+		{
+		}
+
+		///
+		/// Merges emissions with the given function.
+		///
+		/// If "window" is non-zero, an emit that arrives "window" or more after the first pending emit flushes at once.
+		/// There is no timer: the last emits of a burst stay pending until something flushes them, so call "flushDue"
+		/// from a frame loop or a periodic timer (or "flush") to bound their latency.
+		///
+		explicit FederateCoalescing(MergeFunction m, std::chrono::steady_clock::duration w = std::chrono::steady_clock::duration::zero()) :
+			merge(std::move(m)),
+			window(w),
+			coalesced(0)
+		{
+		}
+
+		///
+		/// Merges the arguments into the pending argument pack without calling any functions.
+		///
+		void emit(Args... args)
+		{
+			bool flushNow = false;
+
+			{
+				auto scopedLock = this->pendingLock.acquire();
+				SuppressWarningUnusedVariable(scopedLock);
+
+				if(this->pendingArgs.full() == false)
+				{
+					this->pendingArgs.emplace(args...);
+					this->firstPending = this->windowStart();
+				}
+				else if(this->merge)
+				{
+					this->merge(this->pendingArgs.get(), args...);
+				}
+				else
+				{
+					this->pendingArgs.emplace(args...);
+				}
+
+				++this->coalesced;
+
+				flushNow = (this->window != std::chrono::steady_clock::duration::zero())
+					&& (std::chrono::steady_clock::now() - this->firstPending >= this->window);
+			}
+
+			if(flushNow == true)
+			{
+				this->flush();
+			}
+		}
+
+		///
+		/// Invokes each of the functions once with the pending arguments and clears them.
+		/// Returns false if nothing was pending.
+		///
+		bool flush()
+		{
+			PendingBuffer args;
+
+			{
+				auto scopedLock = this->pendingLock.acquire();
+				SuppressWarningUnusedVariable(scopedLock);
+
+				if(this->pendingArgs.full() == false)
+				{
+					return false;
+				}
+
+				args.emplace(std::move(this->pendingArgs.get()));
+				this->pendingArgs.reset();
+				this->coalesced = 0;
+			}
+
+			this->invokePending(args.get(), typename FederateMakeIndexSequence<sizeof...(Args)>::type());
+			return true;
+		}
+
+		///
+		/// Flushes if the pending arguments have waited "window" or more.  Returns false if nothing was flushed.
+		/// This is the timer the window needs; without a window it flushes whatever is pending.
+		///
+		bool flushDue()
+		{
+			{
+				auto scopedLock = this->pendingLock.acquire();
+				SuppressWarningUnusedVariable(scopedLock);
+
+				if(this->pendingArgs.full() == false)
+				{
+					return false;
+				}
+
+				if(this->window != std::chrono::steady_clock::duration::zero() && std::chrono::steady_clock::now() - this->firstPending < this->window)
+				{
+					return false;
+				}
+			}
+
+			return this->flush();
+		}
+
+		///
+		/// Returns true if an emit is waiting for the next flush.
+		///
+		bool pending() const
+		{
+			auto scopedLock = this->pendingLock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			return this->pendingArgs.full();
+		}
+
+		///
+		/// Returns how many emits have been merged into the pending arguments since the last flush.
+		///
+		size_t pendingCount() const
+		{
+			auto scopedLock = this->pendingLock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+			return this->coalesced;
+		}
+
+	protected:
+		///
+		/// Room for one pending argument pack, empty until an emit constructs it there.
+		///
+		class PendingBuffer
+		{
+			public:
+				PendingBuffer() : hasValue(false)
+				{
+				}
+
+				PendingBuffer(const PendingBuffer& x) : hasValue(false)
+				{
+					if(x.hasValue == true)
+					{
+						this->emplace(x.get());
+					}
+				}
+
+				PendingBuffer(PendingBuffer&& x) : hasValue(false)
+				{
+					if(x.hasValue == true)
+					{
+						this->emplace(std::move(x.get()));
+						x.reset();
+					}
+				}
+
+				~PendingBuffer()
+				{
+					this->reset();
+				}
+
+				PendingBuffer& operator=(const PendingBuffer& x)
+				{
+					if(this != &x)
+					{
+						this->reset();
+
+						if(x.hasValue == true)
+						{
+							this->emplace(x.get());
+						}
+					}
+
+					return *this;
+				}
+
+				PendingBuffer& operator=(PendingBuffer&& x)
+				{
+					if(this != &x)
+					{
+						this->reset();
+
+						if(x.hasValue == true)
+						{
+							this->emplace(std::move(x.get()));
+							x.reset();
+						}
+					}
+
+					return *this;
+				}
+
+				///
+				/// Replaces the contents with a Pending built from "values".
+				///
+				template<typename... Values> void emplace(Values&&... values)
+				{
+					this->reset();
+					new(&this->storage) Pending(std::forward<Values>(values)...);
+					this->hasValue = true;
+				}
+
+				void reset()
+				{
+					if(this->hasValue == true)
+					{
+						this->get().~Pending();
+						this->hasValue = false;
+					}
+				}
+
+				bool full() const
+				{
+					return this->hasValue;
+				}
+
+				Pending& get()
+				{
+					return *reinterpret_cast<Pending*>(&this->storage);
+				}
+
+				const Pending& get() const
+				{
+					return *reinterpret_cast<const Pending*>(&this->storage);
+				}
+
+			private:
+				typename std::aligned_storage<sizeof(Pending), std::alignment_of<Pending>::value>::type storage;
+				bool hasValue;
+		};
+
+		template<size_t... Is> void invokePending(Pending& args, FederateIndexSequence<Is...>)
+		{
+			this->invoke(std::get<Is>(args)...);
+		}
+
+		std::chrono::steady_clock::time_point windowStart() const
+		{
+			// Only pay for the clock read when a window is in use.
+			return (this->window != std::chrono::steady_clock::duration::zero()) ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+		}
+
+		MergeFunction merge;
+		std::chrono::steady_clock::duration window;
+		std::chrono::steady_clock::time_point firstPending;
+		PendingBuffer pendingArgs;
+		size_t coalesced;
+		MutexMember<ThreadSafe> pendingLock;
+};
+
+#endif
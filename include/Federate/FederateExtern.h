@@ -0,0 +1,47 @@
+#ifndef H_HELLEBORECONSULTING_FEDERATEEXTERN_H
+#define H_HELLEBORECONSULTING_FEDERATEEXTERN_H
+
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+#include <string>
+
+///
+/// The Federates compiled into the Federate library: every combination of Tracked and ThreadSafe for the common
+/// signatures below.  The library instantiates them one signature per translation unit (src/FederateInt.cpp and so on),
+/// so it builds in parallel and, with section garbage collection, a consumer keeps only the code it calls.  Federate.h
+/// declares them with FEDERATE_INSTANTIATE(extern template) when FEDERATE_EXTERN_TEMPLATES is defined, as it is for
+/// targets linking the library, so those translation units reuse the library's code instead of instantiating their own.
+/// A signature added here needs its own source file too.
+///
+/// The library is compiled as C++11, without coroutines.  A consumer built with coroutines (C++20) declares different
+/// Federate classes, so Federate.h skips the extern declarations there and the consumer instantiates its own; nothing
+/// then pulls the library's objects into the link.
+///
+/// The void(void) Federates are explicit specializations, so only their base and function wrapper are listed.
+///
+#define FEDERATE_INSTANTIATE_BASE(PREFIX, SIGNATURE) \
+	PREFIX class FederateMoveOnlyFunction<SIGNATURE>; \
+	PREFIX class FederateBase<FederateMoveOnlyFunction<SIGNATURE>, false, false>; \
+	PREFIX class FederateBase<FederateMoveOnlyFunction<SIGNATURE>, false, true>; \
+	PREFIX class FederateBase<FederateMoveOnlyFunction<SIGNATURE>, true, false>; \
+	PREFIX class FederateBase<FederateMoveOnlyFunction<SIGNATURE>, true, true>;
+
+#define FEDERATE_INSTANTIATE_SIGNATURE(PREFIX, SIGNATURE) \
+	FEDERATE_INSTANTIATE_BASE(PREFIX, SIGNATURE) \
+	PREFIX class Federate<SIGNATURE, false, false>; \
+	PREFIX class Federate<SIGNATURE, false, true>; \
+	PREFIX class Federate<SIGNATURE, true, false>; \
+	PREFIX class Federate<SIGNATURE, true, true>;
+
+#define FEDERATE_INSTANTIATE(PREFIX) \
+	FEDERATE_INSTANTIATE_BASE(PREFIX, void(void)) \
+	FEDERATE_INSTANTIATE_SIGNATURE(PREFIX, void(bool)) \
+	FEDERATE_INSTANTIATE_SIGNATURE(PREFIX, void(int)) \
+	FEDERATE_INSTANTIATE_SIGNATURE(PREFIX, void(double)) \
+	FEDERATE_INSTANTIATE_SIGNATURE(PREFIX, void(const std::string&))
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef H_HELLEBORECONSULTING_FEDERATEFWD_H
+#define H_HELLEBORECONSULTING_FEDERATEFWD_H
+
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+///
+/// Declarations of the Federate types, without the standard headers their definitions need.
+/// Headers which only name a Federate (as a member pointer, a reference parameter or a friend) can include this
+/// instead of Federate.h; the translation units which use it include the header which defines it.
+/// The default template arguments live here.  FederateRegistry is not declared, as its default hash needs <functional>.
+///
+
+template<typename T> class FederateMoveOnlyFunction;
+template<typename FederateFunction, bool Tracked, bool ThreadSafe> class FederateBase;
+
+template<typename T, bool Tracked = false, bool ThreadSafe = false> class Federate;
+template<typename T, bool ThreadSafe = false> class FederateAffine;
+template<typename T, bool Tracked = false, bool ThreadSafe = false> class FederateCoalescing;
+template<typename T> class FederateRecorder;
+template<typename T> class FederateReplay;
+template<typename T, bool ThreadSafe = false> class FederateSharedMemory;
+template<typename T, bool Tracked = false> class FederateSingleProducer;
+
+class FederateExecutor;
+class FederateReclaimer;
+class FederateScopedConnection;
+class FederateThreadPool;
+
+struct FederateError;
+struct FederateMemoryUsage;
+
+enum class FederateErrorPolicy;
+enum class FederateReplaySpeed;
+
+#endif
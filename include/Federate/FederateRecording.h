@@ -0,0 +1,430 @@
+#ifndef H_HELLEBORECONSULTING_FEDERATERECORDING_H
+#define H_HELLEBORECONSULTING_FEDERATERECORDING_H
+
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+#include <Federate/Federate.h>
+
+// Memory-mapped files: POSIX only.
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+///
+/// How FederateReplay paces the records it plays back.
+///
+enum class FederateReplaySpeed
+{
+	/// Keep the gaps between invocations as they were recorded.
+	Original,
+
+	/// Invoke back to back.
+	Maximum
+};
+
+///
+/// The layout shared by FederateRecorder and FederateReplay: a header, then one record per invocation holding the
+/// nanoseconds since recording began and the packed arguments.
+///
+/// Version 2 added "layout", the FederatePackedArgs::layout of the recorded signature, so that a log is only replayed
+/// into a signature whose arguments have the same sizes, alignments and kinds, not just the same total size.
+///
+struct FederateRecordingFormat
+{
+	static const uint32_t Magic = 0xFEDE10C0;
+	static const uint32_t Version = 2;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t recordSize;
+		uint64_t count;
+		uint64_t layout;
+	};
+};
+
+///
+///
+///
+template<typename T> class FederateRecorder
+{
+};
+
+///
+/// Appends the (trivially copyable) arguments of every invocation of a Federate to a compact binary log for offline
+/// profiling and replay.
+///
+/// The log is a memory-mapped file grown by doubling, so a record costs a timestamp and a copy of the arguments.
+/// The header's count is updated after every record, so a log cut short by a crash still replays up to the last
+/// complete record.  Attach it with "federate.setRecorder(recorder.hook())"; the recorder must outlive the hook.
+/// The constructor throws std::system_error if the file cannot be created or mapped.  Recording never throws: a record
+/// that does not fit because the log cannot grow is dropped and counted, the log keeps its mapping, and "error" reports
+/// why.  Later records try to grow the log again.
+///
+template<typename R, typename... Args> class FederateRecorder<R(Args...)>
+{
+	public:
+		typedef FederatePackedArgs<Args...> Packed;
+
+		///
+		/// Creates (or truncates) the log at "path".
+		///
+		explicit FederateRecorder(const std::string& path) :
+			fd(-1),
+			memory(nullptr),
+			mapped(0),
+			used(sizeof(FederateRecordingFormat::Header)),
+			recordSize(sizeof(uint64_t) + Packed::size()),
+			droppedRecords(0),
+			start(std::chrono::steady_clock::now())
+		{
+			this->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+			if(this->fd < 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "open " + path);
+			}
+
+			try
+			{
+				this->grow(64 * 1024);
+			}
+			catch(...)
+			{
+				::close(this->fd);
+				throw;
+			}
+
+			auto header = this->header();
+			header->magic = FederateRecordingFormat::Magic;
+			header->version = FederateRecordingFormat::Version;
+			header->recordSize = this->recordSize;
+			header->count = 0;
+			header->layout = Packed::layout();
+		}
+
+		~FederateRecorder()
+		{
+			try
+			{
+				this->close();
+			}
+			catch(...)
+			{
+			}
+		}
+
+		FederateRecorder(const FederateRecorder&) = delete;
+		FederateRecorder& operator=(const FederateRecorder&) = delete;
+
+		///
+		/// Appends one invocation.  Safe to call from several threads.
+		///
+		void record(Args... args)
+		{
+			std::lock_guard<std::mutex> scopedLock(this->mutex);
+
+			// Timestamped under the lock so that records are in time order.
+			const auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count());
+
+			if(this->memory == nullptr)
+			{
+				return;
+			}
+
+			if(this->used + this->recordSize > this->mapped)
+			{
+				try
+				{
+					this->grow(this->mapped * 2);
+				}
+				catch(const std::system_error& e)
+				{
+					this->lastError = e.code();
+					++this->droppedRecords;
+					return;
+				}
+			}
+
+			auto out = this->memory + this->used;
+			std::memcpy(out, &elapsed, sizeof(elapsed));
+			Packed::write(out + sizeof(uint64_t), args...);
+
+			this->used += this->recordSize;
+			++this->header()->count;
+		}
+
+		///
+		/// Returns a hook for Federate::setRecorder which records into this log.
+		///
+		FederateMoveOnlyFunction<void(Args...)> hook()
+		{
+			return [this](Args... args)
+			{
+				this->record(args...);
+			};
+		}
+
+		///
+		/// Returns the number of records written.
+		///
+		size_t size() const
+		{
+			std::lock_guard<std::mutex> scopedLock(this->mutex);
+			return (this->memory == nullptr) ? 0 : static_cast<size_t>(this->header()->count);
+		}
+
+		///
+		/// Returns the number of records dropped because the log could not grow.
+		///
+		size_t dropped() const
+		{
+			std::lock_guard<std::mutex> scopedLock(this->mutex);
+			return this->droppedRecords;
+		}
+
+		///
+		/// Returns why the last record was dropped, or an empty error code if none was.
+		///
+		std::error_code error() const
+		{
+			std::lock_guard<std::mutex> scopedLock(this->mutex);
+			return this->lastError;
+		}
+
+		///
+		/// Trims the file to the records written and closes it.  Later records are dropped.
+		///
+		void close()
+		{
+			std::lock_guard<std::mutex> scopedLock(this->mutex);
+
+			if(this->memory == nullptr)
+			{
+				return;
+			}
+
+			::munmap(this->memory, this->mapped);
+			this->memory = nullptr;
+
+			const auto trimmed = ::ftruncate(this->fd, static_cast<off_t>(this->used));
+			const auto error = errno;
+
+			::close(this->fd);
+			this->fd = -1;
+
+			if(trimmed != 0)
+			{
+				throw std::system_error(error, std::generic_category(), "ftruncate");
+			}
+		}
+
+	protected:
+		FederateRecordingFormat::Header* header() const
+		{
+			return reinterpret_cast<FederateRecordingFormat::Header*>(this->memory);
+		}
+
+		///
+		/// Extends the file to "bytes" and maps it again.  The caller must hold the mutex (or be the constructor).
+		/// Throws std::system_error on failure, leaving the old mapping in place.
+		///
+		void grow(size_t bytes)
+		{
+			if(::ftruncate(this->fd, static_cast<off_t>(bytes)) != 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "ftruncate");
+			}
+
+			auto m = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+
+			if(m == MAP_FAILED)
+			{
+				throw std::system_error(errno, std::generic_category(), "mmap");
+			}
+
+			if(this->memory != nullptr)
+			{
+				::munmap(this->memory, this->mapped);
+			}
+
+			this->memory = static_cast<char*>(m);
+			this->mapped = bytes;
+		}
+
+		int fd;
+		char* memory;
+		size_t mapped;
+		size_t used;
+		const size_t recordSize;
+		size_t droppedRecords;
+		std::error_code lastError;
+		const std::chrono::steady_clock::time_point start;
+		mutable std::mutex mutex;
+};
+
+///
+///
+///
+template<typename T> class FederateReplay
+{
+};
+
+///
+/// Reads a log written by FederateRecorder and re-drives a Federate with the same signature from it.
+/// Throws std::system_error if the file cannot be read or was recorded with a different argument layout.
+///
+template<typename R, typename... Args> class FederateReplay<R(Args...)>
+{
+	public:
+		typedef FederatePackedArgs<Args...> Packed;
+
+		explicit FederateReplay(const std::string& path) : memory(nullptr), mapped(0), count(0), recordSize(sizeof(uint64_t) + Packed::size())
+		{
+			auto fd = ::open(path.c_str(), O_RDONLY);
+
+			if(fd < 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "open " + path);
+			}
+
+			struct stat info;
+
+			if(::fstat(fd, &info) != 0)
+			{
+				const auto error = errno;
+				::close(fd);
+				throw std::system_error(error, std::generic_category(), "fstat " + path);
+			}
+
+			this->mapped = static_cast<size_t>(info.st_size);
+
+			if(this->mapped < sizeof(FederateRecordingFormat::Header))
+			{
+				::close(fd);
+				throw std::system_error(EINVAL, std::generic_category(), "not a recording: " + path);
+			}
+
+			auto m = ::mmap(nullptr, this->mapped, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+
+			if(m == MAP_FAILED)
+			{
+				throw std::system_error(errno, std::generic_category(), "mmap " + path);
+			}
+
+			this->memory = static_cast<const char*>(m);
+
+			const auto header = reinterpret_cast<const FederateRecordingFormat::Header*>(this->memory);
+
+			if(header->magic != FederateRecordingFormat::Magic || header->version != FederateRecordingFormat::Version)
+			{
+				this->unmap();
+				throw std::system_error(EINVAL, std::generic_category(), "not a recording of this version: " + path);
+			}
+
+			if(header->recordSize != this->recordSize || header->layout != Packed::layout())
+			{
+				this->unmap();
+				throw std::system_error(EINVAL, std::generic_category(), "signature mismatch for " + path);
+			}
+
+			// Trust only records that are both counted and complete.
+			const auto complete = (this->mapped - sizeof(FederateRecordingFormat::Header)) / this->recordSize;
+			this->count = std::min(static_cast<size_t>(header->count), complete);
+		}
+
+		~FederateReplay()
+		{
+			this->unmap();
+		}
+
+		FederateReplay(const FederateReplay&) = delete;
+		FederateReplay& operator=(const FederateReplay&) = delete;
+
+		///
+		/// Returns the number of records.
+		///
+		size_t size() const
+		{
+			return this->count;
+		}
+
+		///
+		/// Returns the time between the first and last records.
+		///
+		std::chrono::nanoseconds duration() const
+		{
+			if(this->count == 0)
+			{
+				return std::chrono::nanoseconds(0);
+			}
+
+			return std::chrono::nanoseconds(this->timeAt(this->count - 1) - this->timeAt(0));
+		}
+
+		///
+		/// Invokes "federate" once per record, in order.  Returns the number of invocations.
+		///
+		template<typename F> size_t replay(F& federate, FederateReplaySpeed speed = FederateReplaySpeed::Maximum) const
+		{
+			typename Packed::Values values;
+			const auto begin = std::chrono::steady_clock::now();
+
+			for(size_t i = 0; i < this->count; ++i)
+			{
+				if(speed == FederateReplaySpeed::Original)
+				{
+					std::this_thread::sleep_until(begin + std::chrono::nanoseconds(this->timeAt(i) - this->timeAt(0)));
+				}
+
+				Packed::read(this->recordAt(i) + sizeof(uint64_t), values);
+				Packed::invoke(federate, values);
+			}
+
+			return this->count;
+		}
+
+	protected:
+		const char* recordAt(size_t i) const
+		{
+			return this->memory + sizeof(FederateRecordingFormat::Header) + i * this->recordSize;
+		}
+
+		uint64_t timeAt(size_t i) const
+		{
+			uint64_t t;
+			std::memcpy(&t, this->recordAt(i), sizeof(t));
+			return t;
+		}
+
+		void unmap()
+		{
+			if(this->memory != nullptr)
+			{
+				::munmap(const_cast<char*>(this->memory), this->mapped);
+				this->memory = nullptr;
+			}
+		}
+
+		const char* memory;
+		size_t mapped;
+		size_t count;
+		const size_t recordSize;
+};
+
+#endif
+
+#endif
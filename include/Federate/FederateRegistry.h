@@ -0,0 +1,906 @@
+#ifndef H_HELLEBORECONSULTING_FEDERATEREGISTRY_H
+#define H_HELLEBORECONSULTING_FEDERATEREGISTRY_H
+
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+#include <Federate/Federate.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+///
+/// Identifies one function added to a FederateRegistry so it can be erased later.
+///
+typedef uint64_t FederateRegistryConnection;
+
+///
+/// How a FederateRegistry matches prefix subscriptions against its keys.
+/// Specialize it for other string-like keys; keys without a specialization cannot take prefix subscriptions.
+///
+template<typename Key> struct FederateRegistryPrefix
+{
+	static const bool Supported = false;
+};
+
+template<typename C, typename T, typename A> struct FederateRegistryPrefix<std::basic_string<C, T, A>>
+{
+	typedef std::basic_string<C, T, A> Key;
+
+	static const bool Supported = true;
+
+	static size_t length(const Key& key)
+	{
+		return key.size();
+	}
+
+	static bool matches(const Key& key, const Key& prefix)
+	{
+		return key.size() >= prefix.size() && key.compare(0, prefix.size(), prefix) == 0;
+	}
+
+	static Key truncate(const Key& key, size_t length)
+	{
+		return Key(key, 0, length);
+	}
+};
+
+///
+///
+///
+template<typename Key, typename T, bool ThreadSafe = false, typename Hash = std::hash<Key>> class FederateRegistry
+{
+};
+
+///
+/// Many Federates keyed by topic, stored in one flat open-addressing table.
+///
+/// Each topic owns a contiguous list of functions, one allocation of the slots, so "invoke" is a hash probe followed
+/// by a linear walk.  Lists are copy-on-write: a change builds new lists for the topics it touches under the
+/// registry's lock and publishes them through atomic pointers.  "invoke" and "size" take no lock: they register
+/// with the current epoch, an atomic increment and a check, then read the table and the list directly.
+///
+/// What a change replaces -- lists, functions, tables -- is retired rather than freed, and freed by a later change
+/// once every reader which could still be walking it has left.  A function may therefore emit on any topic or
+/// subscribe without deadlock, and emitters do not wait for each other or for writers.  Retired memory is freed on
+/// writers' threads, at most two changes after the last reader of it leaves, or when the registry is destroyed.
+/// When ThreadSafe, the same function may run on several threads at once.
+///
+/// New topics are written into the table in place.  The table is only rebuilt, at double the size, once it is half
+/// full, so adding a topic costs the same however many there are.
+///
+/// Topics are created by "push_back" and removed once "erase" or "clear" leaves them without push_back functions.
+/// A removed topic's entry is reused if its key comes back, and dropped when the table is next rebuilt.
+///
+/// Prefix subscriptions ("push_back_prefix") are compiled into the lists of the topics they match, when either is
+/// created.  A key with no topic is matched against the prefix subscriptions on each emit instead, so emitting on
+/// arbitrary keys never grows the table.  They need a key type with a FederateRegistryPrefix, such as std::string.
+///
+template<typename Key, typename R, typename... Args, bool ThreadSafe, typename Hash> class FederateRegistry<Key, R(Args...), ThreadSafe, Hash>
+{
+	public:
+		/// To clean up the spelling throughout the function, define a type for our Federate functions.
+		typedef FederateMoveOnlyFunction<R(Args...)> FederateFunction;
+
+		typedef FederateRegistryPrefix<Key> Prefix;
+
+		FederateRegistry() :
+			current(new Table(size_t(MinBuckets))),
+			currentPrefixes(new PrefixIndex()),
+			liveTopics(0),
+			epoch(0),
+			nextConnection(1)
+		{
+			for(auto& x : this->readers)
+			{
+				x.store(0);
+			}
+		}
+
+		~FederateRegistry()
+		{
+			for(auto& retired : this->retired)
+			{
+				FederateRegistry::destroyAll(retired);
+			}
+
+			this->destroyContents();
+		}
+
+		FederateRegistry(const FederateRegistry&) = delete;
+		FederateRegistry& operator=(const FederateRegistry&) = delete;
+
+		///
+		/// Adds a new function to the end of the topic's list.
+		///
+		FederateRegistryConnection push_back(const Key& key, FederateFunction f)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			Slot slot = {new FederateFunction(std::move(f)), this->nextConnection++};
+			Exact exact = {key, slot.function};
+			this->exactTopics[slot.connection] = std::move(exact);
+
+			auto& topic = this->findOrCreateTopic(key, this->hasher(key));
+			auto slots = topic.slots.load();
+
+			if(slots == nullptr)
+			{
+				this->setSlots(topic, this->prefixSlots(key, &slot));
+			}
+			else
+			{
+				this->setSlots(topic, FederateRegistry::withSlot(*slots, slot));
+			}
+
+			++topic.exact;
+			this->advance();
+			return slot.connection;
+		}
+
+		///
+		/// Adds a function to every topic, present and future, whose key begins with "prefix".
+		///
+		FederateRegistryConnection push_back_prefix(const Key& prefix, FederateFunction f)
+		{
+			static_assert(Prefix::Supported == true, "Prefix subscriptions need a key with a FederateRegistryPrefix, such as std::string.");
+
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			Slot slot = {new FederateFunction(std::move(f)), this->nextConnection++};
+
+			for(auto topic : this->current.load()->topics)
+			{
+				auto slots = topic->slots.load();
+
+				if(slots != nullptr && Prefix::matches(topic->key, prefix) == true)
+				{
+					this->setSlots(*topic, FederateRegistry::withSlot(*slots, slot));
+				}
+			}
+
+			auto index = new PrefixIndex(*this->currentPrefixes.load());
+			PrefixSubscription subscription = {prefix, slot};
+			index->subscriptions.push_back(std::move(subscription));
+			this->publishPrefixes(index);
+
+			this->advance();
+			return slot.connection;
+		}
+
+		///
+		/// Removes a function added by push_back or push_back_prefix, and any topic it leaves without push_back
+		/// functions.  Returns false if it was not found.
+		/// Erasing a push_back function only rebuilds its own topic's list; a prefix subscription, those of the topics
+		/// it matched.
+		///
+		bool erase(FederateRegistryConnection connection)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			auto exact = this->exactTopics.find(connection);
+
+			if(exact != std::end(this->exactTopics))
+			{
+				auto topic = FederateRegistry::findTopic(*this->current.load(), exact->second.key, this->hasher(exact->second.key));
+
+				--topic->exact;
+				this->setSlots(*topic, (topic->exact == 0) ? nullptr : FederateRegistry::withoutSlot(*topic->slots.load(), connection));
+				this->retire(exact->second.function);
+				this->exactTopics.erase(exact);
+
+				this->advance();
+				return true;
+			}
+
+			return this->erasePrefix(connection, std::integral_constant<bool, Prefix::Supported>());
+		}
+
+		///
+		/// Invokes each of the topic's functions serially, as they were when the call began, without taking the lock.
+		/// Returns an empty vector if nothing is listening on the topic.
+		///
+		typename std::conditional<std::is_void<R>::value, void, std::vector<R>>::type invoke(const Key& key, Args... args)
+		{
+			// Keeps whatever is read from being freed until the walk is over.
+			Reader reader(*this);
+			SuppressWarningUnusedVariable(reader);
+
+			auto topic = FederateRegistry::findTopic(*this->current.load(), key, this->hasher(key));
+			auto slots = (topic != nullptr) ? topic->slots.load() : nullptr;
+
+			if(slots != nullptr)
+			{
+				return this->invokeSlots(*slots, std::is_void<R>(), args...);
+			}
+
+			return this->invokePrefixes(key, std::integral_constant<bool, Prefix::Supported>(), std::is_void<R>(), args...);
+		}
+
+		///
+		/// Returns the number of functions listening on a topic, including prefix subscriptions.
+		///
+		size_t size(const Key& key) const
+		{
+			Reader reader(*this);
+			SuppressWarningUnusedVariable(reader);
+
+			auto topic = FederateRegistry::findTopic(*this->current.load(), key, this->hasher(key));
+			auto slots = (topic != nullptr) ? topic->slots.load() : nullptr;
+
+			if(slots != nullptr)
+			{
+				return slots->count;
+			}
+
+			size_t n = 0;
+
+			this->visitPrefixes(key, std::integral_constant<bool, Prefix::Supported>(), [&n](FederateFunction&)
+			{
+				++n;
+			});
+
+			return n;
+		}
+
+		///
+		/// Returns the number of topics with push_back functions.
+		///
+		size_t topicCount() const
+		{
+			return this->liveTopics.load(std::memory_order_relaxed);
+		}
+
+		///
+		/// Removes the functions added to one topic by push_back, and so the topic.  Prefix subscriptions stay, and
+		/// still match the key.
+		///
+		void clear(const Key& key)
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			auto topic = FederateRegistry::findTopic(*this->current.load(), key, this->hasher(key));
+			auto slots = (topic != nullptr) ? topic->slots.load() : nullptr;
+
+			if(slots != nullptr)
+			{
+				for(auto slot = slots->begin(); slot != slots->end(); ++slot)
+				{
+					auto exact = this->exactTopics.find(slot->connection);
+
+					if(exact != std::end(this->exactTopics))
+					{
+						this->retire(exact->second.function);
+						this->exactTopics.erase(exact);
+					}
+				}
+
+				topic->exact = 0;
+				this->setSlots(*topic, nullptr);
+				this->advance();
+			}
+		}
+
+		///
+		/// Removes every topic, function and prefix subscription.
+		///
+		void clear()
+		{
+			auto scopedLock = this->lock.acquire();
+			SuppressWarningUnusedVariable(scopedLock);
+
+			auto table = this->current.load();
+			auto prefixes = this->currentPrefixes.load();
+
+			this->current.store(new Table(size_t(MinBuckets)));
+			this->currentPrefixes.store(new PrefixIndex());
+
+			for(auto topic : table->topics)
+			{
+				this->retire(topic->slots.load());
+				this->retire(topic);
+			}
+
+			for(auto& exact : this->exactTopics)
+			{
+				this->retire(exact.second.function);
+			}
+
+			for(auto& prefix : prefixes->subscriptions)
+			{
+				this->retire(prefix.slot.function);
+			}
+
+			this->retire(table);
+			this->retire(prefixes);
+			this->exactTopics.clear();
+			this->liveTopics.store(0, std::memory_order_relaxed);
+			this->advance();
+		}
+
+	protected:
+		///
+		/// A function in a list.  The registry owns the function: push_back ones through "exactTopics", prefix ones
+		/// through the current PrefixIndex.
+		///
+		struct Slot
+		{
+			FederateFunction* function;
+			FederateRegistryConnection connection;
+		};
+
+		///
+		/// A topic's list: "count" slots, in the same allocation, straight after the header.  Never changed once
+		/// published; changes build a new one and publish it in its place.  Slots are in the order they were added.
+		///
+		struct SlotList
+		{
+			static SlotList* make(size_t n)
+			{
+				auto x = new(::operator new(sizeof(SlotList) + n * sizeof(Slot))) SlotList();
+				x->count = n;
+				return x;
+			}
+
+			static void operator delete(void* x)
+			{
+				::operator delete(x);
+			}
+
+			Slot* begin()
+			{
+				return reinterpret_cast<Slot*>(this + 1);
+			}
+
+			Slot* end()
+			{
+				return this->begin() + this->count;
+			}
+
+			size_t count;
+		};
+
+		struct PrefixSubscription
+		{
+			Key prefix;
+			Slot slot;
+		};
+
+		///
+		/// The prefix subscriptions, in the order they were added, and what "invoke" needs to tell quickly whether an
+		/// unseen key matches any of them.  Never changed once published.
+		///
+		struct PrefixIndex
+		{
+			std::vector<PrefixSubscription> subscriptions;
+			std::multiset<Key> keys;
+			std::set<size_t> lengths;
+		};
+
+		///
+		/// A push_back function: the topic it is in, and the function, which the registry owns.
+		///
+		struct Exact
+		{
+			Key key;
+			FederateFunction* function;
+		};
+
+		///
+		/// "slots" is null while the topic has no push_back functions, "exact" of them.
+		///
+		struct Topic
+		{
+			Key key;
+			size_t hash;
+			std::atomic<SlotList*> slots;
+
+			/// Only used under the lock.
+			size_t exact;
+		};
+
+		///
+		/// The open-addressing table "invoke" reads.  Buckets go from empty to a topic, in place and under the lock,
+		/// and never change after that, so readers probe them without the lock.
+		///
+		struct Table
+		{
+			explicit Table(size_t n) : buckets(new std::atomic<Topic*>[n]), mask(n - 1)
+			{
+				for(size_t i = 0; i < n; ++i)
+				{
+					this->buckets[i].store(nullptr, std::memory_order_relaxed);
+				}
+			}
+
+			std::unique_ptr<std::atomic<Topic*>[]> buckets;
+			size_t mask;
+
+			/// The topics in "buckets".  Only used under the lock.
+			std::vector<Topic*> topics;
+		};
+
+		///
+		/// Something replaced, waiting for the readers which might still see it to leave.
+		///
+		struct Retired
+		{
+			void (*destroy)(void*);
+			void* object;
+		};
+
+		///
+		/// Registers a reader with the current epoch for as long as it lives.  Any thread, without the lock.
+		///
+		/// Epochs only advance under the lock, and only from "e" to "e + 1" once no reader is left in "e - 1", so every
+		/// reader is in one of the last two.  What is retired in epoch "e" is freed on the advance to "e + 2".
+		///
+		struct Reader
+		{
+			explicit Reader(const FederateRegistry& x) : registry(x)
+			{
+				for(;;)
+				{
+					const auto e = this->registry.epoch.load();
+					this->counter = &this->registry.readers[e % Epochs];
+					this->counter->fetch_add(1);
+
+					// Counted in an epoch which has since moved on: it may already have been waited for.
+					if(this->registry.epoch.load() == e)
+					{
+						return;
+					}
+
+					this->counter->fetch_sub(1);
+				}
+			}
+
+			~Reader()
+			{
+				this->counter->fetch_sub(1);
+			}
+
+			Reader(const Reader&) = delete;
+			Reader& operator=(const Reader&) = delete;
+
+			const FederateRegistry& registry;
+			std::atomic<size_t>* counter;
+		};
+
+		static const size_t MinBuckets = 16;
+		static const size_t Epochs = 3;
+
+		///
+		/// Hands "x" to be freed once no reader can see it.  The caller must hold the lock.
+		///
+		template<typename T> void retire(T* x)
+		{
+			if(x != nullptr)
+			{
+				Retired retired = {&FederateRegistry::destroy<T>, x};
+				this->retired[this->epoch.load(std::memory_order_relaxed) % Epochs].push_back(retired);
+			}
+		}
+
+		template<typename T> static void destroy(void* x)
+		{
+			delete static_cast<T*>(x);
+		}
+
+		static void destroyAll(std::vector<Retired>& x)
+		{
+			for(auto& retired : x)
+			{
+				retired.destroy(retired.object);
+			}
+
+			x.clear();
+		}
+
+		///
+		/// Advances the epoch as far as the readers allow, at most twice, freeing what was retired two epochs before
+		/// each step.  Without readers, that is everything retired so far.  The caller must hold the lock.
+		///
+		void advance()
+		{
+			for(int i = 0; i < 2; ++i)
+			{
+				const auto e = this->epoch.load();
+				const auto previous = (e + Epochs - 1) % Epochs;
+
+				if(this->readers[previous].load() != 0)
+				{
+					return;
+				}
+
+				FederateRegistry::destroyAll(this->retired[previous]);
+				this->epoch.store(e + 1);
+			}
+		}
+
+		///
+		/// Frees the current table, its topics and their lists, and every function.  Only when no reader is left.
+		///
+		void destroyContents()
+		{
+			auto table = this->current.load();
+
+			for(auto topic : table->topics)
+			{
+				delete topic->slots.load();
+				delete topic;
+			}
+
+			delete table;
+
+			for(auto& exact : this->exactTopics)
+			{
+				delete exact.second.function;
+			}
+
+			auto prefixes = this->currentPrefixes.load();
+
+			for(auto& prefix : prefixes->subscriptions)
+			{
+				delete prefix.slot.function;
+			}
+
+			delete prefixes;
+		}
+
+		///
+		/// Publishes "slots" as a topic's list and retires the old one, counting the topic in or out as it gains or
+		/// loses its list.  The caller must hold the lock.
+		///
+		void setSlots(Topic& topic, SlotList* slots)
+		{
+			auto old = topic.slots.load();
+
+			if((old == nullptr) != (slots == nullptr))
+			{
+				if(slots == nullptr)
+				{
+					this->liveTopics.fetch_sub(1, std::memory_order_relaxed);
+				}
+				else
+				{
+					this->liveTopics.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+
+			topic.slots.store(slots);
+			this->retire(old);
+		}
+
+		static SlotList* withSlot(SlotList& slots, const Slot& slot)
+		{
+			auto x = SlotList::make(slots.count + 1);
+			std::copy(slots.begin(), slots.end(), x->begin());
+			*(x->end() - 1) = slot;
+			return x;
+		}
+
+		static SlotList* withoutSlot(SlotList& slots, FederateRegistryConnection connection)
+		{
+			auto x = SlotList::make(slots.count - 1);
+
+			std::remove_copy_if(slots.begin(), slots.end(), x->begin(), [connection](const Slot& y)->bool
+			{
+				return y.connection == connection;
+			});
+
+			return x;
+		}
+
+		static Topic* findTopic(const Table& table, const Key& key, size_t hash)
+		{
+			for(auto i = hash & table.mask;; i = (i + 1) & table.mask)
+			{
+				auto topic = table.buckets[i].load(std::memory_order_acquire);
+
+				if(topic == nullptr)
+				{
+					return nullptr;
+				}
+
+				if(topic->hash == hash && topic->key == key)
+				{
+					return topic;
+				}
+			}
+		}
+
+		///
+		/// Returns the topic for "key", writing a new one, without a list, into the table if there is none.
+		/// The caller must hold the lock.
+		///
+		Topic& findOrCreateTopic(const Key& key, size_t hash)
+		{
+			auto existing = FederateRegistry::findTopic(*this->current.load(), key, hash);
+
+			if(existing != nullptr)
+			{
+				return *existing;
+			}
+
+			// Keep the load factor at or below one half.
+			if((this->current.load()->topics.size() + 1) * 2 > this->current.load()->mask + 1)
+			{
+				this->rebuild();
+			}
+
+			auto topic = new Topic();
+			topic->key = key;
+			topic->hash = hash;
+			topic->slots.store(nullptr, std::memory_order_relaxed);
+			topic->exact = 0;
+
+			auto table = this->current.load();
+			table->topics.push_back(topic);
+			FederateRegistry::insertBucket(*table, topic);
+			return *topic;
+		}
+
+		///
+		/// Publishes a new table of the topics with functions, with room for as many again before it is half full.
+		/// The old table and the topics without functions are retired.
+		///
+		void rebuild()
+		{
+			auto old = this->current.load();
+			size_t live = 0;
+
+			for(auto topic : old->topics)
+			{
+				live += (topic->slots.load() != nullptr) ? 1 : 0;
+			}
+
+			size_t buckets = MinBuckets;
+
+			while(buckets < (live + 1) * 4)
+			{
+				buckets *= 2;
+			}
+
+			auto table = new Table(buckets);
+			table->topics.reserve(live);
+
+			for(auto topic : old->topics)
+			{
+				if(topic->slots.load() != nullptr)
+				{
+					table->topics.push_back(topic);
+					FederateRegistry::insertBucket(*table, topic);
+				}
+				else
+				{
+					this->retire(topic);
+				}
+			}
+
+			this->current.store(table);
+			this->retire(old);
+		}
+
+		static void insertBucket(Table& table, Topic* topic)
+		{
+			auto i = topic->hash & table.mask;
+
+			while(table.buckets[i].load(std::memory_order_relaxed) != nullptr)
+			{
+				i = (i + 1) & table.mask;
+			}
+
+			table.buckets[i].store(topic, std::memory_order_release);
+		}
+
+		///
+		/// The list of a topic gaining its first push_back function, "slot": the prefix subscriptions matching it, then "slot".
+		/// The caller must hold the lock.
+		///
+		SlotList* prefixSlots(const Key& key, const Slot* slot) const
+		{
+			std::vector<Slot> matched;
+
+			this->matchPrefixes(*this->currentPrefixes.load(), key, std::integral_constant<bool, Prefix::Supported>(), [&matched](const Slot& x)
+			{
+				matched.push_back(x);
+			});
+
+			auto x = SlotList::make(matched.size() + 1);
+			std::copy(std::begin(matched), std::end(matched), x->begin());
+			*(x->end() - 1) = *slot;
+			return x;
+		}
+
+		///
+		/// Removes a prefix subscription, and its slot from the lists of the topics it matches.  The caller must hold the lock.
+		///
+		bool erasePrefix(FederateRegistryConnection connection, std::true_type)
+		{
+			auto prefixes = this->currentPrefixes.load();
+
+			auto prefix = std::find_if(std::begin(prefixes->subscriptions), std::end(prefixes->subscriptions),
+				[connection](const PrefixSubscription& x)->bool
+			{
+				return x.slot.connection == connection;
+			});
+
+			if(prefix == std::end(prefixes->subscriptions))
+			{
+				return false;
+			}
+
+			for(auto topic : this->current.load()->topics)
+			{
+				auto slots = topic->slots.load();
+
+				if(slots != nullptr && Prefix::matches(topic->key, prefix->prefix) == true)
+				{
+					this->setSlots(*topic, FederateRegistry::withoutSlot(*slots, connection));
+				}
+			}
+
+			this->retire(prefix->slot.function);
+
+			auto index = new PrefixIndex(*prefixes);
+			index->subscriptions.erase(std::begin(index->subscriptions) + (prefix - std::begin(prefixes->subscriptions)));
+			this->publishPrefixes(index);
+
+			this->advance();
+			return true;
+		}
+
+		bool erasePrefix(FederateRegistryConnection, std::false_type)
+		{
+			return false;
+		}
+
+		///
+		/// Publishes a new PrefixIndex, after the subscriptions changed, and retires the old one.
+		/// The caller must hold the lock.
+		///
+		void publishPrefixes(PrefixIndex* index)
+		{
+			index->keys.clear();
+			index->lengths.clear();
+
+			for(auto& prefix : index->subscriptions)
+			{
+				index->keys.insert(prefix.prefix);
+				index->lengths.insert(Prefix::length(prefix.prefix));
+			}
+
+			this->retire(this->currentPrefixes.load());
+			this->currentPrefixes.store(index);
+		}
+
+		///
+		/// Calls "visit" with each prefix subscription matching "key", in the order they were added.  Rejects a key
+		/// which matches none by looking each distinct prefix length up once in the sorted prefix set.
+		///
+		template<typename Visitor> static void matchPrefixes(const PrefixIndex& index, const Key& key, std::true_type, Visitor visit)
+		{
+			bool any = false;
+
+			for(auto length : index.lengths)
+			{
+				if(length > Prefix::length(key))
+				{
+					break;
+				}
+
+				if(index.keys.count(Prefix::truncate(key, length)) > 0)
+				{
+					any = true;
+					break;
+				}
+			}
+
+			if(any == true)
+			{
+				for(auto& prefix : index.subscriptions)
+				{
+					if(Prefix::matches(key, prefix.prefix) == true)
+					{
+						visit(prefix.slot);
+					}
+				}
+			}
+		}
+
+		template<typename Visitor> static void matchPrefixes(const PrefixIndex&, const Key&, std::false_type, Visitor)
+		{
+		}
+
+		///
+		/// Calls "visit" with the function of each prefix subscription matching "key".  Any thread, as a Reader.
+		///
+		template<typename Supported, typename Visitor> void visitPrefixes(const Key& key, Supported supported, Visitor visit) const
+		{
+			FederateRegistry::matchPrefixes(*this->currentPrefixes.load(), key, supported, [&visit](const Slot& x)
+			{
+				visit(*x.function);
+			});
+		}
+
+		std::vector<R> invokeSlots(SlotList& slots, std::false_type, Args... args)
+		{
+			std::vector<R> results;
+			results.reserve(slots.count);
+
+			for(auto& slot : slots)
+			{
+				results.push_back((*slot.function)(args...));
+			}
+
+			return results;
+		}
+
+		void invokeSlots(SlotList& slots, std::true_type, Args... args)
+		{
+			for(auto& slot : slots)
+			{
+				(*slot.function)(args...);
+			}
+		}
+
+		///
+		/// Invokes the prefix subscriptions matching a key which has no topic.
+		///
+		template<typename Supported> std::vector<R> invokePrefixes(const Key& key, Supported supported, std::false_type, Args... args)
+		{
+			std::vector<R> results;
+
+			this->visitPrefixes(key, supported, [&](FederateFunction& f)
+			{
+				results.push_back(f(args...));
+			});
+
+			return results;
+		}
+
+		template<typename Supported> void invokePrefixes(const Key& key, Supported supported, std::true_type, Args... args)
+		{
+			this->visitPrefixes(key, supported, [&](FederateFunction& f)
+			{
+				f(args...);
+			});
+		}
+
+		/// Read by "invoke" and "size", replaced by "rebuild".  Writers change the current table in place under the lock.
+		std::atomic<Table*> current;
+
+		/// Read by "invoke" and "size" for keys with no topic, replaced by "publishPrefixes".
+		std::atomic<PrefixIndex*> currentPrefixes;
+
+		/// The number of topics with functions.
+		std::atomic<size_t> liveTopics;
+
+		/// Advanced by "advance" under the lock.  "readers[e % Epochs]" counts the readers which entered in epoch "e".
+		std::atomic<uint64_t> epoch;
+		mutable std::atomic<size_t> readers[Epochs];
+
+		/// What was retired in each epoch.  Only used under the lock.
+		std::vector<Retired> retired[Epochs];
+
+		/// Each push_back function by connection, so erasing one only touches its topic.
+		std::unordered_map<FederateRegistryConnection, Exact> exactTopics;
+
+		FederateRegistryConnection nextConnection;
+		Hash hasher;
+		MutexMember<ThreadSafe> lock;
+};
+
+#endif
@@ -0,0 +1,644 @@
+#ifndef H_HELLEBORECONSULTING_FEDERATESHAREDMEMORY_H
+#define H_HELLEBORECONSULTING_FEDERATESHAREDMEMORY_H
+
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+#include <Federate/Federate.h>
+
+// POSIX shared memory and futexes: Linux only.
+#if defined(__linux__)
+
+#include <cerrno>
+#include <climits>
+#include <limits>
+#include <csignal>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+///
+///
+///
+template<typename T, bool ThreadSafe> class FederateSharedMemory
+{
+};
+
+///
+/// Fans a signal out to every process on the machine which opens the same name.
+///
+/// "publish" copies the (trivially copyable) arguments into a ring buffer in POSIX shared memory and wakes waiting
+/// subscribers with a futex.  Each process adds functions to its own FederateSharedMemory as to any Federate, then calls
+/// "poll" or "wait" to invoke them with every argument pack published since it last looked.
+///
+/// A subscriber that falls more than "capacity" records behind loses the oldest ones; "lost" counts them.
+/// Any process may publish.  Within a process, call "poll" and "wait" from one thread at a time.
+/// The name follows shm_open rules, e.g. "/telemetry".
+///
+/// A publisher claims its record before writing it, so publishers a full ring apart never write one record at once:
+/// the earlier one gives up if a later lap has the record, and the later one waits for the earlier to finish.
+/// A publisher that dies mid-publish cannot stall the ring: after "StallTimeout" subscribers count its record as
+/// lost and move on, and the next publisher to the record takes it over.  A publisher merely stalled for that long
+/// may resume and write over the record that took over from it; each record is sealed with its ticket and a checksum
+/// of its arguments, so subscribers count such a torn record as lost rather than deliver it.
+///
+/// Subscribers copy each record out of the ring before calling their functions rather than handing them a view of it.
+/// A record is only known to be intact once it has been read, as a publisher a lap ahead may write over it at any
+/// moment, so a view could change under a function while it ran.  The arguments are trivially copyable and fit in a
+/// record, and "poll" reuses one buffer for all of them.
+///
+/// Subscribers blocked in "wait" register their process in the ring so that publishers know to wake them.  One that
+/// dies in "wait" leaves its registration behind; the first publish which then finds nobody to wake drops the
+/// registrations of processes that no longer exist, so publishing goes back to making no system call.
+///
+template<typename... Args, bool ThreadSafe> class FederateSharedMemory<void(Args...), ThreadSafe> : public Federate<void(Args...), false, ThreadSafe>
+{
+	public:
+		typedef FederatePackedArgs<Args...> Packed;
+		typedef typename Packed::Values Values;
+
+		///
+		/// Opens the ring named "name", creating it with room for "capacity" records (rounded up to a power of two)
+		/// if it does not exist yet.  A ring created here gets the permissions "mode", less the umask: by default only
+		/// processes of the same user may open it, since any process which can may publish to every subscriber.
+		///
+		/// Throws std::system_error if the shared memory cannot be opened or mapped, if "capacity" is too large, if it
+		/// was created for other arguments or does not hold the records its header claims, or if its creator does not
+		/// finish setting it up within "OpenTimeout" (it may have died: unlink the name to start afresh).
+		///
+		FederateSharedMemory(const std::string& name, size_t capacity, mode_t mode = 0600) :
+			header(nullptr),
+			records(nullptr),
+			mapped(0),
+			stride((PayloadOffset + Packed::size() + 63) & ~size_t(63)),
+			slots(1),
+			cursor(0),
+			lostRecords(0)
+		{
+			if(capacity > FederateSharedMemory::maxCapacity(this->stride))
+			{
+				throw std::system_error(EINVAL, std::generic_category(), "capacity too large for " + name);
+			}
+
+			while(this->slots < capacity)
+			{
+				this->slots <<= 1;
+			}
+
+			auto created = true;
+			auto fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, mode);
+
+			if(fd < 0 && errno == EEXIST)
+			{
+				created = false;
+				fd = ::shm_open(name.c_str(), O_RDWR, mode);
+			}
+
+			if(fd < 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+			}
+
+			if(created == true)
+			{
+				this->mapped = sizeof(Header) + this->slots * this->stride;
+
+				if(::ftruncate(fd, static_cast<off_t>(this->mapped)) != 0)
+				{
+					const auto error = errno;
+					::close(fd);
+					::shm_unlink(name.c_str());
+					throw std::system_error(error, std::generic_category(), "ftruncate " + name);
+				}
+			}
+			else
+			{
+				// Another process created it; wait until it has sized the file.
+				struct stat info;
+				const auto deadline = std::chrono::steady_clock::now() + FederateSharedMemory::OpenTimeout();
+
+				for(;;)
+				{
+					if(::fstat(fd, &info) != 0)
+					{
+						const auto error = errno;
+						::close(fd);
+						throw std::system_error(error, std::generic_category(), "fstat " + name);
+					}
+
+					if(info.st_size != 0)
+					{
+						break;
+					}
+
+					if(std::chrono::steady_clock::now() >= deadline)
+					{
+						::close(fd);
+						throw std::system_error(ETIMEDOUT, std::generic_category(), "shared memory never sized: " + name);
+					}
+
+					std::this_thread::yield();
+				}
+
+				this->mapped = static_cast<size_t>(info.st_size);
+			}
+
+			auto memory = ::mmap(nullptr, this->mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+
+			if(memory == MAP_FAILED)
+			{
+				const auto error = errno;
+
+				// Otherwise the sized segment, never initialised, makes every later open time out.
+				if(created == true)
+				{
+					::shm_unlink(name.c_str());
+				}
+
+				throw std::system_error(error, std::generic_category(), "mmap " + name);
+			}
+
+			this->header = static_cast<Header*>(memory);
+			this->records = static_cast<char*>(memory) + sizeof(Header);
+
+			if(created == true)
+			{
+				this->header->capacity = this->slots;
+				this->header->stride = this->stride;
+				this->header->layout = Packed::layout();
+				this->header->magic.store(Magic, std::memory_order_release);
+			}
+			else
+			{
+				// A file too small for the header was not sized by a FederateSharedMemory.
+				if(this->mapped < sizeof(Header))
+				{
+					this->unmap();
+					throw std::system_error(EINVAL, std::generic_category(), "not a FederateSharedMemory: " + name);
+				}
+
+				const auto deadline = std::chrono::steady_clock::now() + FederateSharedMemory::OpenTimeout();
+
+				while(this->header->magic.load(std::memory_order_acquire) != Magic)
+				{
+					if(std::chrono::steady_clock::now() >= deadline)
+					{
+						this->unmap();
+						throw std::system_error(ETIMEDOUT, std::generic_category(), "shared memory never initialised: " + name);
+					}
+
+					std::this_thread::yield();
+				}
+
+				if(this->header->layout != Packed::layout() || this->header->stride != this->stride)
+				{
+					this->unmap();
+					throw std::system_error(EINVAL, std::generic_category(), "signature mismatch for " + name);
+				}
+
+				// Kept here rather than read from the header on each record, so a later write to it changes nothing.
+				const auto claimed = this->header->capacity;
+
+				if(claimed == 0 || (claimed & (claimed - 1)) != 0 || claimed > (this->mapped - sizeof(Header)) / this->stride)
+				{
+					this->unmap();
+					throw std::system_error(EINVAL, std::generic_category(), "records do not fit the mapping of " + name);
+				}
+
+				this->slots = static_cast<size_t>(claimed);
+			}
+
+			// New subscribers start with the next record published.
+			this->cursor = this->header->head.load(std::memory_order_acquire);
+		}
+
+		~FederateSharedMemory()
+		{
+			this->unmap();
+		}
+
+		FederateSharedMemory(const FederateSharedMemory&) = delete;
+		FederateSharedMemory& operator=(const FederateSharedMemory&) = delete;
+
+		///
+		/// Removes the name.  Processes which already have the ring open keep using it.
+		///
+		static void unlink(const std::string& name)
+		{
+			::shm_unlink(name.c_str());
+		}
+
+		///
+		/// How long a subscriber or publisher waits on a record claimed by another publisher before presuming it dead.
+		///
+		static std::chrono::milliseconds StallTimeout()
+		{
+			return std::chrono::milliseconds(100);
+		}
+
+		///
+		/// How long opening an existing ring waits for the process which created it to set it up.
+		///
+		static std::chrono::milliseconds OpenTimeout()
+		{
+			return std::chrono::seconds(1);
+		}
+
+		///
+		/// Publishes an argument pack to every subscriber, including this one.
+		///
+		void publish(Args... args)
+		{
+			const auto ticket = this->header->head.fetch_add(1, std::memory_order_acq_rel);
+			auto record = this->recordAt(ticket);
+			auto sequence = reinterpret_cast<std::atomic<uint64_t>*>(record);
+
+			// Readers that see the writing marker, or see the sequence change while they copy, retry or skip the record.
+			if(FederateSharedMemory::claim(*sequence, ticket + 1) == true)
+			{
+				std::atomic_thread_fence(std::memory_order_release);
+				Packed::write(record + PayloadOffset, args...);
+				FederateSharedMemory::sealOf(record).store(FederateSharedMemory::seal(ticket + 1, Packed::checksum(args...)), std::memory_order_relaxed);
+
+				// Fails only if another publisher took the record over from us as stalled; ours is then lost.
+				auto claimed = (ticket + 1) | Writing;
+				sequence->compare_exchange_strong(claimed, ticket + 1, std::memory_order_release, std::memory_order_relaxed);
+			}
+
+			this->header->futex.fetch_add(1, std::memory_order_release);
+
+			if(this->header->waiters.load(std::memory_order_acquire) != 0)
+			{
+				// Nobody asleep: the subscribers registered are between registering and sleeping, or died in "wait".
+				if(::syscall(SYS_futex, &this->header->futex, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0) == 0)
+				{
+					this->dropDeadWaiters();
+				}
+			}
+		}
+
+		///
+		/// Invokes this process's functions once for each record published since the last poll.
+		/// Returns the number of records delivered.
+		///
+		size_t poll()
+		{
+			size_t delivered = 0;
+			Values values;
+
+			while(this->readNext(values) == true)
+			{
+				Packed::invoke(*this, values);
+				++delivered;
+			}
+
+			return delivered;
+		}
+
+		///
+		/// Blocks until something is published or "timeout" passes, then polls.  Returns the number of records delivered.
+		///
+		size_t wait(std::chrono::nanoseconds timeout)
+		{
+			auto delivered = this->poll();
+
+			if(delivered != 0)
+			{
+				return delivered;
+			}
+
+			auto word = this->header->futex.load(std::memory_order_acquire);
+			const auto registration = this->registerWaiter();
+
+			if(registration >= 0)
+			{
+				if(this->header->head.load(std::memory_order_acquire) == this->cursor)
+				{
+					FederateSharedMemory::sleep(this->header->futex, word, timeout);
+				}
+
+				this->unregisterWaiter(registration);
+				return this->poll();
+			}
+
+			// Every registration is taken, so no publisher will wake this subscriber: look again every millisecond.
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+			while(this->header->head.load(std::memory_order_acquire) == this->cursor)
+			{
+				const auto now = std::chrono::steady_clock::now();
+
+				if(now >= deadline)
+				{
+					break;
+				}
+
+				FederateSharedMemory::sleep(this->header->futex, word, (std::min)(std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now), std::chrono::nanoseconds(std::chrono::milliseconds(1))));
+				word = this->header->futex.load(std::memory_order_acquire);
+			}
+
+			return this->poll();
+		}
+
+		///
+		/// Returns the number of records this subscriber missed because it fell a full ring behind.
+		///
+		uint64_t lost() const
+		{
+			return this->lostRecords;
+		}
+
+		///
+		/// Returns the number of records the ring holds.
+		///
+		size_t capacity() const
+		{
+			return this->slots;
+		}
+
+	protected:
+		static const uint32_t Magic = 0xFEDE5A4E;
+
+		/// How many subscribers, in all processes, "wait" can register at once.  Any beyond that poll instead.
+		static const size_t MaxWaiters = 64;
+
+		/// Set in a record's sequence number while a publisher writes it.
+		static const uint64_t Writing = uint64_t(1) << 63;
+
+		/// Where a record's arguments start, after its sequence number and seal.
+		static const size_t PayloadOffset = 2 * sizeof(uint64_t);
+
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "FederateSharedMemory needs address-free atomics.");
+
+		///
+		/// The start of the shared mapping, followed by "capacity" records of "stride" bytes.
+		/// Each record is a sequence number, a seal and the packed arguments.  The sequence number is the ticket plus one,
+		/// with "Writing" set while a publisher writes the record, or 0 if the record has never been written.
+		/// The seal is the low half of the sequence number of the publisher which last wrote the arguments, and their
+		/// checksum: a publisher which lost the record but carries on writing breaks one or the other.
+		///
+		struct Header
+		{
+			std::atomic<uint32_t> magic;
+			std::atomic<uint32_t> futex;
+			std::atomic<uint32_t> waiters;
+			uint64_t capacity;
+			uint64_t stride;
+
+			/// FederatePackedArgs::layout of the arguments, so that processes with other signatures cannot open the ring.
+			uint64_t layout;
+
+			alignas(64) std::atomic<uint64_t> head;
+
+			/// The process of each subscriber registered in "wait", or 0.  "waiters" counts them.
+			alignas(64) std::atomic<uint32_t> waiterProcesses[MaxWaiters];
+		};
+
+		///
+		/// Registers this process as waiting.  Returns its registration, or -1 if every one is taken.
+		///
+		int registerWaiter()
+		{
+			const auto process = static_cast<uint32_t>(::getpid());
+
+			for(size_t k = 0; k < MaxWaiters; ++k)
+			{
+				const auto i = (process + k) % MaxWaiters;
+				uint32_t empty = 0;
+
+				if(this->header->waiterProcesses[i].compare_exchange_strong(empty, process, std::memory_order_acq_rel) == true)
+				{
+					this->header->waiters.fetch_add(1, std::memory_order_acq_rel);
+					return static_cast<int>(i);
+				}
+			}
+
+			return -1;
+		}
+
+		void unregisterWaiter(int registration)
+		{
+			this->header->waiterProcesses[registration].store(0, std::memory_order_release);
+			this->header->waiters.fetch_sub(1, std::memory_order_acq_rel);
+		}
+
+		///
+		/// Drops the registrations of processes which no longer exist, so that publishers stop waking them.
+		///
+		void dropDeadWaiters()
+		{
+			for(auto& registered : this->header->waiterProcesses)
+			{
+				auto process = registered.load(std::memory_order_acquire);
+
+				if(process == 0 || ::kill(static_cast<pid_t>(process), 0) == 0 || errno != ESRCH)
+				{
+					continue;
+				}
+
+				if(registered.compare_exchange_strong(process, 0, std::memory_order_acq_rel) == true)
+				{
+					this->header->waiters.fetch_sub(1, std::memory_order_acq_rel);
+				}
+			}
+		}
+
+		///
+		/// Blocks on "futex" for up to "timeout", unless it no longer holds "word".
+		///
+		static void sleep(std::atomic<uint32_t>& futex, uint32_t word, std::chrono::nanoseconds timeout)
+		{
+			struct timespec relative;
+			relative.tv_sec = static_cast<time_t>(std::chrono::duration_cast<std::chrono::seconds>(timeout).count());
+			relative.tv_nsec = static_cast<long>((timeout - std::chrono::seconds(relative.tv_sec)).count());
+			::syscall(SYS_futex, &futex, FUTEX_WAIT, word, &relative, nullptr, 0);
+		}
+
+		///
+		/// The largest capacity whose power of two, with the header, still fits in a size_t.
+		///
+		static size_t maxCapacity(size_t stride)
+		{
+			const auto most = (std::numeric_limits<size_t>::max() - sizeof(Header)) / stride;
+			size_t bit = 1;
+
+			while(bit <= most / 2)
+			{
+				bit <<= 1;
+			}
+
+			return bit;
+		}
+
+		char* recordAt(uint64_t ticket) const
+		{
+			return this->records + (ticket & (this->slots - 1)) * this->stride;
+		}
+
+		static std::atomic<uint64_t>& sealOf(char* record)
+		{
+			return *reinterpret_cast<std::atomic<uint64_t>*>(record + sizeof(uint64_t));
+		}
+
+		static uint64_t seal(uint64_t sequence, uint32_t checksum)
+		{
+			return (uint64_t(checksum) << 32) | (sequence & 0xFFFFFFFF);
+		}
+
+		///
+		/// Marks a record as being written for sequence number "mine".  Returns false if a later lap already has it,
+		/// so this publish is lost.  Waits up to StallTimeout for a publisher of an earlier lap still writing it to
+		/// finish, then takes the record over.
+		///
+		static bool claim(std::atomic<uint64_t>& sequence, uint64_t mine)
+		{
+			auto current = sequence.load(std::memory_order_acquire);
+			auto deadline = std::chrono::steady_clock::time_point::max();
+
+			for(;;)
+			{
+				if((current & ~Writing) >= mine)
+				{
+					return false;
+				}
+
+				if((current & Writing) != 0)
+				{
+					const auto now = std::chrono::steady_clock::now();
+
+					if(deadline == std::chrono::steady_clock::time_point::max())
+					{
+						deadline = now + FederateSharedMemory::StallTimeout();
+					}
+
+					if(now < deadline)
+					{
+						std::this_thread::yield();
+						current = sequence.load(std::memory_order_acquire);
+						continue;
+					}
+				}
+
+				if(sequence.compare_exchange_weak(current, mine | Writing, std::memory_order_acq_rel, std::memory_order_acquire) == true)
+				{
+					return true;
+				}
+			}
+		}
+
+		///
+		/// Copies the next record into "values".  Returns false if there is nothing new.
+		///
+		bool readNext(Values& values)
+		{
+			// When the record at "cursor" was first found unfinished; it is given up as lost after StallTimeout.
+			auto stalledAt = this->cursor - 1;
+			auto deadline = std::chrono::steady_clock::time_point::max();
+
+			for(;;)
+			{
+				const auto head = this->header->head.load(std::memory_order_acquire);
+
+				if(this->cursor == head)
+				{
+					return false;
+				}
+
+				// Skip what has already been overwritten.
+				if(head - this->cursor > this->slots)
+				{
+					this->lostRecords += head - this->cursor - this->slots;
+					this->cursor = head - this->slots;
+				}
+
+				auto record = this->recordAt(this->cursor);
+				auto sequence = reinterpret_cast<std::atomic<uint64_t>*>(record);
+				const auto before = sequence->load(std::memory_order_acquire);
+				const auto lap = before & ~Writing;
+
+				if(before == this->cursor + 1)
+				{
+					const auto sealed = FederateSharedMemory::sealOf(record).load(std::memory_order_relaxed);
+					Packed::read(record + PayloadOffset, values);
+					std::atomic_thread_fence(std::memory_order_acquire);
+
+					if(sequence->load(std::memory_order_relaxed) == before)
+					{
+						++this->cursor;
+
+						// A stalled publisher of an earlier lap wrote over the record after it was taken over.
+						if(sealed != FederateSharedMemory::seal(before, Packed::checksum(values)) || FederateSharedMemory::sealOf(record).load(std::memory_order_relaxed) != sealed)
+						{
+							++this->lostRecords;
+							continue;
+						}
+
+						return true;
+					}
+				}
+				else if(lap > this->cursor + 1)
+				{
+					// Overwritten, or being overwritten, by a later lap.
+					++this->lostRecords;
+					++this->cursor;
+					continue;
+				}
+
+				// Claimed but not yet written, or still held by an earlier lap: a publisher is mid-copy, or died.
+				const auto now = std::chrono::steady_clock::now();
+
+				if(stalledAt != this->cursor)
+				{
+					stalledAt = this->cursor;
+					deadline = now + FederateSharedMemory::StallTimeout();
+				}
+				else if(now >= deadline)
+				{
+					++this->lostRecords;
+					++this->cursor;
+					continue;
+				}
+
+				std::this_thread::yield();
+			}
+		}
+
+		void unmap()
+		{
+			if(this->header != nullptr)
+			{
+				::munmap(this->header, this->mapped);
+				this->header = nullptr;
+			}
+		}
+
+		Header* header;
+		char* records;
+		size_t mapped;
+
+		/// Bytes per record: the sequence number and the packed arguments, rounded to a cache line
+		/// so neighbouring publishers do not share one.
+		size_t stride;
+
+		/// The number of records, a power of two, checked against the mapping when the ring was opened.
+		size_t slots;
+
+		uint64_t cursor;
+		uint64_t lostRecords;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,421 @@
+#ifndef H_HELLEBORECONSULTING_FEDERATESINGLEPRODUCER_H
+#define H_HELLEBORECONSULTING_FEDERATESINGLEPRODUCER_H
+
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+#include <Federate/Federate.h>
+
+#include <atomic>
+
+///
+///
+///
+template<typename T, bool Tracked> class FederateSingleProducer
+{
+};
+
+///
+/// A Federate owned by one thread, which may be connected to from any thread.
+///
+/// The owning thread invokes without taking a lock: it checks an inbox with a single acquire load.  When not
+/// tracked, an invocation performs no atomic read-modify-write of its own either.  When tracked, each live slot
+/// still costs one, and its release another, as locking a std::weak_ptr compares-and-swaps the Tracker's use count.
+///
+/// "push_back" and "clear" from other threads are pushed onto that lock-free inbox and applied, in order, before
+/// anything else the owner does with the Federate: each member which reads or changes the functions applies the
+/// inbox first, as "apply" does.
+///
+/// All other members, including those, are for the owning thread only.
+///
+/// The Federate is a private base, so none of its members can be reached without applying the inbox first, neither
+/// directly nor through a reference to the base.  Those which leave the functions alone are made public as they are.
+///
+template<typename R, typename... Args, bool Tracked> class FederateSingleProducer<R(Args...), Tracked> : private Federate<R(Args...), Tracked, false>
+{
+	public:
+		typedef Federate<R(Args...), Tracked, false> Base;
+		typedef typename Base::FederateFunction FederateFunction;
+		typedef typename Base::Tracker Tracker;
+		typedef typename Base::PushResult PushResult;
+
+		using Base::setReclaimer;
+		using Base::setAsyncGrainSize;
+		using Base::setExecutor;
+		using Base::setErrorPolicy;
+		using Base::setErrorHandler;
+		using Base::takeErrors;
+		using Base::setHotReordering;
+		using Base::setRecorder;
+		using Base::waitNext;
+		using Base::nextAsync;
+		using Base::disconnect;
+
+		///
+		/// The constructing thread becomes the owner.
+		///
+		FederateSingleProducer() : inbox(nullptr), owner(std::this_thread::get_id())
+		{
+		}
+
+		~FederateSingleProducer()
+		{
+			auto command = this->inbox.exchange(nullptr, std::memory_order_acquire);
+
+			while(command != nullptr)
+			{
+				auto next = command->next;
+				delete command;
+				command = next;
+			}
+		}
+
+		FederateSingleProducer(const FederateSingleProducer&) = delete;
+		FederateSingleProducer& operator=(const FederateSingleProducer&) = delete;
+
+		///
+		/// Makes the calling thread the owner.  Only call this while no other thread is using the Federate.
+		///
+		void setOwner()
+		{
+			this->owner = std::this_thread::get_id();
+		}
+
+		///
+		/// Adds a new function to the end of the Federate.
+		/// From the owning thread it is added immediately; from any other thread it is added at the owner's next invoke.
+		///
+		PushResult push_back(FederateFunction f)
+		{
+			return this->pushInbox(std::move(f), std::integral_constant<bool, Tracked>());
+		}
+
+		///
+		/// Clears the functions in the Federate, after any earlier queued push_back.
+		/// From any thread but the owner it takes effect at the owner's next invoke.
+		///
+		void clear()
+		{
+			if(this->onOwner() == true)
+			{
+				this->apply();
+				Base::clear();
+			}
+			else
+			{
+				auto command = new Command();
+				command->kind = Command::Clear;
+				this->post(command);
+			}
+		}
+
+		///
+		/// Applies every queued push_back and clear.  Owning thread only.
+		///
+		void apply()
+		{
+			if(this->inbox.load(std::memory_order_acquire) != nullptr)
+			{
+				this->drain();
+			}
+		}
+
+		///
+		/// Invokes each of the functions in the Federate serially.  Owning thread only.
+		///
+		auto invoke(Args... args) -> decltype(std::declval<Base&>().invoke(args...))
+		{
+			this->apply();
+			return Base::invoke(args...);
+		}
+
+		///
+		/// Invokes each of the functions in the Federate asynchronously.  Owning thread only.
+		///
+		auto invokeAsync(Args... args) -> decltype(std::declval<Base&>().invokeAsync(args...))
+		{
+			this->apply();
+			return Base::invokeAsync(args...);
+		}
+
+		///
+		/// The other ways of invoking apply the inbox first too.  Owning thread only.
+		///
+		template<typename B = Base, typename... CallArgs> auto invokeBuffered(CallArgs&&... args) -> decltype(std::declval<B&>().invokeBuffered(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeBuffered(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto invokeSpan(CallArgs&&... args) -> decltype(std::declval<B&>().invokeSpan(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeSpan(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto invokeScratch(CallArgs&&... args) -> decltype(std::declval<B&>().invokeScratch(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeScratch(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto invokeInto(CallArgs&&... args) -> decltype(std::declval<B&>().invokeInto(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeInto(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto invokeAsyncInto(CallArgs&&... args) -> decltype(std::declval<B&>().invokeAsyncInto(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeAsyncInto(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto invokeChecked(CallArgs&&... args) -> decltype(std::declval<B&>().invokeChecked(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeChecked(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto invokeFirst(CallArgs&&... args) -> decltype(std::declval<B&>().invokeFirst(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeFirst(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto invokeLazy(CallArgs&&... args) -> decltype(std::declval<B&>().invokeLazy(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeLazy(std::forward<CallArgs>(args)...);
+		}
+
+#ifdef FEDERATE_HAS_COROUTINES
+		template<typename B = Base, typename... CallArgs> auto invokeCoro(CallArgs&&... args) -> decltype(std::declval<B&>().invokeCoro(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeCoro(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto invokeCoroOn(CallArgs&&... args) -> decltype(std::declval<B&>().invokeCoroOn(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::invokeCoroOn(std::forward<CallArgs>(args)...);
+		}
+#endif
+
+		///
+		/// The other ways of adding functions, and the members which read or change them, apply the inbox first too.
+		/// Owning thread only.
+		///
+		template<typename B = Base, typename... CallArgs> auto push_back_scoped(CallArgs&&... args) -> decltype(std::declval<B&>().push_back_scoped(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::push_back_scoped(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto push_back_throttled(CallArgs&&... args) -> decltype(std::declval<B&>().push_back_throttled(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::push_back_throttled(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto push_back_debounced(CallArgs&&... args) -> decltype(std::declval<B&>().push_back_debounced(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::push_back_debounced(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto push_back_on_node(CallArgs&&... args) -> decltype(std::declval<B&>().push_back_on_node(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::push_back_on_node(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto push_back_pinned(CallArgs&&... args) -> decltype(std::declval<B&>().push_back_pinned(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::push_back_pinned(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto push_back_range(CallArgs&&... args) -> decltype(std::declval<B&>().push_back_range(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::push_back_range(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto assign(CallArgs&&... args) -> decltype(std::declval<B&>().assign(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::assign(std::forward<CallArgs>(args)...);
+		}
+
+		template<typename B = Base, typename... CallArgs> auto connect(CallArgs&&... args) -> decltype(std::declval<B&>().connect(std::forward<CallArgs>(args)...))
+		{
+			this->apply();
+			return Base::connect(std::forward<CallArgs>(args)...);
+		}
+
+		void clean()
+		{
+			this->apply();
+			Base::clean();
+		}
+
+		size_t garbageSize()
+		{
+			this->apply();
+			return Base::garbageSize();
+		}
+
+		void reserve(size_t n)
+		{
+			this->apply();
+			Base::reserve(n);
+		}
+
+		void shrink_to_fit()
+		{
+			this->apply();
+			Base::shrink_to_fit();
+		}
+
+		FederateMemoryUsage memoryUsage()
+		{
+			this->apply();
+			return Base::memoryUsage();
+		}
+
+		///
+		/// Calls the debounced functions which are due.  Owning thread only.
+		///
+		size_t pollTimers()
+		{
+			this->apply();
+			return Base::pollTimers();
+		}
+
+		///
+		/// Returns the number of functions, counting those queued from other threads.  Owning thread only.
+		///
+		size_t size()
+		{
+			this->apply();
+			return Base::size();
+		}
+
+		bool empty()
+		{
+			this->apply();
+			return Base::empty();
+		}
+
+	protected:
+		///
+		/// A queued push_back or clear.  "entry" is the slot, made on the posting thread: the function, or a weak
+		/// reference to its Tracker when tracked.
+		///
+		struct Command
+		{
+			enum Kind
+			{
+				Push,
+				Clear
+			};
+
+			Command() : kind(Push), next(nullptr)
+			{
+			}
+
+			Kind kind;
+			typename Base::StoredSlot entry;
+			Command* next;
+		};
+
+		bool onOwner() const
+		{
+			return std::this_thread::get_id() == this->owner;
+		}
+
+		Tracker pushInbox(FederateFunction f, std::true_type)
+		{
+			if(this->onOwner() == true)
+			{
+				this->apply();
+				return Base::push_back(std::move(f));
+			}
+
+			// Through the Federate's deleter, so that a reclaimer set on the owner retires it like any other Tracker.
+			auto tracker = this->makeTracker(std::move(f));
+			auto command = new Command();
+			command->entry = tracker;
+			this->post(command);
+			return tracker;
+		}
+
+		void pushInbox(FederateFunction f, std::false_type)
+		{
+			if(this->onOwner() == true)
+			{
+				this->apply();
+				Base::push_back(std::move(f));
+				return;
+			}
+
+			auto command = new Command();
+			command->entry = std::move(f);
+			this->post(command);
+		}
+
+		///
+		/// Pushes onto the inbox stack.  Any thread.
+		///
+		void post(Command* command)
+		{
+			command->next = this->inbox.load(std::memory_order_relaxed);
+
+			while(this->inbox.compare_exchange_weak(command->next, command, std::memory_order_release, std::memory_order_relaxed) == false)
+			{
+			}
+		}
+
+		///
+		/// Takes the whole inbox and applies it oldest first.  Owning thread only.
+		///
+		void drain()
+		{
+			Command* reversed = nullptr;
+			auto command = this->inbox.exchange(nullptr, std::memory_order_acquire);
+
+			while(command != nullptr)
+			{
+				auto next = command->next;
+				command->next = reversed;
+				reversed = command;
+				command = next;
+			}
+
+			while(reversed != nullptr)
+			{
+				if(reversed->kind == Command::Push)
+				{
+					this->addSlot(std::move(reversed->entry), typename Base::SlotState());
+				}
+				else
+				{
+					Base::clear();
+				}
+
+				auto next = reversed->next;
+				delete reversed;
+				reversed = next;
+			}
+		}
+
+		std::atomic<Command*> inbox;
+		std::thread::id owner;
+};
+
+#endif
@@ -0,0 +1,420 @@
+#ifndef H_HELLEBORECONSULTING_FEDERATETHREADPOOL_H
+#define H_HELLEBORECONSULTING_FEDERATETHREADPOOL_H
+
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+#include <Federate/Federate.h>
+
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(FEDERATE_HAS_LIBNUMA)
+#include <numa.h>
+#endif
+
+///
+/// A FederateExecutor with a group of worker threads per NUMA node.
+///
+/// Functions added with "push_back_on_node" run on their node's group; others are spread over the groups in turn.
+/// On Linux each worker is pinned to one of its node's CPUs.  Elsewhere, or where pinning is not permitted, workers float.
+///
+/// Without libnuma, nothing binds memory: what a function allocates while it runs lands on its worker's node only by
+/// the kernel's first-touch policy, and not at all if the worker floats.  Define FEDERATE_HAS_LIBNUMA and link
+/// libnuma (the CMake build does both when it finds it) and each worker also sets its memory policy to prefer its
+/// node, so those allocations go there wherever the worker runs.  Either way, a function's captures stay where the
+/// thread which added it allocated them: add it from a thread on the same node to keep them local.
+///
+/// Share one pool between Federates with "setExecutor(pool)".  Destroying the pool runs the tasks already queued.
+///
+/// Federate's own tasks deliver their exceptions through futures.  An exception escaping any other task given to
+/// "execute" goes to the handler set with "setErrorHandler", or, as from a std::thread, calls std::terminate.
+///
+class FederateThreadPool : public FederateExecutor
+{
+	public:
+		///
+		/// A NUMA node: its id, as the kernel numbers it, and the CPUs to pin its workers to.
+		///
+		struct Node
+		{
+			int id;
+			std::vector<int> cpus;
+		};
+
+		///
+		/// One group per NUMA node the process may run on, with a worker pinned to each CPU.
+		/// Without NUMA information this is one group of unpinned workers, one per hardware thread.
+		///
+		FederateThreadPool()
+		{
+			this->start(FederateThreadPool::detectNodes());
+		}
+
+		///
+		/// One group per entry of "nodes", with a worker pinned to each CPU listed.  An empty list gives the group one unpinned worker.
+		/// The group for "nodes[i]" is node i.
+		///
+		explicit FederateThreadPool(const std::vector<std::vector<int>>& nodes)
+		{
+			std::vector<Node> numbered;
+
+			for(size_t i = 0; i < nodes.size(); ++i)
+			{
+				Node node = {static_cast<int>(i), nodes[i]};
+				numbered.push_back(std::move(node));
+			}
+
+			this->start(numbered);
+		}
+
+		///
+		/// One group per entry of "nodes", for the node with its id, with a worker pinned to each CPU listed.
+		/// Ids need not be contiguous.
+		///
+		explicit FederateThreadPool(const std::vector<Node>& nodes)
+		{
+			this->start(nodes);
+		}
+
+		~FederateThreadPool()
+		{
+			for(auto& group : this->groups)
+			{
+				std::lock_guard<std::mutex> scopedLock(group->mutex);
+				group->stopping = true;
+				group->ready.notify_all();
+			}
+
+			for(auto& group : this->groups)
+			{
+				for(auto& t : group->threads)
+				{
+					t.join();
+				}
+			}
+		}
+
+		FederateThreadPool(const FederateThreadPool&) = delete;
+		FederateThreadPool& operator=(const FederateThreadPool&) = delete;
+
+		///
+		/// Calls "x", on the worker, with each exception that escapes a task.  Pass nullptr to terminate instead.
+		///
+		void setErrorHandler(std::function<void(std::exception_ptr)> x)
+		{
+			std::lock_guard<std::mutex> scopedLock(this->handlerMutex);
+			this->errorHandler = std::move(x);
+		}
+
+		///
+		/// Queues "task" on the group for "node", or on the next group in turn if "node" is -1 or not one of ours.
+		///
+		virtual void execute(FederateMoveOnlyFunction<void()> task, int node) override
+		{
+			auto index = this->groupFor(node);
+
+			if(index == this->groups.size())
+			{
+				index = this->next.fetch_add(1, std::memory_order_relaxed) % this->groups.size();
+			}
+
+			auto& group = *this->groups[index];
+
+			{
+				std::lock_guard<std::mutex> scopedLock(group.mutex);
+				group.tasks.push_back(std::move(task));
+			}
+
+			group.ready.notify_one();
+		}
+
+		///
+		/// Returns the number of worker groups.
+		///
+		size_t nodes() const
+		{
+			return this->groups.size();
+		}
+
+		///
+		/// Returns the node id of each worker group.
+		///
+		std::vector<int> nodeIds() const
+		{
+			std::vector<int> ids;
+
+			for(auto& group : this->groups)
+			{
+				ids.push_back(group->node);
+			}
+
+			return ids;
+		}
+
+		///
+		/// Returns the number of worker threads.
+		///
+		size_t workers() const
+		{
+			size_t n = 0;
+
+			for(auto& group : this->groups)
+			{
+				n += group->threads.size();
+			}
+
+			return n;
+		}
+
+		///
+		/// Returns each NUMA node this process may run on, with its id and CPUs, from /sys/devices/system/node.
+		/// Nodes with none of the process's CPUs are left out, so ids may have gaps even where "online" has none.
+		/// Returns an empty list if that is not available.
+		///
+		static std::vector<Node> detectNodes()
+		{
+			std::vector<Node> nodes;
+
+#if defined(__linux__)
+			cpu_set_t allowed;
+			CPU_ZERO(&allowed);
+
+			if(::sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+			{
+				return nodes;
+			}
+
+			for(auto id : FederateThreadPool::parseCpuList(FederateThreadPool::readLine("/sys/devices/system/node/online")))
+			{
+				Node node = {id, std::vector<int>()};
+
+				for(auto cpu : FederateThreadPool::parseCpuList(FederateThreadPool::readLine("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist")))
+				{
+					if(cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+					{
+						node.cpus.push_back(cpu);
+					}
+				}
+
+				if(node.cpus.empty() == false)
+				{
+					nodes.push_back(std::move(node));
+				}
+			}
+#endif
+
+			return nodes;
+		}
+
+		///
+		/// Parses a kernel CPU or node list such as "0-3,8,10-11".
+		///
+		static std::vector<int> parseCpuList(const std::string& text)
+		{
+			std::vector<int> ids;
+			std::istringstream in(text);
+			std::string range;
+
+			while(std::getline(in, range, ','))
+			{
+				const auto dash = range.find('-');
+
+				try
+				{
+					const auto first = std::stoi(range.substr(0, dash));
+					const auto last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+
+					for(auto i = first; i <= last; ++i)
+					{
+						ids.push_back(i);
+					}
+				}
+				catch(const std::exception&)
+				{
+				}
+			}
+
+			return ids;
+		}
+
+	protected:
+		struct Group
+		{
+			Group() : node(-1), stopping(false)
+			{
+			}
+
+			int node;
+			std::mutex mutex;
+			std::condition_variable ready;
+			std::deque<FederateMoveOnlyFunction<void()>> tasks;
+			bool stopping;
+			std::vector<std::thread> threads;
+		};
+
+		///
+		/// Returns the index of the group for NUMA node "node", or the number of groups if none is.
+		///
+		size_t groupFor(int node) const
+		{
+			for(size_t i = 0; i < this->groups.size(); ++i)
+			{
+				if(this->groups[i]->node == node)
+				{
+					return i;
+				}
+			}
+
+			return this->groups.size();
+		}
+
+		void start(const std::vector<Node>& nodes)
+		{
+			this->next = 0;
+
+			if(nodes.empty() == true)
+			{
+				std::unique_ptr<Group> group(new Group());
+
+				for(unsigned i = 0; i < (std::max)(std::thread::hardware_concurrency(), 1u); ++i)
+				{
+					group->threads.emplace_back(&FederateThreadPool::work, this, group.get(), -1);
+				}
+
+				this->groups.push_back(std::move(group));
+				return;
+			}
+
+			for(auto& node : nodes)
+			{
+				std::unique_ptr<Group> group(new Group());
+				group->node = node.id;
+
+				if(node.cpus.empty() == true)
+				{
+					group->threads.emplace_back(&FederateThreadPool::work, this, group.get(), -1);
+				}
+
+				for(auto cpu : node.cpus)
+				{
+					group->threads.emplace_back(&FederateThreadPool::work, this, group.get(), cpu);
+				}
+
+				this->groups.push_back(std::move(group));
+			}
+		}
+
+		///
+		/// A worker: pins itself to "cpu" (unless it is -1) and, with libnuma, prefers its node's memory, then runs its
+		/// group's tasks until the pool is destroyed.
+		///
+		static void work(FederateThreadPool* pool, Group* group, int cpu)
+		{
+			FederateThreadPool::preferNode(group->node);
+
+#if defined(__linux__)
+			if(cpu >= 0 && cpu < CPU_SETSIZE)
+			{
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				CPU_SET(cpu, &set);
+
+				// Best effort: a restricted process keeps running unpinned.
+				::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+			}
+#else
+			SuppressWarningUnusedVariable(cpu);
+#endif
+
+			for(;;)
+			{
+				FederateMoveOnlyFunction<void()> task;
+
+				{
+					std::unique_lock<std::mutex> scopedLock(group->mutex);
+
+					group->ready.wait(scopedLock, [group]
+					{
+						return group->stopping == true || group->tasks.empty() == false;
+					});
+
+					if(group->tasks.empty() == true)
+					{
+						return;
+					}
+
+					task = std::move(group->tasks.front());
+					group->tasks.pop_front();
+				}
+
+				try
+				{
+					task();
+				}
+				catch(...)
+				{
+					pool->reportError(std::current_exception());
+				}
+			}
+		}
+
+		///
+		/// Sets the calling thread's memory policy to prefer NUMA node "node", if libnuma is in use and the node exists.
+		///
+		static void preferNode(int node)
+		{
+#if defined(FEDERATE_HAS_LIBNUMA)
+			if(node >= 0 && ::numa_available() != -1 && node <= ::numa_max_node() && ::numa_bitmask_isbitset(::numa_all_nodes_ptr, static_cast<unsigned>(node)) != 0)
+			{
+				::numa_set_preferred(node);
+			}
+#else
+			SuppressWarningUnusedVariable(node);
+#endif
+		}
+
+		void reportError(std::exception_ptr x)
+		{
+			std::function<void(std::exception_ptr)> handler;
+
+			{
+				std::lock_guard<std::mutex> scopedLock(this->handlerMutex);
+				handler = this->errorHandler;
+			}
+
+			if(handler == nullptr)
+			{
+				std::terminate();
+			}
+
+			handler(x);
+		}
+
+		static std::string readLine(const std::string& path)
+		{
+			std::ifstream in(path);
+			std::string line;
+			std::getline(in, line);
+			return line;
+		}
+
+		std::vector<std::unique_ptr<Group>> groups;
+		std::atomic<size_t> next;
+
+		std::mutex handlerMutex;
+		std::function<void(std::exception_ptr)> errorHandler;
+};
+
+#endif
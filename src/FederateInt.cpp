@@ -0,0 +1,14 @@
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+///
+/// Compiles the void(int) Federates listed in FederateExtern.h for the Federate library.
+///
+
+#include <Federate/Federate.h>
+#include <Federate/FederateExtern.h>
+
+FEDERATE_INSTANTIATE_SIGNATURE(template, void(int))
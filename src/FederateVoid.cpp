@@ -0,0 +1,14 @@
+// www.helleboreconsulting.com
+
+///
+///	\author	John Farrier
+///
+
+///
+/// Compiles the void(void) Federate base and function wrapper listed in FederateExtern.h for the Federate library.
+///
+
+#include <Federate/Federate.h>
+#include <Federate/FederateExtern.h>
+
+FEDERATE_INSTANTIATE_BASE(template, void(void))
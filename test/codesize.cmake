@@ -0,0 +1,27 @@
+#
+# Runs the code size probes built from test/codesize.cpp, for Federate and for the hand-written reference signal, and
+# fails if each added Federate signature costs more text than BUDGET percent of what it costs the reference.
+#
+# cmake -DSMALL=<probe with 1 signature> -DLARGE=<probe with SIGNATURES signatures>
+#       -DREFERENCE_SMALL=<reference with 1 signature> -DREFERENCE_LARGE=<reference with SIGNATURES signatures>
+#       -DSIGNATURES=<n> -DBUDGET=<percent> -P codesize.cmake
+#
+
+execute_process(COMMAND ${SMALL} OUTPUT_VARIABLE SMALL_TEXT RESULT_VARIABLE SMALL_RESULT OUTPUT_STRIP_TRAILING_WHITESPACE)
+execute_process(COMMAND ${LARGE} OUTPUT_VARIABLE LARGE_TEXT RESULT_VARIABLE LARGE_RESULT OUTPUT_STRIP_TRAILING_WHITESPACE)
+execute_process(COMMAND ${REFERENCE_SMALL} OUTPUT_VARIABLE REFERENCE_SMALL_TEXT RESULT_VARIABLE REFERENCE_SMALL_RESULT OUTPUT_STRIP_TRAILING_WHITESPACE)
+execute_process(COMMAND ${REFERENCE_LARGE} OUTPUT_VARIABLE REFERENCE_LARGE_TEXT RESULT_VARIABLE REFERENCE_LARGE_RESULT OUTPUT_STRIP_TRAILING_WHITESPACE)
+
+if(NOT SMALL_RESULT EQUAL 0 OR NOT LARGE_RESULT EQUAL 0 OR NOT REFERENCE_SMALL_RESULT EQUAL 0 OR NOT REFERENCE_LARGE_RESULT EQUAL 0)
+	message(FATAL_ERROR "A code size probe failed: ${SMALL_RESULT}, ${LARGE_RESULT}, ${REFERENCE_SMALL_RESULT}, ${REFERENCE_LARGE_RESULT}")
+endif()
+
+math(EXPR PER_SIGNATURE "(${LARGE_TEXT} - ${SMALL_TEXT}) / (${SIGNATURES} - 1)")
+math(EXPR REFERENCE_PER_SIGNATURE "(${REFERENCE_LARGE_TEXT} - ${REFERENCE_SMALL_TEXT}) / (${SIGNATURES} - 1)")
+math(EXPR LIMIT "${REFERENCE_PER_SIGNATURE} * ${BUDGET} / 100")
+math(EXPR PERCENT "${PER_SIGNATURE} * 100 / ${REFERENCE_PER_SIGNATURE}")
+message(STATUS "Text: ${SMALL_TEXT} bytes for 1 signature, ${LARGE_TEXT} bytes for ${SIGNATURES}, ${PER_SIGNATURE} bytes per signature, ${PERCENT}% of the reference's ${REFERENCE_PER_SIGNATURE} (budget ${BUDGET}%)")
+
+if(PER_SIGNATURE GREATER LIMIT)
+	message(FATAL_ERROR "Each signature adds ${PER_SIGNATURE} bytes of text, ${PERCENT}% of the reference's ${REFERENCE_PER_SIGNATURE}, over the budget of ${BUDGET}%")
+endif()
@@ -0,0 +1,196 @@
+///
+/// Measures the code a Federate instantiates per signature.
+///
+/// Built twice, with FEDERATE_CODESIZE_SIGNATURES set to 1 and to a larger count, each copy uses that many
+/// distinct signatures, tracked and not, and prints the size of its own text.  test/codesize.cmake divides the
+/// difference by the number of signatures added.
+///
+/// Built with FEDERATE_CODESIZE_REFERENCE, the same operations run on a minimal hand-written signal instead: a vector of
+/// std::function, std::async for the asynchronous invoke, and weak_ptr trackers under a mutex.  Its cost per signature
+/// is the baseline the budget is a ratio of, so the check follows the compiler and standard library in use.
+///
+
+#ifdef FEDERATE_CODESIZE_REFERENCE
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#else
+#include <Federate/Federate.h>
+#endif
+
+#include <cstdio>
+
+#ifndef FEDERATE_CODESIZE_SIGNATURES
+#define FEDERATE_CODESIZE_SIGNATURES 1
+#endif
+
+// The start of the code, from the C runtime, and its end, from the GNU linkers.  The symbol tables before "_init" are
+// left out: they grow with the names of exported functions rather than with their code.
+extern "C" void _init();
+extern "C" char etext;
+
+template<int N> struct Tag
+{
+	int x;
+};
+
+#ifdef FEDERATE_CODESIZE_REFERENCE
+
+template<typename Signature> class Reference;
+
+template<typename R, typename... Args> class Reference<R(Args...)>
+{
+public:
+	void push_back(std::function<R(Args...)> f)
+	{
+		this->functions.push_back(std::move(f));
+	}
+
+	std::vector<R> invoke(Args... args) const
+	{
+		auto v = std::vector<R>();
+		v.reserve(this->functions.size());
+
+		for(const auto& f : this->functions)
+		{
+			v.push_back(f(args...));
+		}
+
+		return v;
+	}
+
+	std::vector<std::future<R>> invokeAsync(Args... args) const
+	{
+		auto v = std::vector<std::future<R>>();
+		v.reserve(this->functions.size());
+
+		for(const auto& f : this->functions)
+		{
+			v.push_back(std::async(std::launch::async, f, args...));
+		}
+
+		return v;
+	}
+
+private:
+	std::vector<std::function<R(Args...)>> functions;
+};
+
+template<typename... Args> class TrackedReference
+{
+public:
+	std::shared_ptr<void> push_back(std::function<void(Args...)> f)
+	{
+		auto tracker = std::make_shared<char>();
+		std::lock_guard<std::mutex> scopedLock(this->access);
+		this->functions.push_back(std::make_pair(std::move(f), std::weak_ptr<void>(tracker)));
+		return tracker;
+	}
+
+	void invoke(Args... args) const
+	{
+		std::lock_guard<std::mutex> scopedLock(this->access);
+
+		for(const auto& f : this->functions)
+		{
+			if(f.second.expired() == false)
+			{
+				f.first(args...);
+			}
+		}
+	}
+
+	void clean()
+	{
+		std::lock_guard<std::mutex> scopedLock(this->access);
+		auto it = this->functions.begin();
+
+		while(it != this->functions.end())
+		{
+			it = (it->second.expired() == true) ? this->functions.erase(it) : it + 1;
+		}
+	}
+
+	size_t garbageSize() const
+	{
+		std::lock_guard<std::mutex> scopedLock(this->access);
+		size_t n = 0;
+
+		for(const auto& f : this->functions)
+		{
+			n += (f.second.expired() == true) ? 1 : 0;
+		}
+
+		return n;
+	}
+
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> scopedLock(this->access);
+		return this->functions.size();
+	}
+
+private:
+	std::vector<std::pair<std::function<void(Args...)>, std::weak_ptr<void>>> functions;
+	mutable std::mutex access;
+};
+
+template<typename Signature> using Plain = Reference<Signature>;
+template<typename... Args> using Tracked = TrackedReference<Args...>;
+
+#else
+
+template<typename Signature> using Plain = Federate<Signature>;
+template<typename... Args> using Tracked = Federate<void(Args...), true, true>;
+
+#endif
+
+template<int N> int Use()
+{
+	Plain<int(Tag<N>)> fed;
+	fed.push_back([](Tag<N> t) { return t.x; });
+
+	int sum = 0;
+
+	for(auto r : fed.invoke(Tag<N>{1}))
+	{
+		sum += r;
+	}
+
+	for(auto& f : fed.invokeAsync(Tag<N>{2}))
+	{
+		sum += f.get();
+	}
+
+	Tracked<Tag<N>> tracked;
+	auto tracker = tracked.push_back([&sum](Tag<N> t) { sum += t.x; });
+	tracked.invoke(Tag<N>{3});
+	tracked.clean();
+
+	return sum + static_cast<int>(tracked.garbageSize() + tracked.size());
+}
+
+template<int N> struct UseAll
+{
+	static int Run()
+	{
+		return Use<N>() + UseAll<N - 1>::Run();
+	}
+};
+
+template<> struct UseAll<0>
+{
+	static int Run()
+	{
+		return 0;
+	}
+};
+
+int main()
+{
+	const auto sum = UseAll<FEDERATE_CODESIZE_SIGNATURES>::Run();
+	std::printf("%lu\n", static_cast<unsigned long>(&etext - reinterpret_cast<const char*>(&_init)));
+	return (sum == 7 * FEDERATE_CODESIZE_SIGNATURES) ? 0 : 1;
+}
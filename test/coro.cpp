@@ -0,0 +1,184 @@
+///
+/// Coroutine test for invokeCoro and invokeCoroOn.
+///
+/// The library and the unit tests build as C++11, where FEDERATE_HAS_COROUTINES is never defined, so this test is
+/// built as C++20 on its own.  It checks inline and awaitable slots, slots started on other threads, exceptions
+/// from a slot, and FederateSingleProducer's forwarding of both members, then exits non-zero on any failure.
+///
+/// Usage: FederateCoroTest
+///
+
+#include <Federate/Federate.h>
+#include <Federate/FederateSingleProducer.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#ifdef FEDERATE_HAS_COROUTINES
+
+namespace
+{
+	size_t failures = 0;
+
+	void Check(bool passed, const std::string& what)
+	{
+		if(passed == false)
+		{
+			++failures;
+			std::cerr << "FAILED: " << what << std::endl;
+		}
+	}
+
+	void PlainSlots()
+	{
+		auto fed = Federate<int(int)>();
+
+		fed.push_back([](int x)->int
+		{
+			return x * 2;
+		});
+
+		fed.push_back([](int x)->int
+		{
+			return x + 1;
+		});
+
+		auto answers = FederateSyncWait(fed.invokeCoro(8));
+
+		Check(answers.size() == 2, "invokeCoro returns one result per plain slot");
+		Check(answers.size() == 2 && answers[0] == 16 && answers[1] == 9, "invokeCoro returns plain results in order");
+	}
+
+	void TaskSlotsOnThreads()
+	{
+		auto fed = Federate<FederateTask<int>(int), true, true>();
+
+		auto a = fed.push_back([](int x)->FederateTask<int>
+		{
+			co_return x * 2;
+		});
+
+		auto b = fed.push_back([](int x)->FederateTask<int>
+		{
+			co_return x * 3;
+		});
+
+		// Start each slot on its own thread to show they complete independently of the awaiting thread.
+		std::vector<std::thread> threads;
+		std::mutex threadsAccess;
+		auto scheduler = [&](std::coroutine_handle<> h)
+		{
+			std::lock_guard<std::mutex> scopedLock(threadsAccess);
+			threads.emplace_back([h]{ h.resume(); });
+		};
+
+		auto answers = FederateSyncWait(fed.invokeCoroOn(scheduler, 5));
+
+		for(auto& t : threads)
+		{
+			t.join();
+		}
+
+		Check(threads.size() == 2, "invokeCoroOn starts each awaitable slot through the scheduler");
+		Check(answers.size() == 2 && answers[0] == 10 && answers[1] == 15, "invokeCoroOn returns awaited results in order");
+	}
+
+	void TaskSlotThrows()
+	{
+		auto fed = Federate<FederateTask<void>(void)>();
+
+		int calls = 0;
+
+		fed.push_back([&calls]()->FederateTask<void>
+		{
+			++calls;
+			co_return;
+		});
+
+		fed.push_back([]()->FederateTask<void>
+		{
+			throw std::runtime_error("slot failed");
+			co_return;
+		});
+
+		auto task = fed.invokeCoro();
+		Check(calls == 0, "invokeCoro does not start awaitable slots until awaited");
+
+		bool threw = false;
+
+		try
+		{
+			FederateSyncWait(std::move(task));
+		}
+		catch(const std::runtime_error&)
+		{
+			threw = true;
+		}
+
+		Check(threw == true, "invokeCoro rethrows a slot's exception to the awaiter");
+		Check(calls == 1, "invokeCoro runs the other slots when one throws");
+	}
+
+	void SingleProducer()
+	{
+		FederateSingleProducer<int(int)> fed;
+		int result = 0;
+
+		std::thread([&fed]
+		{
+			fed.push_back([](int x)->int
+			{
+				return x * 4;
+			});
+		}).join();
+
+		// The push from the other thread is applied before the call.
+		auto answers = FederateSyncWait(fed.invokeCoro(2));
+		Check(answers.size() == 1 && answers[0] == 8, "FederateSingleProducer::invokeCoro applies its inbox first");
+
+		std::thread([&fed]
+		{
+			fed.push_back([](int x)->int
+			{
+				return x + 4;
+			});
+		}).join();
+
+		answers = FederateSyncWait(fed.invokeCoroOn(FederateScheduler(), 2));
+
+		for(auto answer : answers)
+		{
+			result += answer;
+		}
+
+		Check(answers.size() == 2 && result == 14, "FederateSingleProducer::invokeCoroOn applies its inbox first");
+	}
+}
+
+int main()
+{
+	PlainSlots();
+	TaskSlotsOnThreads();
+	TaskSlotThrows();
+	SingleProducer();
+
+	if(failures != 0)
+	{
+		std::cerr << failures << " coroutine check(s) failed." << std::endl;
+		return 1;
+	}
+
+	std::cout << "All coroutine checks passed." << std::endl;
+	return 0;
+}
+
+#else
+
+int main()
+{
+	std::cerr << "Built without coroutine support: compile as C++20 or later." << std::endl;
+	return 1;
+}
+
+#endif
@@ -0,0 +1,517 @@
+///
+/// Multi-threaded stress test for ThreadSafe Federates.
+///
+/// Runs N emitting threads against M threads which connect, disconnect and clean, for a fixed time per
+/// configuration, checks invariants, and reports emits per second for each emitter count.  Further phases churn
+/// slots under batched invokeAsync, under a background reclaimer, under clear, and under connect/disconnect with
+/// scoped connections.  Every transient slot returns a distinct id, so each invoke can check the list it saw.
+/// Build it with FUNCTIONFEDERATION_TSAN=ON to run the same workload under ThreadSanitizer.
+///
+/// Usage: FederateStressTest [--seconds S] [--emitters N] [--connectors M]
+///
+
+#include <Federate/Federate.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	std::atomic<size_t> violations(0);
+
+	void Fail(const std::string& what)
+	{
+		if(violations++ < 10)
+		{
+			std::cerr << "VIOLATION: " << what << std::endl;
+		}
+	}
+
+	/// Ids 0 and 1 belong to sentinel slots; transient slots take the rest in order.
+	std::atomic<uint64_t> nextId(2);
+
+	/// Set while the reclaimer phase runs: no slot state may then be destroyed on an emitting thread.
+	std::atomic<bool> emittersMustNotFree(false);
+
+	thread_local bool onEmitter = false;
+
+	///
+	/// Which transient slots are alive, indexed by id, kept outside the slots so that a check never reads a
+	/// destroyed slot's own memory.  Wide enough that ids do not wrap onto a live slot during a run.
+	///
+	const size_t LivenessSize = size_t(1) << 20;
+	const uint64_t Dead = ~uint64_t(0);
+	std::unique_ptr<std::atomic<uint64_t>[]> liveness;
+
+	///
+	/// Captured by every transient slot.  Calling a slot whose state has been destroyed trips "check".
+	///
+	struct Token
+	{
+		Token() : id(nextId.fetch_add(1, std::memory_order_relaxed))
+		{
+			liveness[this->id % LivenessSize].store(this->id, std::memory_order_release);
+		}
+
+		~Token()
+		{
+			if(onEmitter == true && emittersMustNotFree.load(std::memory_order_relaxed) == true)
+			{
+				Fail("slot state destroyed on an emitting thread despite the reclaimer");
+			}
+
+			auto expected = this->id;
+			liveness[this->id % LivenessSize].compare_exchange_strong(expected, Dead, std::memory_order_acq_rel);
+		}
+
+		Token(const Token&) = delete;
+		Token& operator=(const Token&) = delete;
+
+		uint64_t check() const
+		{
+			if(liveness[this->id % LivenessSize].load(std::memory_order_acquire) != this->id)
+			{
+				Fail("slot " + std::to_string(this->id) + " called after its state was destroyed");
+			}
+
+			return this->id;
+		}
+
+		const uint64_t id;
+	};
+
+	typedef Federate<uint64_t(int), true, true> Tracked;
+	typedef Federate<uint64_t(int), false, true> Untracked;
+
+	///
+	/// A transient slot: returns its token's id after checking that the token is alive.
+	///
+	std::function<uint64_t(int)> MakeSlot()
+	{
+		auto token = std::make_shared<Token>();
+
+		return [token](int)->uint64_t
+		{
+			return token->check();
+		};
+	}
+
+	///
+	/// One invoke's results from a Federate whose sentinel (id 0) comes first: the sentinel, then distinct ids
+	/// that have been handed out.
+	///
+	void CheckSet(const std::vector<uint64_t>& results)
+	{
+		if(results.empty() == true || results[0] != 0)
+		{
+			Fail("the sentinel slot was not called first");
+			return;
+		}
+
+		const auto issued = nextId.load(std::memory_order_acquire);
+		std::vector<uint64_t> ids(std::begin(results) + 1, std::end(results));
+		std::sort(std::begin(ids), std::end(ids));
+
+		if(std::adjacent_find(std::begin(ids), std::end(ids)) != std::end(ids))
+		{
+			Fail("an invoke called the same slot twice");
+		}
+
+		if(ids.empty() == false && (ids.front() < 2 || ids.back() >= issued))
+		{
+			Fail("an invoke returned an id no slot has");
+		}
+	}
+
+	///
+	/// Checks that "ids" are strictly increasing from "first": what a list appended to in id order and only
+	/// trimmed by erasing or clearing can show.  "consecutive" also rules out gaps.
+	///
+	void CheckOrdered(std::vector<uint64_t>::const_iterator first, std::vector<uint64_t>::const_iterator last, bool consecutive)
+	{
+		for(auto i = first; i != last && i + 1 != last; ++i)
+		{
+			if(*(i + 1) <= *i || (consecutive == true && *(i + 1) != *i + 1))
+			{
+				Fail("an invoke saw a torn list: " + std::to_string(*i) + " then " + std::to_string(*(i + 1)));
+				return;
+			}
+		}
+	}
+
+	enum class Mode
+	{
+		/// Serial invoke.
+		Serial,
+
+		/// invokeAsync with a grain, so workers hold slots while connectors drop them.
+		Async,
+
+		/// Serial invoke with a background reclaimer: emitters must never destroy slot state.
+		Reclaimed
+	};
+
+	struct Result
+	{
+		uint64_t emits;
+		double seconds;
+	};
+
+	///
+	/// One configuration: a tracked, thread-safe Federate with a permanent sentinel slot and churning transient slots.
+	///
+	Result Run(size_t emitters, size_t connectors, double seconds, Mode mode)
+	{
+		// Declared first so it outlives the Federate and every Tracker.
+		FederateReclaimer reclaimer;
+		Tracked fed;
+
+		if(mode == Mode::Reclaimed)
+		{
+			reclaimer.startBackground(std::chrono::milliseconds(1));
+			fed.setReclaimer(&reclaimer);
+			emittersMustNotFree = true;
+		}
+
+		if(mode == Mode::Async)
+		{
+			fed.setAsyncGrainSize(4);
+		}
+
+		std::atomic<uint64_t> sentinelCalls(0);
+		auto sentinel = fed.push_back([&sentinelCalls](int)->uint64_t
+		{
+			sentinelCalls.fetch_add(1, std::memory_order_relaxed);
+			return 0;
+		});
+
+		std::atomic<bool> stop(false);
+		std::atomic<uint64_t> emits(0);
+		std::vector<std::thread> threads;
+
+		for(size_t i = 0; i < emitters; ++i)
+		{
+			threads.emplace_back([&fed, &stop, &emits, mode, i]()
+			{
+				onEmitter = true;
+				uint64_t local = 0;
+				int x = static_cast<int>(i);
+				std::vector<uint64_t> results;
+
+				while(stop.load(std::memory_order_relaxed) == false)
+				{
+					if(mode == Mode::Async)
+					{
+						results.clear();
+
+						for(auto& f : fed.invokeAsync(x))
+						{
+							results.push_back(f.get());
+						}
+					}
+					else
+					{
+						results = fed.invoke(x);
+					}
+
+					CheckSet(results);
+					++local;
+					++x;
+				}
+
+				emits.fetch_add(local, std::memory_order_relaxed);
+			});
+		}
+
+		for(size_t i = 0; i < connectors; ++i)
+		{
+			threads.emplace_back([&fed, &stop, i]()
+			{
+				std::vector<Tracked::Tracker> held;
+				size_t step = i;
+
+				while(stop.load(std::memory_order_relaxed) == false)
+				{
+					held.push_back(fed.push_back(MakeSlot()));
+
+					// Drop trackers in a varying pattern so slots expire mid-invoke.
+					if(held.size() > 8 || (step % 3) == 0)
+					{
+						held.erase(std::begin(held));
+					}
+
+					if((step % 16) == 0)
+					{
+						fed.clean();
+					}
+
+					if((step % 64) == 0)
+					{
+						fed.size();
+						fed.garbageSize();
+					}
+
+					++step;
+				}
+			});
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+		stop = true;
+
+		for(auto& t : threads)
+		{
+			t.join();
+		}
+
+		const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		emittersMustNotFree = false;
+
+		// Every emit must have reached the sentinel exactly once.
+		if(sentinelCalls.load() != emits.load())
+		{
+			Fail("sentinel calls (" + std::to_string(sentinelCalls.load()) + ") != emits (" + std::to_string(emits.load()) + ")");
+		}
+
+		// Every connector has released its trackers, so only the sentinel survives a clean.  Asynchronous workers let
+		// go of their slots just after fulfilling the futures, so give them a moment.
+		const auto settle = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+		fed.clean();
+
+		while(fed.size() != 1 && std::chrono::steady_clock::now() < settle)
+		{
+			std::this_thread::yield();
+			fed.clean();
+		}
+
+		if(fed.size() != 1 || fed.garbageSize() != 0)
+		{
+			Fail("slots were lost or leaked: size " + std::to_string(fed.size()) + ", garbage " + std::to_string(fed.garbageSize()));
+		}
+
+		Result result;
+		result.emits = emits.load();
+		result.seconds = elapsed;
+		return result;
+	}
+
+	///
+	/// Non-tracked slots churned with push_back and clear.  One thread appends in id order, so an invoke must see
+	/// consecutive ids: any gap, repeat or reordering is a torn list.
+	///
+	void RunClear(size_t emitters, double seconds)
+	{
+		Untracked fed;
+		std::atomic<bool> stop(false);
+		std::vector<std::thread> threads;
+
+		for(size_t i = 0; i < emitters; ++i)
+		{
+			threads.emplace_back([&fed, &stop]()
+			{
+				while(stop.load(std::memory_order_relaxed) == false)
+				{
+					const auto results = fed.invoke(41);
+					CheckOrdered(std::begin(results), std::end(results), true);
+				}
+			});
+		}
+
+		threads.emplace_back([&fed, &stop]()
+		{
+			size_t step = 0;
+
+			while(stop.load(std::memory_order_relaxed) == false)
+			{
+				fed.push_back(MakeSlot());
+
+				if((++step % 32) == 0)
+				{
+					fed.clear();
+				}
+			}
+		});
+
+		std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+		stop = true;
+
+		for(auto& t : threads)
+		{
+			t.join();
+		}
+	}
+
+	///
+	/// Emitters invoke an upstream Federate while one thread connects and disconnects a downstream one and another
+	/// churns scoped connections on it.  An invoke sees the upstream sentinel (0), then either nothing more or the
+	/// downstream sentinel (1) followed by its scoped slots in increasing id order.
+	///
+	void RunConnect(size_t emitters, double seconds)
+	{
+		Untracked upstream;
+		Untracked downstream;
+
+		upstream.push_back([](int)->uint64_t
+		{
+			return 0;
+		});
+
+		downstream.push_back([](int)->uint64_t
+		{
+			return 1;
+		});
+
+		std::atomic<bool> stop(false);
+		std::vector<std::thread> threads;
+
+		for(size_t i = 0; i < emitters; ++i)
+		{
+			threads.emplace_back([&upstream, &stop]()
+			{
+				while(stop.load(std::memory_order_relaxed) == false)
+				{
+					const auto results = upstream.invoke(7);
+
+					if(results.empty() == true || results[0] != 0)
+					{
+						Fail("the upstream sentinel was not called first");
+					}
+					else if(results.size() > 1)
+					{
+						if(results[1] != 1)
+						{
+							Fail("downstream functions ran without the downstream sentinel first");
+						}
+
+						CheckOrdered(std::begin(results) + 2, std::end(results), false);
+					}
+				}
+			});
+		}
+
+		threads.emplace_back([&upstream, &downstream, &stop]()
+		{
+			while(stop.load(std::memory_order_relaxed) == false)
+			{
+				if(upstream.connect(downstream) == false)
+				{
+					Fail("connect refused an acyclic connection");
+				}
+
+				std::this_thread::yield();
+
+				if(upstream.disconnect(downstream) == false)
+				{
+					Fail("disconnect lost a connection");
+				}
+			}
+		});
+
+		threads.emplace_back([&downstream, &stop]()
+		{
+			std::deque<FederateScopedConnection> held;
+			size_t step = 0;
+
+			while(stop.load(std::memory_order_relaxed) == false)
+			{
+				held.push_back(downstream.push_back_scoped(MakeSlot()));
+
+				// Disconnect from the front, the back, or by letting a connection go out of scope.
+				if(held.size() > 8)
+				{
+					if((step % 2) == 0)
+					{
+						held.front().disconnect();
+					}
+
+					held.pop_front();
+				}
+				else if((step % 5) == 0)
+				{
+					held.pop_back();
+				}
+
+				++step;
+			}
+		});
+
+		std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+		stop = true;
+
+		for(auto& t : threads)
+		{
+			t.join();
+		}
+
+		if(downstream.size() != 1)
+		{
+			Fail("scoped connections leaked: downstream size " + std::to_string(downstream.size()));
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = 1.0;
+	size_t maxEmitters = std::max(2u, std::thread::hardware_concurrency());
+	size_t connectors = 2;
+
+	for(int i = 1; i + 1 < argc; i += 2)
+	{
+		if(std::strcmp(argv[i], "--seconds") == 0)
+		{
+			seconds = std::atof(argv[i + 1]);
+		}
+		else if(std::strcmp(argv[i], "--emitters") == 0)
+		{
+			maxEmitters = static_cast<size_t>(std::atoi(argv[i + 1]));
+		}
+		else if(std::strcmp(argv[i], "--connectors") == 0)
+		{
+			connectors = static_cast<size_t>(std::atoi(argv[i + 1]));
+		}
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--seconds S] [--emitters N] [--connectors M]" << std::endl;
+			return 2;
+		}
+	}
+
+	liveness.reset(new std::atomic<uint64_t>[LivenessSize]);
+
+	for(size_t i = 0; i < LivenessSize; ++i)
+	{
+		liveness[i] = Dead;
+	}
+
+	std::cout << "emitters\tconnectors\temits/sec\temits/sec/thread" << std::endl;
+
+	for(size_t emitters = 1; emitters <= maxEmitters; emitters *= 2)
+	{
+		const auto result = Run(emitters, connectors, seconds, Mode::Serial);
+		const auto rate = static_cast<double>(result.emits) / result.seconds;
+
+		std::cout << emitters << "\t\t" << connectors << "\t\t" << static_cast<uint64_t>(rate) << "\t\t" << static_cast<uint64_t>(rate / emitters) << std::endl;
+	}
+
+	Run(maxEmitters, connectors, seconds, Mode::Async);
+	Run(maxEmitters, connectors, seconds, Mode::Reclaimed);
+	RunClear(maxEmitters, seconds);
+	RunConnect(maxEmitters, seconds);
+
+	if(violations.load() != 0)
+	{
+		std::cerr << violations.load() << " invariant violations." << std::endl;
+		return 1;
+	}
+
+	std::cout << "All invariants held." << std::endl;
+	return 0;
+}
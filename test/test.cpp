@@ -1,6 +1,55 @@
 #include <Federate/Federate.h>
+#include <Federate/FederateAffine.h>
+#include <Federate/FederateCoalescing.h>
+#include <Federate/FederateRecording.h>
+#include <Federate/FederateRegistry.h>
+#include <Federate/FederateSharedMemory.h>
+#include <Federate/FederateSingleProducer.h>
+#include <Federate/FederateThreadPool.h>
 #include <gtest/gtest.h>
 
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#endif
+
+///
+/// Counts every allocation made through the global operator new, and the bytes asked for, so a test can check what
+/// a path allocates.
+///
+static std::atomic<size_t> Allocations(0);
+static std::atomic<size_t> AllocatedBytes(0);
+
+void* operator new(std::size_t n)
+{
+	++Allocations;
+	AllocatedBytes += n;
+
+	auto p = std::malloc((n == 0) ? 1 : n);
+
+	if(p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
 template<typename F> void CallCommonAPIFunctions(F&& f)
 {
 	f.size();
@@ -781,3 +830,3254 @@ TEST(Federate, SlotDemo)
 	std::cerr << std::endl;
 	foo.callFunctionsAsync("***");
 }
+
+#ifdef FEDERATE_HAS_COROUTINES
+TEST(Federate, IntInt_Coro)
+{
+	auto fed = Federate<int(int)>();
+
+	fed.push_back([](int x)->int
+	{
+		return x * 2;
+	});
+
+	fed.push_back([](int x)->int
+	{
+		return x + 1;
+	});
+
+	auto answers = FederateSyncWait(fed.invokeCoro(8));
+
+	ASSERT_EQ(2, answers.size());
+	EXPECT_EQ(16, answers[0]);
+	EXPECT_EQ(9, answers[1]);
+}
+
+TEST(Federate, TaskInt_Coro_Tracked_ThreadSafe)
+{
+	auto fed = Federate<FederateTask<int>(int), true, true>();
+
+	auto a = fed.push_back([](int x)->FederateTask<int>
+	{
+		co_return x * 2;
+	});
+
+	auto b = fed.push_back([](int x)->FederateTask<int>
+	{
+		co_return x * 3;
+	});
+
+	// Start each slot on its own thread to show they complete independently of the awaiting thread.
+	std::vector<std::thread> threads;
+	std::mutex threadsAccess;
+	auto scheduler = [&](std::coroutine_handle<> h)
+	{
+		std::lock_guard<std::mutex> scopedLock(threadsAccess);
+		threads.emplace_back([h]{ h.resume(); });
+	};
+
+	auto answers = FederateSyncWait(fed.invokeCoroOn(scheduler, 5));
+
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+
+	EXPECT_EQ(2, threads.size());
+	ASSERT_EQ(2, answers.size());
+	EXPECT_EQ(10, answers[0]);
+	EXPECT_EQ(15, answers[1]);
+}
+
+TEST(Federate, TaskVoid_Coro)
+{
+	auto fed = Federate<FederateTask<void>(void)>();
+
+	int calls = 0;
+
+	fed.push_back([&calls]()->FederateTask<void>
+	{
+		++calls;
+		co_return;
+	});
+
+	fed.push_back([]()->FederateTask<void>
+	{
+		throw std::runtime_error("slot failed");
+		co_return;
+	});
+
+	auto task = fed.invokeCoro();
+	EXPECT_EQ(0, calls);
+
+	EXPECT_THROW(FederateSyncWait(std::move(task)), std::runtime_error);
+	EXPECT_EQ(1, calls);
+}
+#endif
+
+TEST(Federate, VoidInt_Coalescing)
+{
+	// Sum every emit between flushes.
+	auto fed = FederateCoalescing<void(int)>([](std::tuple<int>& pending, int x)
+	{
+		std::get<0>(pending) += x;
+	});
+
+	int calls = 0;
+	int total = 0;
+
+	fed.push_back([&calls, &total](int x)
+	{
+		++calls;
+		total = x;
+	});
+
+	EXPECT_FALSE(fed.flush());
+
+	for(int i = 1; i <= 1000; ++i)
+	{
+		fed.emit(i);
+	}
+
+	EXPECT_TRUE(fed.pending());
+	EXPECT_EQ(1000, fed.pendingCount());
+	EXPECT_EQ(0, calls);
+
+	EXPECT_TRUE(fed.flush());
+	EXPECT_EQ(1, calls);
+	EXPECT_EQ(500500, total);
+	EXPECT_FALSE(fed.pending());
+	EXPECT_EQ(0, fed.pendingCount());
+}
+
+TEST(Federate, VoidIntString_Coalescing_ThreadSafe)
+{
+	// The default keeps only the latest arguments.
+	FederateCoalescing<void(int, const std::string&), false, true> fed;
+
+	std::vector<std::string> seen;
+
+	fed.push_back([&seen](int x, const std::string& s)
+	{
+		seen.push_back(std::to_string(x) + s);
+	});
+
+	fed.emit(1, "a");
+	fed.emit(2, "b");
+	fed.emit(3, "c");
+	fed.flush();
+
+	fed.emit(4, "d");
+	fed.flush();
+
+	ASSERT_EQ(2, seen.size());
+	EXPECT_EQ("3c", seen[0]);
+	EXPECT_EQ("4d", seen[1]);
+}
+
+TEST(Federate, VoidValue_Coalescing_Window)
+{
+	// Pending arguments are built from the emitted ones, so they need no default constructor.
+	struct Reading
+	{
+		explicit Reading(int x) : value(x)
+		{
+		}
+
+		int value;
+	};
+
+	auto fed = FederateCoalescing<void(Reading)>([](std::tuple<Reading>& pending, Reading x)
+	{
+		std::get<0>(pending).value += x.value;
+	}, std::chrono::milliseconds(20));
+
+	std::vector<int> seen;
+
+	fed.push_back([&seen](Reading x)
+	{
+		seen.push_back(x.value);
+	});
+
+	fed.emit(Reading(1));
+	fed.emit(Reading(2));
+
+	// Nothing flushes the pending emits on its own, and "flushDue" waits for the window.
+	EXPECT_FALSE(fed.flushDue());
+	EXPECT_TRUE(seen.empty());
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	EXPECT_TRUE(fed.pending());
+
+	EXPECT_TRUE(fed.flushDue());
+	ASSERT_EQ(1, seen.size());
+	EXPECT_EQ(3, seen[0]);
+	EXPECT_FALSE(fed.flushDue());
+}
+
+TEST(Federate, IntInt_Registry)
+{
+	FederateRegistry<std::string, int(int)> registry;
+
+	for(int i = 0; i < 1000; ++i)
+	{
+		registry.push_back("topic/" + std::to_string(i), [i](int x)->int
+		{
+			return x + i;
+		});
+	}
+
+	EXPECT_EQ(1000, registry.topicCount());
+	EXPECT_EQ(1, registry.size("topic/42"));
+
+	auto answers = registry.invoke("topic/42", 1);
+	ASSERT_EQ(1, answers.size());
+	EXPECT_EQ(43, answers[0]);
+
+	EXPECT_TRUE(registry.invoke("missing", 1).empty());
+	EXPECT_EQ(1000, registry.topicCount());
+
+	registry.clear("topic/42");
+	EXPECT_EQ(0, registry.size("topic/42"));
+	EXPECT_TRUE(registry.invoke("topic/42", 1).empty());
+
+	// A topic left without functions is removed, and the rest are still found.
+	EXPECT_EQ(999, registry.topicCount());
+	EXPECT_EQ(1, registry.size("topic/999"));
+}
+
+TEST(Federate, IntInt_Registry_ThreadSafe_TopicsInPlace)
+{
+	FederateRegistry<std::string, int(int), true> registry;
+
+	auto prefix = registry.push_back_prefix("sensor/", [](int x)->int
+	{
+		return x;
+	});
+
+	// Emitting on keys which only a prefix subscription matches calls it, but creates no topics.
+	for(int i = 0; i < 1000; ++i)
+	{
+		EXPECT_EQ(std::vector<int>({i}), registry.invoke("sensor/" + std::to_string(i), i));
+	}
+
+	EXPECT_EQ(0, registry.topicCount());
+	EXPECT_EQ(1, registry.size("sensor/42"));
+
+	std::vector<FederateRegistryConnection> sensors;
+
+	for(int i = 0; i < 1000; ++i)
+	{
+		sensors.push_back(registry.push_back("sensor/" + std::to_string(i), [](int x)->int
+		{
+			return -x;
+		}));
+	}
+
+	EXPECT_EQ(1000, registry.topicCount());
+	EXPECT_EQ(std::vector<int>({42, -42}), registry.invoke("sensor/42", 42));
+
+	// A new topic only allocates for itself, however many topics there are.
+	const auto before = AllocatedBytes.load();
+	registry.push_back("sensor/new", [](int x)->int
+	{
+		return x;
+	});
+	EXPECT_GT(before + 1024, AllocatedBytes.load());
+
+	// Topics left without push_back functions are gone, and their keys fall back to the prefix subscriptions.
+	for(auto connection : sensors)
+	{
+		EXPECT_TRUE(registry.erase(connection));
+	}
+
+	EXPECT_EQ(1, registry.topicCount());
+	EXPECT_EQ(std::vector<int>({7}), registry.invoke("sensor/42", 7));
+
+	EXPECT_TRUE(registry.erase(prefix));
+	EXPECT_EQ(0, registry.size("sensor/42"));
+	EXPECT_TRUE(registry.invoke("sensor/42", 1).empty());
+
+	// They come back with their key.
+	for(int i = 0; i < 1000; ++i)
+	{
+		registry.push_back("sensor/" + std::to_string(i), [](int x)->int
+		{
+			return x;
+		});
+	}
+
+	EXPECT_EQ(1001, registry.topicCount());
+	EXPECT_EQ(1, registry.size("sensor/999"));
+}
+
+TEST(Federate, VoidString_Registry_Prefix_ThreadSafe)
+{
+	FederateRegistry<std::string, void(const std::string&), true> registry;
+
+	std::vector<std::string> seen;
+
+	auto exact = registry.push_back("sensor/temp", [&seen](const std::string& x)
+	{
+		seen.push_back("exact " + x);
+	});
+
+	auto prefix = registry.push_back_prefix("sensor/", [&seen](const std::string& x)
+	{
+		seen.push_back("prefix " + x);
+	});
+
+	// An existing topic picks the prefix subscription up immediately; a key without a topic matches it on each emit.
+	registry.invoke("sensor/temp", "a");
+	registry.invoke("sensor/humidity", "b");
+	registry.invoke("motor/speed", "c");
+
+	ASSERT_EQ(3, seen.size());
+	EXPECT_EQ("exact a", seen[0]);
+	EXPECT_EQ("prefix a", seen[1]);
+	EXPECT_EQ("prefix b", seen[2]);
+	EXPECT_EQ(1, registry.size("sensor/humidity"));
+	EXPECT_EQ(1, registry.topicCount());
+
+	EXPECT_TRUE(registry.erase(prefix));
+	EXPECT_FALSE(registry.erase(prefix));
+	EXPECT_EQ(0, registry.size("sensor/humidity"));
+	EXPECT_EQ(1, registry.topicCount());
+
+	seen.clear();
+	registry.invoke("sensor/temp", "d");
+	registry.invoke("sensor/pressure", "e");
+
+	ASSERT_EQ(1, seen.size());
+	EXPECT_EQ("exact d", seen[0]);
+
+	EXPECT_TRUE(registry.erase(exact));
+	EXPECT_FALSE(registry.erase(exact));
+	EXPECT_EQ(0, registry.size("sensor/temp"));
+	EXPECT_EQ(0, registry.topicCount());
+
+	// Clearing a topic removes its own functions but not the prefix subscriptions matching it.
+	auto again = registry.push_back_prefix("sensor/", [&seen](const std::string& x)
+	{
+		seen.push_back("prefix " + x);
+	});
+
+	auto cleared = registry.push_back("sensor/temp", [&seen](const std::string& x)
+	{
+		seen.push_back("exact " + x);
+	});
+
+	EXPECT_EQ(2, registry.size("sensor/temp"));
+	registry.clear("sensor/temp");
+	EXPECT_FALSE(registry.erase(cleared));
+	EXPECT_EQ(1, registry.size("sensor/temp"));
+
+	seen.clear();
+	registry.invoke("sensor/temp", "f");
+	ASSERT_EQ(1, seen.size());
+	EXPECT_EQ("prefix f", seen[0]);
+
+	EXPECT_TRUE(registry.erase(again));
+	EXPECT_EQ(0, registry.size("sensor/temp"));
+	EXPECT_EQ(0, registry.size("sensor/pressure"));
+}
+
+TEST(Federate, VoidInt_Registry_IntKey_ThreadSafe_Reentrant)
+{
+	FederateRegistry<int, void(int), true> registry;
+	std::vector<int> seen;
+
+	// Functions run without the registry's lock, so they may emit on another topic and subscribe.
+	registry.push_back(1, [&registry](int x)
+	{
+		registry.invoke(2, x + 1);
+	});
+
+	registry.push_back(2, [&registry, &seen](int x)
+	{
+		seen.push_back(x);
+
+		registry.push_back(2, [&seen](int y)
+		{
+			seen.push_back(-y);
+		});
+	});
+
+	// The list being walked is not changed by the function subscribing to its own topic.
+	registry.invoke(1, 1);
+	ASSERT_EQ(1, seen.size());
+	EXPECT_EQ(2, seen[0]);
+	EXPECT_EQ(2, registry.size(2));
+
+	seen.clear();
+	registry.invoke(2, 5);
+	ASSERT_EQ(2, seen.size());
+	EXPECT_EQ(5, seen[0]);
+	EXPECT_EQ(-5, seen[1]);
+	EXPECT_EQ(2, registry.topicCount());
+}
+
+TEST(Federate, VoidInt_Registry_ThreadSafe_Reclaim)
+{
+	FederateRegistry<int, void(int), true> registry;
+
+	// Emitting takes no lock and copies nothing, so it allocates nothing.
+	registry.push_back(2, [](int)
+	{
+	});
+
+	const auto before = Allocations.load();
+	registry.invoke(2, 0);
+	registry.invoke(3, 0);
+	EXPECT_EQ(before, Allocations.load());
+
+	// A function which erases itself is not freed while it runs, nor while the walk which called it is under way.
+	auto alive = std::make_shared<int>(0);
+	std::weak_ptr<int> watch = alive;
+	FederateRegistryConnection self = 0;
+	bool freedWhileRunning = true;
+
+	self = registry.push_back(1, [alive, &registry, &self, &watch, &freedWhileRunning](int)
+	{
+		registry.erase(self);
+		freedWhileRunning = watch.expired();
+	});
+
+	alive.reset();
+	registry.invoke(1, 0);
+	EXPECT_FALSE(freedWhileRunning);
+	EXPECT_EQ(0, registry.size(1));
+	EXPECT_FALSE(watch.expired());
+
+	// The next change, with no reader left, frees it.
+	registry.clear(2);
+	EXPECT_TRUE(watch.expired());
+}
+
+TEST(Federate, IntInt_Registry_ThreadSafe_EmitWhileWriting)
+{
+	FederateRegistry<int, int(int), true> registry;
+
+	registry.push_back(0, [](int x)->int
+	{
+		return x;
+	});
+
+	std::atomic<bool> stop(false);
+	std::atomic<bool> torn(false);
+	std::vector<std::thread> emitters;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		emitters.emplace_back([&registry, &stop, &torn]()
+		{
+			while(stop.load() == false)
+			{
+				// Topic 0 always has its first function; topic 1 comes and goes.
+				auto results = registry.invoke(0, 7);
+
+				if(results.empty() == true || results[0] != 7 || results.size() > 2)
+				{
+					torn = true;
+				}
+
+				registry.invoke(1, 7);
+			}
+		});
+	}
+
+	for(int i = 0; i < 2000; ++i)
+	{
+		auto extra = registry.push_back(0, [](int x)->int
+		{
+			return -x;
+		});
+
+		auto other = registry.push_back(1, [](int x)->int
+		{
+			return x;
+		});
+
+		registry.erase(extra);
+		registry.erase(other);
+	}
+
+	stop = true;
+
+	for(auto& t : emitters)
+	{
+		t.join();
+	}
+
+	EXPECT_FALSE(torn.load());
+	EXPECT_EQ(1, registry.topicCount());
+	EXPECT_EQ(1, registry.size(0));
+}
+
+TEST(Federate, VoidInt_Tracked_ThreadSafe_Reclaimer)
+{
+	// Records the thread its destructor runs on.
+	struct Heavy
+	{
+		explicit Heavy(std::thread::id* x) : destroyedOn(x)
+		{
+		}
+
+		~Heavy()
+		{
+			*this->destroyedOn = std::this_thread::get_id();
+		}
+
+		std::thread::id* destroyedOn;
+	};
+
+	FederateReclaimer reclaimer;
+	auto fed = Federate<void(int), true, true>();
+	fed.setReclaimer(&reclaimer);
+
+	std::thread::id destroyedOn;
+	auto heavy = std::make_shared<Heavy>(&destroyedOn);
+
+	std::mutex gate;
+	std::unique_lock<std::mutex> hold(gate);
+
+	auto tracker = fed.push_back([heavy, &gate](int)
+	{
+		std::lock_guard<std::mutex> wait(gate);
+	});
+
+	heavy.reset();
+
+	auto futures = fed.invokeAsync(1);
+	ASSERT_EQ(1, futures.size());
+
+	// Disconnect while the slot is still running; the worker now holds the last reference.
+	tracker.reset();
+	hold.unlock();
+	futures[0].get();
+
+	EXPECT_EQ(std::thread::id(), destroyedOn);
+	EXPECT_EQ(1, reclaimer.retiredSize());
+
+	EXPECT_EQ(1, reclaimer.reclaim());
+	EXPECT_EQ(std::this_thread::get_id(), destroyedOn);
+	EXPECT_EQ(0, reclaimer.retiredSize());
+}
+
+TEST(Federate, VoidInt_Tracked_Reclaimer_ReleaseAllocates)
+{
+	FederateReclaimer reclaimer;
+	auto fed = Federate<void(int), true>();
+	fed.setReclaimer(&reclaimer);
+
+	std::vector<Federate<void(int), true>::Tracker> trackers;
+
+	for(int i = 0; i < 8; ++i)
+	{
+		trackers.push_back(fed.push_back([](int){}));
+	}
+
+	// Clearing retires the Federate's own references in one piece.
+	fed.clear();
+	EXPECT_EQ(1, reclaimer.reclaim());
+
+	// Dropping the last reference hands the slot over in place: no allocation on the releasing thread.
+	const auto before = Allocations.load();
+	trackers.clear();
+	EXPECT_EQ(before, Allocations.load());
+
+	EXPECT_EQ(8, reclaimer.retiredSize());
+	EXPECT_EQ(8, reclaimer.reclaim());
+	EXPECT_EQ(0, reclaimer.retiredSize());
+}
+
+TEST(Federate, VoidInt_Tracked_ThreadSafe_Reclaimer_ConcurrentRelease)
+{
+	FederateReclaimer reclaimer;
+	auto fed = Federate<void(int), true, true>();
+	fed.setReclaimer(&reclaimer);
+
+	for(int round = 0; round < 50; ++round)
+	{
+		auto destroyed = std::make_shared<std::atomic<int>>(0);
+		std::shared_ptr<void> canary(nullptr, [destroyed](void*)
+		{
+			++*destroyed;
+		});
+
+		auto tracker = fed.push_back([canary](int)
+		{
+		});
+
+		canary.reset();
+
+		// Several workers hold the slot; whichever of them (or the Tracker) lets go last must retire it.
+		auto futures = fed.invokeAsync(1);
+		auto more = fed.invokeAsync(2);
+		tracker.reset();
+
+		for(auto& f : futures)
+		{
+			f.get();
+		}
+
+		for(auto& f : more)
+		{
+			f.get();
+		}
+
+		// The last worker drops its reference after fulfilling the future: wait for the handoff.
+		while(reclaimer.retiredSize() == 0)
+		{
+			std::this_thread::yield();
+		}
+
+		EXPECT_EQ(0, destroyed->load());
+		EXPECT_EQ(1, reclaimer.reclaim());
+		EXPECT_EQ(1, destroyed->load());
+	}
+}
+
+TEST(Federate, IntInt_Reclaimer_Clear)
+{
+	FederateReclaimer reclaimer;
+	auto fed = Federate<int(int)>();
+	fed.setReclaimer(&reclaimer);
+
+	auto counted = std::make_shared<int>(0);
+
+	fed.push_back([counted](int x)->int
+	{
+		return x;
+	});
+
+	EXPECT_EQ(2, counted.use_count());
+
+	fed.clear();
+	EXPECT_TRUE(fed.empty());
+	EXPECT_EQ(2, counted.use_count());
+
+	reclaimer.reclaim();
+	EXPECT_EQ(1, counted.use_count());
+}
+
+TEST(Federate, IntInt_Throttled)
+{
+	auto fed = Federate<int(int)>();
+
+	fed.push_back([](int x)->int
+	{
+		return x;
+	});
+
+	// At most twice per hour, so the third and later invocations skip it.
+	fed.push_back_throttled([](int x)->int
+	{
+		return x * 10;
+	}, 2, std::chrono::hours(1));
+
+	EXPECT_EQ(2, fed.invoke(1).size());
+	EXPECT_EQ(2, fed.invoke(2).size());
+
+	auto answers = fed.invoke(3);
+	ASSERT_EQ(1, answers.size());
+	EXPECT_EQ(3, answers[0]);
+}
+
+TEST(Federate, VoidInt_Tracked_Debounced)
+{
+	auto fed = Federate<void(int), true>();
+
+	int plainCalls = 0;
+	std::vector<int> debounced;
+
+	auto plain = fed.push_back([&plainCalls](int)
+	{
+		++plainCalls;
+	});
+
+	auto quiet = fed.push_back_debounced([&debounced](int x)
+	{
+		debounced.push_back(x);
+	}, std::chrono::milliseconds(20));
+
+	fed.invoke(1);
+	fed.invoke(2);
+	fed.invoke(3);
+
+	EXPECT_EQ(3, plainCalls);
+	EXPECT_EQ(0, fed.pollTimers());
+	EXPECT_TRUE(debounced.empty());
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+
+	EXPECT_EQ(1, fed.pollTimers());
+	ASSERT_EQ(1, debounced.size());
+	EXPECT_EQ(3, debounced[0]);
+
+	// Nothing pending any more.
+	EXPECT_EQ(0, fed.pollTimers());
+
+	// Timed slots keep their state through clean().
+	fed.push_back([](int){});
+	fed.clean();
+	EXPECT_EQ(2, fed.size());
+
+	fed.invoke(4);
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	EXPECT_EQ(1, fed.pollTimers());
+	ASSERT_EQ(2, debounced.size());
+	EXPECT_EQ(4, debounced[1]);
+}
+
+TEST(Federate, VoidInt_Tracked_Debounced_Deadlines)
+{
+	auto fed = Federate<void(int), true>();
+
+	std::vector<int> slow;
+	std::vector<int> fast;
+
+	auto dropped = fed.push_back([](int){});
+
+	auto hour = fed.push_back_debounced([&slow](int x)
+	{
+		slow.push_back(x);
+	}, std::chrono::hours(1));
+
+	auto soon = fed.push_back_debounced([&fast](int x)
+	{
+		fast.push_back(x);
+	}, std::chrono::milliseconds(100));
+
+	fed.invoke(1);
+
+	// Compacting moves the pending calls to new positions.
+	dropped.reset();
+	fed.clean();
+	EXPECT_EQ(2, fed.size());
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+	// Only the call which is due fires; the other stays pending.
+	EXPECT_EQ(1, fed.pollTimers());
+	ASSERT_EQ(1, fast.size());
+	EXPECT_EQ(1, fast[0]);
+	EXPECT_TRUE(slow.empty());
+
+	// An invocation after the deadline was queued moves it later, so a poll before the new one makes no call.
+	fed.invoke(2);
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	fed.invoke(3);
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	EXPECT_EQ(0, fed.pollTimers());
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(150));
+	EXPECT_EQ(1, fed.pollTimers());
+	ASSERT_EQ(2, fast.size());
+	EXPECT_EQ(3, fast[1]);
+	EXPECT_TRUE(slow.empty());
+}
+
+TEST(Federate, IntInt_ErrorPolicy)
+{
+	auto fed = Federate<int(int)>();
+
+	fed.push_back([](int x)->int
+	{
+		return x;
+	});
+
+	fed.push_back([](int)->int
+	{
+		throw std::runtime_error("slot failed");
+	});
+
+	fed.push_back([](int x)->int
+	{
+		return x * 2;
+	});
+
+	// The default still propagates.
+	EXPECT_THROW(fed.invoke(1), std::runtime_error);
+
+	auto checked = fed.invokeChecked(2);
+	ASSERT_EQ(2, checked.results.size());
+	EXPECT_EQ(2, checked.results[0]);
+	EXPECT_EQ(4, checked.results[1]);
+	ASSERT_EQ(1, checked.errors.size());
+	EXPECT_EQ(1, checked.errors[0].slot);
+	EXPECT_THROW(std::rethrow_exception(checked.errors[0].error), std::runtime_error);
+
+	fed.setErrorPolicy(FederateErrorPolicy::Collect);
+	EXPECT_EQ(2, fed.invoke(3).size());
+	EXPECT_EQ(2, fed.invoke(4).size());
+	EXPECT_EQ(2, fed.takeErrors().size());
+	EXPECT_TRUE(fed.takeErrors().empty());
+}
+
+TEST(Federate, VoidVoid_Tracked_ThreadSafe_ErrorHandler)
+{
+	auto fed = Federate<void(void), true, true>();
+
+	int calls = 0;
+	std::vector<size_t> failed;
+
+	auto a = fed.push_back([]()
+	{
+		throw std::logic_error("first");
+	});
+
+	auto b = fed.push_back([&calls]()
+	{
+		++calls;
+	});
+
+	fed.setErrorPolicy(FederateErrorPolicy::Handler);
+	fed.setErrorHandler([&failed](const FederateError& e)
+	{
+		failed.push_back(e.slot);
+	});
+
+	EXPECT_NO_THROW(fed.invoke());
+	EXPECT_EQ(1, calls);
+	ASSERT_EQ(1, failed.size());
+	EXPECT_EQ(0, failed[0]);
+
+	auto checked = fed.invokeChecked();
+	EXPECT_EQ(1, checked.errors.size());
+	EXPECT_EQ(2, calls);
+	EXPECT_EQ(1, failed.size());
+}
+
+TEST(Federate, IntInt_SingleProducer)
+{
+	FederateSingleProducer<int(int)> fed;
+
+	// The owner's own push_back takes effect immediately.
+	fed.push_back([](int x)->int
+	{
+		return x;
+	});
+
+	EXPECT_EQ(1, fed.size());
+
+	std::vector<std::thread> connectors;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		connectors.emplace_back([&fed]()
+		{
+			for(int j = 0; j < 100; ++j)
+			{
+				fed.push_back([](int x)->int
+				{
+					return x + 1;
+				});
+			}
+		});
+	}
+
+	for(auto& t : connectors)
+	{
+		t.join();
+	}
+
+	// Cross-thread connects are queued until the owner next uses the Federate, by any entry point.
+	// The owner's function returns 0, which invokeFirst passes over; the queued ones return 1.
+	EXPECT_EQ(1, fed.invokeFirst(0));
+	EXPECT_EQ(401, fed.size());
+
+	auto answers = fed.invoke(1);
+	EXPECT_EQ(401, answers.size());
+
+	std::thread([&fed]()
+	{
+		fed.clear();
+	}).join();
+
+	EXPECT_TRUE(fed.empty());
+	EXPECT_TRUE(fed.invoke(1).empty());
+
+	std::thread([&fed]()
+	{
+		fed.push_back([](int x)->int
+		{
+			return x * 2;
+		});
+	}).join();
+
+	EXPECT_EQ(6, fed.invokeFirst(3));
+
+	std::thread([&fed]()
+	{
+		fed.clear();
+	}).join();
+
+	EXPECT_TRUE(fed.invokeChecked(3).results.empty());
+}
+
+TEST(Federate, IntInt_SingleProducer_OrderedEntryPoints)
+{
+	FederateSingleProducer<int(int)> fed;
+
+	auto queue = [&fed](int value)
+	{
+		std::thread([&fed, value]()
+		{
+			fed.push_back([value](int)->int
+			{
+				return value;
+			});
+		}).join();
+	};
+
+	// A queued function is applied before one the owner adds by any other entry point, so it stays first.
+	queue(1);
+	fed.push_back_pinned([](int)->int { return 2; });
+	queue(3);
+	fed.push_back_throttled([](int)->int { return 4; }, 10, std::chrono::seconds(1));
+	queue(5);
+	fed.push_back_on_node([](int)->int { return 6; }, 0);
+	EXPECT_EQ(std::vector<int>({1, 2, 3, 4, 5, 6}), fed.invoke(0));
+
+	// Reading the memory in use counts queued functions, and "assign" replaces them.  Functions are stored by value,
+	// so drop the spare capacity first for the seventh to show.
+	fed.shrink_to_fit();
+	const auto six = fed.memoryUsage().slots;
+	queue(7);
+	EXPECT_LT(six, fed.memoryUsage().slots);
+	EXPECT_EQ(7, fed.size());
+
+	queue(8);
+	std::vector<std::function<int(int)>> replacement(1, [](int)->int { return 9; });
+	fed.assign(std::begin(replacement), std::end(replacement));
+	EXPECT_EQ(std::vector<int>({9}), fed.invoke(0));
+
+	// So does a scoped connection.
+	queue(10);
+	auto connection = fed.push_back_scoped([](int)->int { return 11; });
+	EXPECT_EQ(std::vector<int>({9, 10, 11}), fed.invoke(0));
+
+	// And invoking into the thread's scratch vector.
+	queue(12);
+	EXPECT_EQ(std::vector<int>({9, 10, 11, 12}), fed.invokeScratch(0));
+
+	// The Federate underneath cannot be reached, so nothing can read the functions past the inbox.
+	EXPECT_FALSE((std::is_convertible<FederateSingleProducer<int(int)>&, Federate<int(int), false, false>&>::value));
+}
+
+TEST(Federate, VoidInt_Tracked_SingleProducer)
+{
+	FederateSingleProducer<void(int), true> fed;
+
+	int total = 0;
+	FederateSingleProducer<void(int), true>::Tracker tracker;
+
+	std::thread([&fed, &total, &tracker]()
+	{
+		tracker = fed.push_back([&total](int x)
+		{
+			total += x;
+		});
+	}).join();
+
+	fed.invoke(5);
+	EXPECT_EQ(5, total);
+
+	tracker.reset();
+	fed.invoke(5);
+	EXPECT_EQ(5, total);
+	EXPECT_EQ(1, fed.garbageSize());
+}
+
+TEST(Federate, VoidInt_Tracked_SingleProducer_Reclaimer)
+{
+	FederateReclaimer reclaimer;
+	FederateSingleProducer<void(int), true> fed;
+	fed.setReclaimer(&reclaimer);
+
+	int total = 0;
+	FederateSingleProducer<void(int), true>::Tracker remote;
+
+	std::thread([&fed, &total, &remote]()
+	{
+		remote = fed.push_back([&total](int x)
+		{
+			total += x;
+		});
+	}).join();
+
+	auto local = fed.push_back([&total](int x)
+	{
+		total += x * 10;
+	});
+
+	fed.invoke(1);
+	EXPECT_EQ(11, total);
+
+	// Both are retired rather than destroyed on the owner's thread, whichever thread added them.
+	remote.reset();
+	local.reset();
+	EXPECT_EQ(2, reclaimer.retiredSize());
+	EXPECT_EQ(2, reclaimer.reclaim());
+}
+
+TEST(Federate, IntInt_Lazy)
+{
+	auto fed = Federate<int(int)>();
+	int calls = 0;
+
+	for(int i = 0; i < 5; ++i)
+	{
+		fed.push_back([&calls, i](int x)->int
+		{
+			++calls;
+			return x + i;
+		});
+	}
+
+	std::vector<int> seen;
+
+	for(auto r : fed.invokeLazy(10))
+	{
+		seen.push_back(r);
+
+		if(r == 12)
+		{
+			break;
+		}
+	}
+
+	// Functions after the break are never called.
+	EXPECT_EQ(3, calls);
+	ASSERT_EQ(3, seen.size());
+	EXPECT_EQ(10, seen[0]);
+	EXPECT_EQ(12, seen[2]);
+
+	calls = 0;
+	auto lazy = fed.invokeLazy(1);
+	EXPECT_EQ(0, calls);
+	EXPECT_EQ(5, std::distance(lazy.begin(), lazy.end()));
+	EXPECT_EQ(5, calls);
+
+	// Reference parameters refer to the caller's object, as with invoke.
+	auto appending = Federate<size_t(std::vector<int>&)>();
+
+	for(int i = 0; i < 3; ++i)
+	{
+		appending.push_back([i](std::vector<int>& v)->size_t
+		{
+			v.push_back(i);
+			return v.size();
+		});
+	}
+
+	std::vector<int> values;
+
+	for(auto size : appending.invokeLazy(values))
+	{
+		EXPECT_EQ(values.size(), size);
+	}
+
+	EXPECT_EQ((std::vector<int>{0, 1, 2}), values);
+}
+
+TEST(Federate, StringVoid_Lazy_Tracked_ThreadSafe)
+{
+	auto fed = Federate<std::string(void), true, true>();
+	fed.setErrorPolicy(FederateErrorPolicy::Collect);
+
+	auto a = fed.push_back([]()->std::string
+	{
+		return "a";
+	});
+
+	auto b = fed.push_back([]()->std::string
+	{
+		return "b";
+	});
+
+	auto c = fed.push_back([]()->std::string
+	{
+		throw std::runtime_error("slot failed");
+	});
+
+	auto d = fed.push_back([]()->std::string
+	{
+		return "d";
+	});
+
+	b.reset();
+
+	std::string joined;
+
+	for(const auto& r : fed.invokeLazy())
+	{
+		joined += r;
+
+		// The lock is only held while a function runs, so the loop may use the Federate.
+		EXPECT_EQ(4, fed.size());
+	}
+
+	// Expired and throwing functions are skipped.
+	EXPECT_EQ("ad", joined);
+	EXPECT_EQ(1, fed.takeErrors().size());
+}
+
+TEST(Federate, IntInt_MoveOnly)
+{
+	struct AddOwned
+	{
+		explicit AddOwned(std::unique_ptr<int> x) : offset(std::move(x))
+		{
+		}
+
+		int operator()(int x) const
+		{
+			return x + *this->offset;
+		}
+
+		std::unique_ptr<int> offset;
+	};
+
+	auto fed = Federate<int(int)>();
+	fed.push_back(AddOwned(std::unique_ptr<int>(new int(100))));
+
+	// Async calls share the stored function, so they see and keep the state it mutates.
+	int calls = 0;
+
+	fed.push_back([calls](int)mutable->int
+	{
+		return ++calls;
+	});
+
+	auto results = fed.invoke(1);
+	ASSERT_EQ(2, results.size());
+	EXPECT_EQ(101, results[0]);
+	EXPECT_EQ(1, results[1]);
+
+	// Small callables are stored in place; a move-only one lives on the heap.
+	EXPECT_EQ(sizeof(AddOwned), fed.memoryUsage().captures);
+
+	auto futures = fed.invokeAsync(2);
+	ASSERT_EQ(2, futures.size());
+	EXPECT_EQ(102, futures[0].get());
+	EXPECT_EQ(2, futures[1].get());
+
+	EXPECT_EQ(3, fed.invoke(3)[1]);
+
+	// Copying the Federate copies the counter, and shares the move-only function.
+	auto copy = fed;
+	EXPECT_EQ(4, copy.invoke(4)[1]);
+	EXPECT_EQ(4, fed.invoke(4)[1]);
+	EXPECT_EQ(104, copy.invoke(4)[0]);
+
+	// The counter moved to the heap to be shared with the asynchronous calls.
+	EXPECT_EQ(sizeof(AddOwned) + sizeof(int), fed.memoryUsage().captures);
+}
+
+TEST(Federate, VoidInt_MoveOnly_Tracked_ThreadSafe)
+{
+	struct Scaled
+	{
+		std::shared_ptr<int> sum;
+		std::unique_ptr<int> scale;
+
+		void operator()(int x) const
+		{
+			*this->sum += x * *this->scale;
+		}
+	};
+
+	auto fed = Federate<void(int), true, true>();
+
+	auto sum = std::make_shared<int>(0);
+	auto tracker = fed.push_back(Scaled{sum, std::unique_ptr<int>(new int(3))});
+
+	for(auto& f : fed.invokeAsync(2))
+	{
+		f.get();
+	}
+
+	fed.invoke(1);
+	EXPECT_EQ(9, *sum);
+
+	Federate<void(int), true, true>::FederateFunction empty;
+	EXPECT_FALSE(static_cast<bool>(empty));
+	EXPECT_THROW(empty(1), std::bad_function_call);
+
+	// A ThreadSafe copy shares tracked functions with the original.
+	auto copy = fed;
+	copy.invoke(1);
+	EXPECT_EQ(12, *sum);
+	tracker.reset();
+	copy.invoke(1);
+	EXPECT_EQ(12, *sum);
+}
+
+TEST(Federate, IntInt_ThreadSafe_Assign)
+{
+	typedef Federate<int(int), false, true> Fed;
+
+	auto a = Fed();
+	auto b = Fed();
+	auto c = Fed();
+
+	a.push_back([](int x)->int
+	{
+		return x + 1;
+	});
+
+	b.push_back([](int x)->int
+	{
+		return x + 2;
+	});
+
+	c.push_back([](int x)->int
+	{
+		return x + 3;
+	});
+
+	auto scoped = b.push_back_scoped([](int x)->int
+	{
+		return x + 4;
+	});
+
+	b.connect(c);
+	b.setErrorPolicy(FederateErrorPolicy::Collect);
+
+	// Copy assignment copies the functions and settings but not the connections, and drops the old functions.
+	a = b;
+	EXPECT_EQ(std::vector<int>({2, 4}), a.invoke(0));
+	EXPECT_TRUE(scoped.connected());
+	EXPECT_EQ(std::vector<int>({2, 4, 3}), b.invoke(0));
+
+	a.push_back([](int)->int
+	{
+		throw std::runtime_error("collected");
+	});
+
+	EXPECT_EQ(2, a.invoke(0).size());
+	EXPECT_EQ(1, a.takeErrors().size());
+
+	// Move assignment takes over the functions, the scoped connection and the connection downstream.
+	a = std::move(b);
+	EXPECT_EQ(std::vector<int>({2, 4, 3}), a.invoke(0));
+	EXPECT_TRUE(scoped.connected());
+	scoped.disconnect();
+	EXPECT_EQ(std::vector<int>({2, 3}), a.invoke(0));
+
+	// Assigning a fresh Federate drops everything, including the connection to "c".
+	a = Fed();
+	EXPECT_TRUE(a.invoke(0).empty());
+	EXPECT_EQ(std::vector<int>({3}), c.invoke(0));
+
+	auto tracked = Federate<int(int), true>();
+	auto tracker = tracked.push_back([](int x)->int
+	{
+		return x * 2;
+	});
+
+	auto other = Federate<int(int), true>();
+	other = tracked;
+	EXPECT_EQ(std::vector<int>({4}), other.invoke(2));
+	tracker.reset();
+	EXPECT_TRUE(other.invoke(2).empty());
+}
+
+TEST(Federate, IntInt_Connect)
+{
+	auto a = Federate<int(int)>();
+	auto b = Federate<int(int)>();
+	auto c = Federate<int(int)>();
+
+	a.push_back([](int x)->int
+	{
+		return x;
+	});
+
+	b.push_back([](int x)->int
+	{
+		return x * 2;
+	});
+
+	c.push_back([](int x)->int
+	{
+		return x * 3;
+	});
+
+	EXPECT_TRUE(a.connect(b));
+	EXPECT_TRUE(b.connect(c));
+
+	// Cycles are refused.
+	EXPECT_FALSE(c.connect(a));
+	EXPECT_FALSE(a.connect(a));
+
+	auto results = a.invoke(1);
+	ASSERT_EQ(3, results.size());
+	EXPECT_EQ(1, results[0]);
+	EXPECT_EQ(2, results[1]);
+	EXPECT_EQ(3, results[2]);
+
+	// Topology changes are picked up on the next invoke.
+	c.push_back([](int x)->int
+	{
+		return x * 4;
+	});
+
+	EXPECT_EQ(4, a.invoke(1).size());
+	EXPECT_EQ(3, b.invoke(1).size());
+
+	EXPECT_TRUE(a.disconnect(b));
+	EXPECT_FALSE(a.disconnect(b));
+	EXPECT_EQ(1, a.invoke(1).size());
+
+	{
+		auto d = Federate<int(int)>();
+		d.push_back([](int x)->int
+		{
+			return x * 5;
+		});
+
+		EXPECT_TRUE(a.connect(d));
+		EXPECT_EQ(2, a.invoke(1).size());
+	}
+
+	// Destroying a downstream Federate disconnects it.
+	EXPECT_EQ(1, a.invoke(1).size());
+}
+
+TEST(Federate, VoidInt_Tracked_ThreadSafe_Connect)
+{
+	auto parent = Federate<void(int), true, true>();
+	auto child = Federate<void(int), true, true>();
+	parent.setErrorPolicy(FederateErrorPolicy::Collect);
+
+	int sum = 0;
+
+	auto a = child.push_back([&sum](int x)
+	{
+		sum += x;
+	});
+
+	auto b = child.push_back([](int)
+	{
+		throw std::runtime_error("slot failed");
+	});
+
+	ASSERT_TRUE(parent.connect(child));
+
+	// The child's functions run under the parent's error policy.
+	parent.invoke(2);
+	EXPECT_EQ(2, sum);
+	EXPECT_EQ(1, parent.takeErrors().size());
+
+	a.reset();
+	parent.invoke(2);
+	EXPECT_EQ(2, sum);
+}
+
+TEST(Federate, VoidInt_ThreadSafe_Connect_DestroyDownstream)
+{
+	auto parent = Federate<void(int), false, true>();
+	auto middle = Federate<void(int), false, true>();
+	ASSERT_TRUE(parent.connect(middle));
+
+	std::atomic<bool> alive(false);
+	std::atomic<int> stale(0);
+	std::atomic<bool> stop(false);
+
+	// Invokes the top of the chain while the bottom is connected and destroyed, two connections below.
+	std::thread invoker([&]
+	{
+		while(stop == false)
+		{
+			parent.invoke(1);
+		}
+	});
+
+	for(int i = 0; i < 2000; ++i)
+	{
+		std::unique_ptr<Federate<void(int), false, true>> leaf(new Federate<void(int), false, true>());
+
+		leaf->push_back([&alive, &stale](int)
+		{
+			if(alive == false)
+			{
+				++stale;
+			}
+		});
+
+		alive = true;
+		ASSERT_TRUE(middle.connect(*leaf));
+
+		// Once destroyed, nothing upstream reaches the leaf.
+		leaf.reset();
+		alive = false;
+	}
+
+	stop = true;
+	invoker.join();
+	EXPECT_EQ(0, stale);
+}
+
+TEST(Federate, VoidInt_ThreadSafe_Connect_FromSlot)
+{
+	auto parent = Federate<void(int), false, true>();
+	auto child = Federate<void(int), false, true>();
+	auto other = Federate<void(int), false, true>();
+	ASSERT_TRUE(parent.connect(child));
+
+	std::atomic<int> childCalls(0);
+
+	child.push_back([&childCalls](int)
+	{
+		++childCalls;
+	});
+
+	// Reconnecting from inside the parent's own invocation takes no Federate lock, so it cannot deadlock.
+	parent.push_back([&parent, &child](int)
+	{
+		EXPECT_TRUE(parent.disconnect(child));
+		EXPECT_TRUE(parent.connect(child));
+	});
+
+	parent.invoke(1);
+	EXPECT_EQ(1, childCalls);
+
+	std::atomic<bool> stop(false);
+
+	// Edits overlapping parts of the graph from one thread while both ends are invoked from others.
+	std::thread editor([&]
+	{
+		while(stop == false)
+		{
+			child.connect(other);
+			child.disconnect(other);
+		}
+	});
+
+	std::thread invoker([&]
+	{
+		for(int i = 0; i < 2000; ++i)
+		{
+			child.invoke(1);
+		}
+	});
+
+	for(int i = 0; i < 2000; ++i)
+	{
+		parent.invoke(1);
+	}
+
+	invoker.join();
+	stop = true;
+	editor.join();
+	EXPECT_EQ(4001, childCalls);
+}
+
+TEST(Federate, FloatFloat_Affine)
+{
+	auto fed = FederateAffine<float(float)>();
+	EXPECT_TRUE(fed.empty());
+
+	// Enough slots to cover both the vector loop and its tail.
+	for(int i = 0; i < 10; ++i)
+	{
+		fed.push_back_affine(static_cast<float>(i), 1.0f);
+	}
+
+	fed.push_back_clamp(2.0f, 0.0f, -1.0f, 1.0f);
+	fed.push_back_threshold(0.5f, -1.0f, 1.0f);
+	EXPECT_EQ(12, fed.size());
+
+	auto results = fed.invoke(2.0f);
+	ASSERT_EQ(12, results.size());
+
+	for(int i = 0; i < 10; ++i)
+	{
+		EXPECT_EQ(2.0f * i + 1.0f, results[i]);
+	}
+
+	EXPECT_EQ(1.0f, results[10]);
+	EXPECT_EQ(1.0f, results[11]);
+
+	results = fed.invoke(0.25f);
+	EXPECT_EQ(0.5f, results[10]);
+	EXPECT_EQ(-1.0f, results[11]);
+
+	fed.clear();
+	EXPECT_TRUE(fed.invoke(1.0f).empty());
+}
+
+TEST(Federate, FloatFloat_Affine_Span)
+{
+	auto fed = FederateAffine<float(float)>();
+
+	for(int i = 0; i < 10; ++i)
+	{
+		fed.push_back_affine(static_cast<float>(i), 1.0f);
+	}
+
+	// Only the first "capacity" results are written, the vector loop's groups included.
+	std::array<float, 12> out;
+	out.fill(-7.0f);
+	EXPECT_EQ(10, fed.invokeSpan(out.data(), 9, 2.0f));
+
+	for(int i = 0; i < 9; ++i)
+	{
+		EXPECT_EQ(2.0f * i + 1.0f, out[i]);
+	}
+
+	EXPECT_EQ(-7.0f, out[9]);
+
+	// The vector is reused once it fits.
+	std::vector<float> results;
+	fed.invokeInto(results, 1.0f);
+	ASSERT_EQ(10, results.size());
+	EXPECT_EQ(10.0f, results[9]);
+
+	const auto data = results.data();
+	fed.invokeInto(results, 3.0f);
+	EXPECT_EQ(data, results.data());
+	EXPECT_EQ(28.0f, results[9]);
+}
+
+TEST(Federate, FloatFloat_Affine_NonFinite)
+{
+	auto fed = FederateAffine<float(float)>();
+
+	// Twelve slots: the first eight take the vector loop (when the CPU has AVX2), the last four the scalar tail,
+	// and each kind appears in both.
+	for(int i = 0; i < 3; ++i)
+	{
+		fed.push_back_threshold(0.5f, -1.0f, 1.0f);
+		fed.push_back_clamp(2.0f, 0.0f, -1.0f, 1.0f);
+		fed.push_back_affine(2.0f, 1.0f);
+		fed.push_back_affine(0.0f, 5.0f);
+	}
+
+	const auto infinity = std::numeric_limits<float>::infinity();
+	const auto nan = std::numeric_limits<float>::quiet_NaN();
+
+	const float inputs[] = {infinity, -infinity, nan};
+	const float expected[][4] = {
+		{1.0f, 1.0f, infinity, 5.0f},
+		{-1.0f, -1.0f, -infinity, 5.0f},
+		{-1.0f, nan, nan, nan}};
+
+	for(size_t k = 0; k < 3; ++k)
+	{
+		const auto results = fed.invoke(inputs[k]);
+		ASSERT_EQ(12, results.size());
+
+		for(size_t i = 0; i < results.size(); ++i)
+		{
+			const auto want = expected[k][i % 4];
+
+			if(want != want)
+			{
+				EXPECT_TRUE(results[i] != results[i]) << "input " << inputs[k] << ", slot " << i;
+			}
+			else
+			{
+				EXPECT_EQ(want, results[i]) << "input " << inputs[k] << ", slot " << i;
+			}
+		}
+	}
+}
+
+TEST(Federate, FloatFloat_Affine_NaNSum)
+{
+	auto fed = FederateAffine<float(float)>();
+
+	const auto infinity = std::numeric_limits<float>::infinity();
+
+	// inf - inf is NaN, which passes through the clamp in both the vector loop and the scalar tail.
+	for(int i = 0; i < 6; ++i)
+	{
+		fed.push_back_affine(1.0f, -infinity);
+		fed.push_back_clamp(1.0f, -infinity, -1.0f, 1.0f);
+	}
+
+	const auto results = fed.invoke(infinity);
+	ASSERT_EQ(12, results.size());
+
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		EXPECT_TRUE(results[i] != results[i]) << "slot " << i;
+	}
+
+	// Finite sums still clamp.
+	const auto finite = fed.invoke(3.0f);
+	EXPECT_EQ(-infinity, finite[0]);
+	EXPECT_EQ(-1.0f, finite[1]);
+	EXPECT_EQ(-infinity, finite[10]);
+	EXPECT_EQ(-1.0f, finite[11]);
+}
+
+TEST(Federate, IntInt_Assign)
+{
+	auto fed = Federate<int(int)>();
+
+	fed.push_back([](int x)->int
+	{
+		return -x;
+	});
+
+	std::vector<std::function<int(int)>> wiring;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		wiring.push_back([i](int x)->int
+		{
+			return x + i;
+		});
+	}
+
+	fed.assign(std::begin(wiring), std::end(wiring));
+	auto results = fed.invoke(10);
+	ASSERT_EQ(4, results.size());
+	EXPECT_EQ(10, results[0]);
+	EXPECT_EQ(13, results[3]);
+
+	fed.push_back_range(std::begin(wiring), std::begin(wiring) + 2);
+	EXPECT_EQ(6, fed.size());
+	EXPECT_EQ(11, fed.invoke(10)[5]);
+}
+
+TEST(Federate, VoidInt_Tracked_ThreadSafe_Assign)
+{
+	auto fed = Federate<void(int), true, true>();
+	std::atomic<int> calls(0);
+
+	std::vector<std::function<void(int)>> small(2, [&calls](int)
+	{
+		++calls;
+	});
+
+	std::vector<std::function<void(int)>> large(50, [&calls](int)
+	{
+		++calls;
+	});
+
+	auto trackers = fed.assign(std::begin(small), std::end(small));
+	EXPECT_EQ(2, trackers.size());
+
+	std::atomic<bool> stop(false);
+	std::atomic<bool> torn(false);
+
+	std::thread emitter([&]()
+	{
+		while(stop == false)
+		{
+			calls = 0;
+			fed.invoke(1);
+			const auto n = calls.load();
+
+			if(n != 0 && n != 2 && n != 50)
+			{
+				torn = true;
+			}
+		}
+	});
+
+	for(int i = 0; i < 200; ++i)
+	{
+		trackers = fed.assign(std::begin((i % 2) ? small : large), std::end((i % 2) ? small : large));
+	}
+
+	stop = true;
+	emitter.join();
+
+	// Every invoke saw a complete list.
+	EXPECT_FALSE(torn.load());
+	EXPECT_EQ(2, fed.size());
+}
+
+TEST(Federate, IntInt_Capacity)
+{
+	auto fed = Federate<int(int)>();
+	fed.reserve(64);
+
+	const auto reserved = fed.memoryUsage();
+	EXPECT_GE(reserved.slots, 64 * sizeof(std::shared_ptr<void>));
+	EXPECT_EQ(0, reserved.captures);
+
+	std::array<char, 256> state{};
+
+	fed.push_back([state](int x)->int
+	{
+		return x + state[0];
+	});
+
+	EXPECT_GE(fed.memoryUsage().captures, 256);
+
+	fed.clear();
+	fed.shrink_to_fit();
+	EXPECT_LT(fed.memoryUsage().total(), reserved.total());
+}
+
+TEST(Federate, VoidInt_Tracked_Capacity)
+{
+	auto fed = Federate<void(int), true>();
+
+	auto a = fed.push_back([](int)
+	{
+	});
+
+	auto b = fed.push_back([](int)
+	{
+	});
+
+	const auto before = fed.memoryUsage();
+	EXPECT_GT(before.trackers, 0);
+
+	// An expired slot's block stays allocated until it is cleaned.
+	b.reset();
+	EXPECT_EQ(before.trackers, fed.memoryUsage().trackers);
+
+	fed.clean();
+	fed.shrink_to_fit();
+	EXPECT_LT(fed.memoryUsage().trackers, before.trackers);
+	EXPECT_LT(fed.memoryUsage().slots, before.slots);
+}
+
+TEST(Federate, IntInt_Async_SharedSlot)
+{
+	auto fed = Federate<int(int), false, true>();
+	auto counter = std::make_shared<std::atomic<int>>(0);
+
+	// Safe to call concurrently, as asynchronous invocations require.
+	fed.push_back([counter](int)->int
+	{
+		return ++*counter;
+	});
+
+	// A move-only function is shared the same way.
+	struct Owned
+	{
+		int operator()(int)
+		{
+			return ++*this->count;
+		}
+
+		std::unique_ptr<std::atomic<int>> count;
+	};
+
+	Owned owned{std::unique_ptr<std::atomic<int>>(new std::atomic<int>(0))};
+	auto ownedCounter = owned.count.get();
+	fed.push_back(std::move(owned));
+
+	for(size_t grain = 1; grain <= 4; grain *= 2)
+	{
+		fed.setAsyncGrainSize(grain);
+
+		auto serial = std::thread([&fed]
+		{
+			for(int i = 0; i < 20; ++i)
+			{
+				fed.invoke(i);
+			}
+		});
+
+		for(int pass = 0; pass < 20; ++pass)
+		{
+			for(auto& f : fed.invokeAsync(pass))
+			{
+				EXPECT_LE(1, f.get());
+			}
+		}
+
+		serial.join();
+	}
+
+	// Every call, serial or asynchronous, reached the stored functions rather than copies of them.
+	EXPECT_EQ(3 * 2 * 20, counter->load());
+	EXPECT_EQ(3 * 2 * 20, ownedCounter->load());
+}
+
+TEST(Federate, IntInt_ByValue_Allocations)
+{
+	auto fed = Federate<int(int)>();
+	auto add = [](int x)->int
+	{
+		return x + 1;
+	};
+
+	// The functions are stored by value in one vector, with no block of their own.
+	std::vector<decltype(add)> adds(16, add);
+	size_t before = Allocations;
+	fed.push_back_range(std::begin(adds), std::end(adds));
+	EXPECT_GE(before + 2, size_t(Allocations));
+
+	// Serial invocations call them in place.
+	std::vector<int> results;
+	fed.invokeInto(results, 1);
+	before = Allocations;
+	fed.invokeInto(results, 2);
+	EXPECT_EQ(before, size_t(Allocations));
+	EXPECT_EQ(std::vector<int>(16, 3), results);
+
+	// Sharing a callable with an asynchronous call moves it to the heap once; after that it only counts a reference.
+	int calls = 0;
+
+	FederateMoveOnlyFunction<int(int)> f([calls](int)mutable->int
+	{
+		return ++calls;
+	});
+
+	auto shared = f.share();
+	before = Allocations;
+	auto again = f.share();
+	EXPECT_EQ(before, size_t(Allocations));
+
+	EXPECT_EQ(1, shared(0));
+	EXPECT_EQ(2, f(0));
+	EXPECT_EQ(3, again(0));
+
+	// Copying the wrapper still copies the callable.
+	auto copy = f;
+	EXPECT_EQ(4, copy(0));
+	EXPECT_EQ(4, f(0));
+}
+
+TEST(Federate, IntInt_AsyncGrain)
+{
+	auto fed = Federate<int(int)>();
+
+	for(int i = 0; i < 100; ++i)
+	{
+		fed.push_back([i](int x)->int
+		{
+			return x + i;
+		});
+	}
+
+	fed.push_back([](int)->int
+	{
+		throw std::runtime_error("slot failed");
+	});
+
+	fed.setAsyncGrainSize(16);
+
+	for(int pass = 0; pass < 2; ++pass)
+	{
+		auto futures = fed.invokeAsync(1);
+		ASSERT_EQ(101, futures.size());
+
+		for(int i = 0; i < 100; ++i)
+		{
+			EXPECT_EQ(1 + i, futures[i].get());
+		}
+
+		// Each function keeps its own future and exception.
+		EXPECT_THROW(futures[100].get(), std::runtime_error);
+
+		fed.setAsyncGrainSize(0);
+	}
+}
+
+TEST(Federate, VoidVoid_Tracked_ThreadSafe_AsyncGrain_Adaptive)
+{
+	auto fed = Federate<void(void), true, true>();
+	fed.setAsyncGrainSize(0);
+
+	std::atomic<int> calls(0);
+	std::vector<Federate<void(void), true, true>::Tracker> trackers;
+
+	for(int i = 0; i < 64; ++i)
+	{
+		trackers.push_back(fed.push_back([&calls]()
+		{
+			++calls;
+		}));
+	}
+
+	for(int pass = 0; pass < 10; ++pass)
+	{
+		for(auto& f : fed.invokeAsync())
+		{
+			f.get();
+		}
+	}
+
+	EXPECT_EQ(640, calls.load());
+}
+
+TEST(Federate, IntInt_AsyncGrain_DropFutures_DestroyFederate)
+{
+	auto done = std::make_shared<std::atomic<int>>(0);
+	std::mutex gate;
+	std::unique_lock<std::mutex> hold(gate);
+
+	{
+		auto fed = Federate<int(int)>();
+		fed.setAsyncGrainSize(2);
+
+		for(int i = 0; i < 5; ++i)
+		{
+			// State on the heap, so a call through a destroyed slot is caught by AddressSanitizer.
+			std::vector<int> offsets(64, i);
+
+			fed.push_back([offsets, done, &gate](int x)->int
+			{
+				std::lock_guard<std::mutex> wait(gate);
+				++*done;
+				return x + offsets[63];
+			});
+		}
+
+		// The tasks cannot start their calls until the futures and the functions are gone.
+		fed.invokeAsync(1);
+		fed.clear();
+		EXPECT_EQ(0, done->load());
+
+		hold.unlock();
+	}
+
+	// Destroying the Federate waited for its tasks, so none is left running.
+	EXPECT_EQ(5, done->load());
+}
+
+TEST(Federate, IntInt_ThreadSafe_Async_MoveAssign)
+{
+	std::mutex gate;
+	std::unique_lock<std::mutex> hold(gate);
+	std::atomic<size_t> seen(0);
+
+	auto fed = Federate<int(int), false, true>();
+	fed.setAsyncGrainSize(2);
+
+	// The task needs the Federate's lock to finish, so the assignment must not wait for it while holding the lock.
+	fed.push_back([&fed, &gate, &seen](int x)->int
+	{
+		std::lock_guard<std::mutex> wait(gate);
+		seen = fed.size() + 1;
+		return x;
+	});
+
+	fed.invokeAsync(1);
+
+	std::thread assign([&fed]()
+	{
+		auto other = Federate<int(int), false, true>();
+		other.push_back([](int x)->int { return x; });
+		other.push_back([](int x)->int { return x; });
+		fed = std::move(other);
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	hold.unlock();
+	assign.join();
+
+	// The assignment waited for the old task, which saw the Federate before or after it.
+	EXPECT_NE(0, seen.load());
+	EXPECT_EQ(2, fed.size());
+}
+
+TEST(Federate, IntInt_Tracked_ThreadSafe_Async_DestroyReclaimer)
+{
+	for(size_t grain = 1; grain <= 2; ++grain)
+	{
+		std::unique_ptr<FederateReclaimer> reclaimer(new FederateReclaimer());
+		std::mutex gate;
+		std::unique_lock<std::mutex> hold(gate);
+
+		auto fed = Federate<int(int), true, true>();
+		fed.setReclaimer(reclaimer.get());
+		fed.setAsyncGrainSize(grain);
+
+		std::vector<Federate<int(int), true, true>::Tracker> trackers;
+
+		for(int i = 0; i < 5; ++i)
+		{
+			trackers.push_back(fed.push_back([i, &gate](int x)->int
+			{
+				std::lock_guard<std::mutex> wait(gate);
+				return x + i;
+			}));
+		}
+
+		auto futures = fed.invokeAsync(1);
+
+		// Leave the tasks holding the only references to the functions.
+		trackers.clear();
+		EXPECT_EQ(0, reclaimer->retiredSize());
+
+		hold.unlock();
+
+		int sum = 0;
+
+		for(auto& f : futures)
+		{
+			sum += f.get();
+		}
+
+		EXPECT_EQ(15, sum);
+
+		// Every function was retired before its result was ready, so the reclaimer can go at once.
+		EXPECT_EQ(5, reclaimer->retiredSize());
+		reclaimer.reset();
+	}
+}
+
+TEST(Federate, IntInt_Scoped)
+{
+	auto fed = Federate<int(int)>();
+
+	auto a = fed.push_back_scoped([](int x)->int
+	{
+		return x;
+	});
+
+	{
+		auto b = fed.push_back_scoped([](int x)->int
+		{
+			return x * 2;
+		});
+
+		fed.push_back([](int x)->int
+		{
+			return x * 3;
+		});
+
+		EXPECT_EQ(3, fed.invoke(1).size());
+	}
+
+	// Removed at once, leaving nothing to clean.
+	auto results = fed.invoke(1);
+	ASSERT_EQ(2, results.size());
+	EXPECT_EQ(1, results[0]);
+	EXPECT_EQ(3, results[1]);
+
+	// Moving keeps the connection; positions follow earlier removals.
+	auto c = fed.push_back_scoped([](int x)->int
+	{
+		return x * 4;
+	});
+
+	auto moved = std::move(c);
+	EXPECT_FALSE(c.connected());
+	a.disconnect();
+	EXPECT_FALSE(a.connected());
+	EXPECT_EQ(2, fed.size());
+	moved.disconnect();
+	EXPECT_EQ(1, fed.size());
+	EXPECT_EQ(3, fed.invoke(1)[0]);
+
+	auto d = fed.push_back_scoped([](int x)->int
+	{
+		return x;
+	});
+
+	fed.clear();
+	EXPECT_FALSE(d.connected());
+}
+
+TEST(Federate, IntInt_Scoped_NoAllocation)
+{
+	auto fed = Federate<int(int)>();
+	std::vector<FederateScopedConnection> connections;
+	connections.reserve(8);
+
+	connections.push_back(fed.push_back_scoped([](int x)->int
+	{
+		return x;
+	}));
+
+	// Once the vectors have room, a scoped connection is stored like any other function: nothing is allocated for it.
+	fed.reserve(8);
+	const size_t before = Allocations;
+
+	for(int i = 1; i < 8; ++i)
+	{
+		connections.push_back(fed.push_back_scoped([i](int x)->int
+		{
+			return x * i;
+		}));
+	}
+
+	connections.erase(std::begin(connections));
+	connections[3].disconnect();
+	EXPECT_EQ(before, size_t(Allocations));
+
+	EXPECT_EQ(6, fed.size());
+	EXPECT_EQ(std::vector<int>({1, 2, 3, 5, 6, 7}), fed.invoke(1));
+}
+
+TEST(Federate, IntInt_Scoped_MassDisconnect)
+{
+	auto fed = Federate<int(int)>();
+	std::vector<FederateScopedConnection> connections;
+
+	for(int i = 0; i < 50000; ++i)
+	{
+		connections.push_back(fed.push_back_scoped([i](int)->int
+		{
+			return i;
+		}));
+	}
+
+	// Disconnected slots are compacted in passes, so destroying the connections from the front is linear.
+	connections.erase(std::begin(connections), std::begin(connections) + 49990);
+	EXPECT_EQ(10, fed.size());
+	EXPECT_EQ(std::vector<int>({49990, 49991, 49992, 49993, 49994, 49995, 49996, 49997, 49998, 49999}), fed.invoke(0));
+
+	// The positions of slots left uncompacted still follow the disconnections.
+	connections[2].disconnect();
+	connections[5].disconnect();
+	EXPECT_EQ(8, fed.size());
+	EXPECT_EQ(std::vector<int>({49990, 49991, 49993, 49994, 49996, 49997, 49998, 49999}), fed.invoke(0));
+	connections[9].disconnect();
+	connections[9] = fed.push_back_scoped([](int x)->int
+	{
+		return x;
+	});
+
+	fed.push_back([](int)->int
+	{
+		throw std::runtime_error("slot failed");
+	});
+
+	auto checked = fed.invokeChecked(7);
+	EXPECT_EQ(std::vector<int>({49990, 49991, 49993, 49994, 49996, 49997, 49998, 7}), checked.results);
+	ASSERT_EQ(1, checked.errors.size());
+	EXPECT_EQ(8, checked.errors[0].slot);
+
+	connections.clear();
+	EXPECT_EQ(1, fed.size());
+	EXPECT_FALSE(fed.empty());
+}
+
+TEST(Federate, VoidInt_ThreadSafe_Scoped)
+{
+	std::vector<FederateScopedConnection> connections;
+	FederateScopedConnection survivor;
+	int calls = 0;
+
+	{
+		auto fed = Federate<void(int), false, true>();
+		survivor = fed.push_back_scoped([](int)
+		{
+		});
+
+		for(int i = 0; i < 8; ++i)
+		{
+			connections.push_back(fed.push_back_scoped([&calls](int)
+			{
+				++calls;
+			}));
+		}
+
+		connections.erase(std::begin(connections) + 2, std::begin(connections) + 5);
+		fed.invoke(0);
+		EXPECT_EQ(5, calls);
+
+		connections[4].release();
+		connections.clear();
+		fed.invoke(0);
+		EXPECT_EQ(6, calls);
+		EXPECT_TRUE(survivor.connected());
+	}
+
+	// A connection outliving its Federate is already disconnected.
+	EXPECT_FALSE(survivor.connected());
+}
+
+#if defined(__linux__)
+TEST(Federate, VoidIntDouble_SharedMemory)
+{
+	const auto name = "/federate_test_" + std::to_string(::getpid());
+
+	FederateSharedMemory<void(int, double)> publisher(name, 4);
+	FederateSharedMemory<void(int, double)> subscriber(name, 4);
+	FederateSharedMemory<void(int, double)>::unlink(name);
+
+	EXPECT_EQ(4, subscriber.capacity());
+
+	std::vector<std::pair<int, double>> seen;
+
+	subscriber.push_back([&seen](int x, double y)
+	{
+		seen.push_back(std::make_pair(x, y));
+	});
+
+	publisher.publish(1, 0.5);
+	publisher.publish(2, 1.5);
+	EXPECT_EQ(2, subscriber.poll());
+	ASSERT_EQ(2, seen.size());
+	EXPECT_EQ(2, seen[1].first);
+	EXPECT_EQ(1.5, seen[1].second);
+
+	// A subscriber a full ring behind loses the oldest records.
+	for(int i = 0; i < 6; ++i)
+	{
+		publisher.publish(i, 0.0);
+	}
+
+	EXPECT_EQ(4, subscriber.poll());
+	EXPECT_EQ(2, subscriber.lost());
+	EXPECT_EQ(5, seen.back().first);
+}
+
+TEST(Federate, VoidInt_ThreadSafe_SharedMemory_Wait)
+{
+	const auto name = "/federate_test_wait_" + std::to_string(::getpid());
+
+	FederateSharedMemory<void(int), true> subscriber(name, 64);
+	int last = 0;
+
+	subscriber.push_back([&last](int x)
+	{
+		last = x;
+	});
+
+	EXPECT_EQ(0, subscriber.wait(std::chrono::milliseconds(1)));
+
+	std::thread publisherThread([&name]()
+	{
+		FederateSharedMemory<void(int), true> publisher(name, 64);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		publisher.publish(42);
+	});
+
+	size_t delivered = 0;
+
+	while(delivered == 0)
+	{
+		delivered = subscriber.wait(std::chrono::seconds(5));
+	}
+
+	publisherThread.join();
+	FederateSharedMemory<void(int), true>::unlink(name);
+
+	EXPECT_EQ(1, delivered);
+	EXPECT_EQ(42, last);
+}
+
+TEST(Federate, VoidInt_SharedMemory_DeadWaiter)
+{
+	// Registers a process as waiting, as a subscriber which died in "wait" would have left it.
+	struct Registering : public FederateSharedMemory<void(int)>
+	{
+		Registering(const std::string& name) : FederateSharedMemory<void(int)>(name, 4)
+		{
+		}
+
+		void registerDead(pid_t process)
+		{
+			this->header->waiterProcesses[0].store(static_cast<uint32_t>(process));
+			++this->header->waiters;
+		}
+
+		uint32_t waiters() const
+		{
+			return this->header->waiters.load();
+		}
+	};
+
+	const auto name = "/federate_test_dead_waiter_" + std::to_string(::getpid());
+
+	Registering publisher(name);
+	FederateSharedMemory<void(int)>::unlink(name);
+
+	// A process which has exited and been reaped no longer exists.
+	const auto child = ::fork();
+	ASSERT_LE(0, child);
+
+	if(child == 0)
+	{
+		::_exit(0);
+	}
+
+	ASSERT_EQ(child, ::waitpid(child, nullptr, 0));
+
+	publisher.registerDead(child);
+	EXPECT_EQ(1, publisher.waiters());
+
+	// The publish wakes nobody, so it drops the registration, and later publishes make no system call.
+	publisher.publish(1);
+	EXPECT_EQ(0, publisher.waiters());
+}
+
+TEST(Federate, VoidInt_SharedMemory_Validation)
+{
+	// Writes the header as a truncated or hostile segment could.
+	struct Corrupting : public FederateSharedMemory<void(int)>
+	{
+		Corrupting(const std::string& name) : FederateSharedMemory<void(int)>(name, 4)
+		{
+		}
+
+		void claimCapacity(uint64_t capacity)
+		{
+			this->header->capacity = capacity;
+		}
+	};
+
+	const auto name = "/federate_test_validation_" + std::to_string(::getpid());
+
+	EXPECT_THROW(FederateSharedMemory<void(int)>(name, std::numeric_limits<size_t>::max()), std::system_error);
+
+	Corrupting creator(name);
+
+	// Only the creating user may open the ring.
+	struct stat info;
+	ASSERT_EQ(0, ::stat(("/dev/shm" + name).c_str(), &info));
+	EXPECT_EQ(0, info.st_mode & 077);
+
+	// More records than the mapping holds, or a count that is not a power of two, is refused.
+	creator.claimCapacity(uint64_t(1) << 20);
+	EXPECT_THROW(FederateSharedMemory<void(int)>(name, 4), std::system_error);
+
+	creator.claimCapacity(3);
+	EXPECT_THROW(FederateSharedMemory<void(int)>(name, 4), std::system_error);
+
+	creator.claimCapacity(0);
+	EXPECT_THROW(FederateSharedMemory<void(int)>(name, 4), std::system_error);
+
+	creator.claimCapacity(4);
+	FederateSharedMemory<void(int)> subscriber(name, 4);
+	FederateSharedMemory<void(int)>::unlink(name);
+
+	// The creator keeps the capacity it checked, whatever the header says later.
+	creator.claimCapacity(uint64_t(1) << 20);
+	EXPECT_EQ(4, creator.capacity());
+}
+
+TEST(Federate, VoidInt_SharedMemory_LappingPublishers)
+{
+	// Publishes in steps, as a publisher preempted between taking its ticket and writing its record would.
+	struct Stepping : public FederateSharedMemory<void(int)>
+	{
+		Stepping(const std::string& name) : FederateSharedMemory<void(int)>(name, 1)
+		{
+		}
+
+		uint64_t take()
+		{
+			return this->header->head.fetch_add(1);
+		}
+
+		bool claimFor(uint64_t ticket)
+		{
+			return Stepping::claim(*reinterpret_cast<std::atomic<uint64_t>*>(this->recordAt(ticket)), ticket + 1);
+		}
+	};
+
+	const auto name = "/federate_test_lapping_" + std::to_string(::getpid());
+
+	// With one record, every ticket is a full lap from the previous one.
+	Stepping publisher(name);
+	FederateSharedMemory<void(int)> subscriber(name, 1);
+	FederateSharedMemory<void(int)>::unlink(name);
+
+	std::vector<int> seen;
+
+	subscriber.push_back([&seen](int x)
+	{
+		seen.push_back(x);
+	});
+
+	// A later lap got the record first, so the earlier one must not write over it.
+	const auto slow = publisher.take();
+	publisher.publish(5);
+	EXPECT_FALSE(publisher.claimFor(slow));
+
+	EXPECT_EQ(1, subscriber.poll());
+	EXPECT_EQ(1, subscriber.lost());
+	ASSERT_EQ(1, seen.size());
+	EXPECT_EQ(5, seen[0]);
+
+	// An earlier lap is mid-copy, so the later one waits for it, giving up on it only after the stall timeout.
+	EXPECT_TRUE(publisher.claimFor(publisher.take()));
+
+	const auto start = std::chrono::steady_clock::now();
+	publisher.publish(6);
+	EXPECT_LE(FederateSharedMemory<void(int)>::StallTimeout(), std::chrono::steady_clock::now() - start);
+
+	EXPECT_EQ(1, subscriber.poll());
+	EXPECT_EQ(2, subscriber.lost());
+	EXPECT_EQ(6, seen.back());
+}
+
+TEST(Federate, VoidInt_SharedMemory_DeadPublisher)
+{
+	// Takes a ticket and claims its record but never finishes writing it, as a publisher killed mid-publish would.
+	struct Abandoning : public FederateSharedMemory<void(int)>
+	{
+		Abandoning(const std::string& name) : FederateSharedMemory<void(int)>(name, 4)
+		{
+		}
+
+		void abandon()
+		{
+			const auto ticket = this->header->head.fetch_add(1);
+			Abandoning::claim(*reinterpret_cast<std::atomic<uint64_t>*>(this->recordAt(ticket)), ticket + 1);
+		}
+	};
+
+	const auto name = "/federate_test_dead_" + std::to_string(::getpid());
+
+	Abandoning publisher(name);
+	FederateSharedMemory<void(int)> subscriber(name, 4);
+	FederateSharedMemory<void(int)>::unlink(name);
+
+	std::vector<int> seen;
+
+	subscriber.push_back([&seen](int x)
+	{
+		seen.push_back(x);
+	});
+
+	publisher.abandon();
+	publisher.publish(7);
+
+	EXPECT_EQ(1, subscriber.poll());
+	EXPECT_EQ(1, subscriber.lost());
+	ASSERT_EQ(1, seen.size());
+	EXPECT_EQ(7, seen[0]);
+
+	// The next lap takes the abandoned record over.
+	for(int i = 0; i < 3; ++i)
+	{
+		publisher.publish(i);
+	}
+
+	publisher.publish(8);
+	EXPECT_EQ(4, subscriber.poll());
+	EXPECT_EQ(8, seen.back());
+	EXPECT_EQ(1, subscriber.lost());
+}
+
+TEST(Federate, VoidInt_SharedMemory_StalledPublisher)
+{
+	// Claims its record, then is held up past StallTimeout before writing it, as a preempted publisher would be.
+	struct Stalling : public FederateSharedMemory<void(int)>
+	{
+		Stalling(const std::string& name) : FederateSharedMemory<void(int)>(name, 4)
+		{
+		}
+
+		uint64_t stall()
+		{
+			const auto ticket = this->header->head.fetch_add(1);
+			Stalling::claim(*reinterpret_cast<std::atomic<uint64_t>*>(this->recordAt(ticket)), ticket + 1);
+			return ticket;
+		}
+
+		void resume(uint64_t ticket, int x)
+		{
+			auto record = this->recordAt(ticket);
+			Packed::write(record + PayloadOffset, x);
+			Stalling::sealOf(record).store(Stalling::seal(ticket + 1, Packed::checksum(x)));
+		}
+
+		void tear(uint64_t ticket, int x)
+		{
+			Packed::write(this->recordAt(ticket) + PayloadOffset, x);
+		}
+	};
+
+	const auto name = "/federate_test_stalled_" + std::to_string(::getpid());
+
+	Stalling publisher(name);
+	FederateSharedMemory<void(int)> subscriber(name, 4);
+	FederateSharedMemory<void(int)>::unlink(name);
+
+	std::vector<int> seen;
+
+	subscriber.push_back([&seen](int x)
+	{
+		seen.push_back(x);
+	});
+
+	// The next lap takes the stalled record over, then the stalled publisher finishes its copy over it.
+	const auto stalled = publisher.stall();
+
+	for(int i = 1; i < 5; ++i)
+	{
+		publisher.publish(i);
+	}
+
+	publisher.resume(stalled, 99);
+
+	// Neither the stalled record nor the one it wrote over is delivered.
+	EXPECT_EQ(3, subscriber.poll());
+	EXPECT_EQ(2, subscriber.lost());
+	EXPECT_EQ((std::vector<int>{1, 2, 3}), seen);
+
+	// Arguments torn without touching the seal fail its checksum.
+	publisher.publish(5);
+	publisher.tear(5, 55);
+	publisher.publish(6);
+
+	EXPECT_EQ(1, subscriber.poll());
+	EXPECT_EQ(3, subscriber.lost());
+	EXPECT_EQ(6, seen.back());
+}
+
+TEST(Federate, SharedMemory_SignatureMismatch)
+{
+	const auto name = "/federate_test_mismatch_" + std::to_string(::getpid());
+
+	FederateSharedMemory<void(int)> ints(name, 4);
+
+	// Same size, different layout.
+	EXPECT_THROW((FederateSharedMemory<void(float)>(name, 4)), std::system_error);
+	EXPECT_NO_THROW((FederateSharedMemory<void(int)>(name, 4)));
+
+	FederateSharedMemory<void(int)>::unlink(name);
+
+	// Sized by something else, which never finishes: opening gives up rather than waiting forever.
+	const auto fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+	ASSERT_LE(0, fd);
+	EXPECT_EQ(0, ::ftruncate(fd, 8));
+	::close(fd);
+
+	EXPECT_THROW((FederateSharedMemory<void(int)>(name, 4)), std::system_error);
+	FederateSharedMemory<void(int)>::unlink(name);
+}
+#endif
+
+TEST(Federate, BoolInt_Buffered)
+{
+	auto federate = Federate<bool(int)>();
+
+	for(int i = 0; i < 3; ++i)
+	{
+		federate.push_back([i](int x)
+		{
+			return x > i;
+		});
+	}
+
+	auto results = federate.invokeBuffered(1);
+	static_assert(std::is_same<decltype(results), FederateSmallBuffer<bool, 64>>::value, "bool results are held as bytes, inline.");
+
+	ASSERT_EQ(3, results.size());
+	EXPECT_TRUE(results.inlined());
+	EXPECT_TRUE(results[0]);
+	EXPECT_FALSE(results[1]);
+	EXPECT_FALSE(results.data()[2]);
+
+	// Past the inline capacity, the results move to the heap in order.
+	for(int i = 3; i < 100; ++i)
+	{
+		federate.push_back([i](int x)
+		{
+			return x > i;
+		});
+	}
+
+	results = federate.invokeBuffered(50);
+	ASSERT_EQ(100, results.size());
+	EXPECT_FALSE(results.inlined());
+	EXPECT_EQ(50, std::count(std::begin(results), std::end(results), true));
+
+	auto strings = Federate<std::string(int)>();
+	static_assert(std::is_same<decltype(strings.invokeBuffered(0)), std::vector<std::string>>::value, "Other results use a vector.");
+}
+
+TEST(Federate, IntVoid_Tracked_ThreadSafe_Span)
+{
+	auto federate = Federate<int(void), true, true>();
+	auto a = federate.push_back([]{ return 1; });
+	auto b = federate.push_back([]{ return 2; });
+	auto c = federate.push_back([]{ return 3; });
+
+	std::array<int, 3> out = {{0, 0, 0}};
+	EXPECT_EQ(3, federate.invokeSpan(out.data(), out.size()));
+	EXPECT_EQ(1, out[0]);
+	EXPECT_EQ(3, out[2]);
+
+	// Too little room: every function runs, only the first results are kept.
+	out.fill(0);
+	EXPECT_EQ(3, federate.invokeSpan(out.data(), 2));
+	EXPECT_EQ(2, out[1]);
+	EXPECT_EQ(0, out[2]);
+
+	b.reset();
+	EXPECT_EQ(2, federate.invokeSpan(out.data(), out.size()));
+	EXPECT_EQ(3, out[1]);
+}
+
+TEST(Federate, IntInt_Into_Scratch)
+{
+	auto federate = Federate<int(int)>();
+	auto inner = Federate<int(int)>();
+
+	inner.push_back([](int x)
+	{
+		return x * 10;
+	});
+
+	federate.push_back([](int x)
+	{
+		return x + 1;
+	});
+
+	// A function which itself uses invokeScratch must not disturb its caller's results.
+	federate.push_back([&inner](int x)
+	{
+		return inner.invokeScratch(x).front();
+	});
+
+	std::vector<int> results;
+	federate.invokeInto(results, 1);
+	ASSERT_EQ(2, results.size());
+	EXPECT_EQ(2, results[0]);
+	EXPECT_EQ(10, results[1]);
+
+	const auto data = results.data();
+	federate.invokeInto(results, 2);
+	EXPECT_EQ(data, results.data());
+	EXPECT_EQ(20, results[1]);
+
+	const auto& scratch = federate.invokeScratch(3);
+	const auto scratchData = scratch.data();
+	ASSERT_EQ(2, scratch.size());
+	EXPECT_EQ(4, scratch[0]);
+	EXPECT_EQ(30, scratch[1]);
+
+	const auto& again = federate.invokeScratch(4);
+	EXPECT_EQ(&scratch, &again);
+	EXPECT_EQ(scratchData, again.data());
+	EXPECT_EQ(40, again[1]);
+}
+
+TEST(Federate, VoidInt_Tracked_ThreadSafe_AsyncInto)
+{
+	auto federate = Federate<void(int), true, true>();
+	std::atomic<int> sum(0);
+
+	auto a = federate.push_back([&sum](int x)
+	{
+		sum += x;
+	});
+
+	auto b = federate.push_back([&sum](int x)
+	{
+		sum += x * 2;
+	});
+
+	std::vector<std::future<void>> futures;
+
+	for(int i = 1; i <= 3; ++i)
+	{
+		federate.invokeAsyncInto(futures, i);
+		ASSERT_EQ(2, futures.size());
+
+		for(auto& f : futures)
+		{
+			f.get();
+		}
+	}
+
+	EXPECT_EQ(18, sum.load());
+}
+
+TEST(Federate, ThreadIdVoid_Executor_Nodes)
+{
+	// Two groups of one unpinned worker each.
+	auto pool = std::make_shared<FederateThreadPool>(std::vector<std::vector<int>>(2));
+	EXPECT_EQ(2, pool->nodes());
+	EXPECT_EQ(2, pool->workers());
+
+	auto federate = Federate<std::thread::id(void)>();
+	federate.setExecutor(pool);
+
+	auto where = []
+	{
+		return std::this_thread::get_id();
+	};
+
+	federate.push_back_on_node(where, 0);
+	federate.push_back_on_node(where, 1);
+	federate.push_back_on_node(where, 0);
+	federate.push_back(where);
+
+	auto futures = federate.invokeAsync();
+	ASSERT_EQ(4, futures.size());
+
+	std::vector<std::thread::id> ids;
+
+	for(auto& f : futures)
+	{
+		ids.push_back(f.get());
+	}
+
+	EXPECT_NE(ids[0], ids[1]);
+	EXPECT_EQ(ids[0], ids[2]);
+	EXPECT_NE(std::this_thread::get_id(), ids[3]);
+
+	// Serial invocations are unaffected.
+	EXPECT_EQ(std::this_thread::get_id(), federate.invoke()[1]);
+
+	EXPECT_EQ(std::vector<int>({0, 2, 3, 10}), FederateThreadPool::parseCpuList("0,2-3,10"));
+}
+
+TEST(Federate, ThreadIdVoid_Executor_SparseNodes)
+{
+	EXPECT_EQ(std::vector<int>({0, 2}), FederateThreadPool::parseCpuList("0,2"));
+	EXPECT_EQ(std::vector<int>({1, 4, 5}), FederateThreadPool::parseCpuList("1,4-5\n"));
+	EXPECT_EQ(std::vector<int>(), FederateThreadPool::parseCpuList(""));
+
+	struct Pool : public FederateThreadPool
+	{
+		explicit Pool(const std::vector<FederateThreadPool::Node>& nodes) : FederateThreadPool(nodes)
+		{
+		}
+
+		using FederateThreadPool::groupFor;
+	};
+
+	// Nodes "0,2", as "online" lists them on a machine without node 1, each with one unpinned worker.
+	std::vector<FederateThreadPool::Node> nodes;
+
+	for(auto id : FederateThreadPool::parseCpuList("0,2"))
+	{
+		FederateThreadPool::Node node = {id, std::vector<int>()};
+		nodes.push_back(node);
+	}
+
+	auto pool = std::make_shared<Pool>(nodes);
+	EXPECT_EQ(2, pool->nodes());
+	EXPECT_EQ(std::vector<int>({0, 2}), pool->nodeIds());
+	EXPECT_EQ(0, pool->groupFor(0));
+	EXPECT_EQ(1, pool->groupFor(2));
+	EXPECT_EQ(2, pool->groupFor(1));
+	EXPECT_EQ(2, pool->groupFor(-1));
+
+	auto federate = Federate<std::thread::id(void)>();
+	federate.setExecutor(pool);
+
+	auto where = []
+	{
+		return std::this_thread::get_id();
+	};
+
+	federate.push_back_on_node(where, 2);
+	federate.push_back_on_node(where, 0);
+	federate.push_back_on_node(where, 2);
+
+	auto futures = federate.invokeAsync();
+	ASSERT_EQ(3, futures.size());
+
+	std::vector<std::thread::id> ids;
+
+	for(auto& f : futures)
+	{
+		ids.push_back(f.get());
+	}
+
+	EXPECT_NE(ids[0], ids[1]);
+	EXPECT_EQ(ids[0], ids[2]);
+}
+
+TEST(Federate, IntInt_Executor_Batched)
+{
+	// Runs tasks inline and notes the node of each.
+	struct Inline : public FederateExecutor
+	{
+		virtual void execute(FederateMoveOnlyFunction<void()> task, int node) override
+		{
+			this->nodes.push_back(node);
+			task();
+		}
+
+		std::vector<int> nodes;
+	};
+
+	auto executor = std::make_shared<Inline>();
+	auto federate = Federate<int(int)>();
+	federate.setExecutor(executor);
+	federate.setAsyncGrainSize(3);
+
+	const int nodes[] = {0, 1, 0, 0, 1, 0, -1};
+
+	for(int i = 0; i < 7; ++i)
+	{
+		federate.push_back_on_node([i](int x)
+		{
+			return x + i;
+		}, nodes[i]);
+	}
+
+	auto futures = federate.invokeAsync(10);
+	ASSERT_EQ(7, futures.size());
+
+	for(int i = 0; i < 7; ++i)
+	{
+		EXPECT_EQ(10 + i, futures[i].get());
+	}
+
+	// Batches never mix nodes: one for -1, two for node 0's four functions, one for node 1.
+	EXPECT_EQ(std::vector<int>({-1, 0, 0, 1}), executor->nodes);
+}
+
+TEST(Federate, IntInt_Tracked_ThreadSafe_Executor)
+{
+	auto pool = std::make_shared<FederateThreadPool>();
+	EXPECT_GE(pool->nodes(), 1);
+	EXPECT_GE(pool->workers(), pool->nodes());
+
+	auto federate = Federate<int(int), true, true>();
+	federate.setExecutor(pool);
+
+	auto a = federate.push_back_on_node([](int x)
+	{
+		return x + 1;
+	}, 0);
+
+	auto b = federate.push_back([](int x)->int
+	{
+		throw std::runtime_error("thrown on a worker " + std::to_string(x));
+	});
+
+	auto futures = federate.invokeAsync(41);
+	ASSERT_EQ(2, futures.size());
+	EXPECT_EQ(42, futures[0].get());
+	EXPECT_THROW(futures[1].get(), std::runtime_error);
+
+	federate.setExecutor(nullptr);
+	futures = federate.invokeAsync(1);
+	ASSERT_EQ(2, futures.size());
+	EXPECT_EQ(2, futures[0].get());
+	EXPECT_THROW(futures[1].get(), std::runtime_error);
+}
+
+TEST(Federate, ThreadIdVoid_Executor_TaskErrors)
+{
+	FederateThreadPool pool(std::vector<std::vector<int>>(1));
+
+	std::promise<std::exception_ptr> caught;
+	pool.setErrorHandler([&caught](std::exception_ptr x)
+	{
+		caught.set_value(x);
+	});
+
+	// A task given to the pool directly has no future to carry its exception: the handler gets it.
+	pool.execute([]
+	{
+		throw std::runtime_error("raw task");
+	}, 0);
+
+	EXPECT_THROW(std::rethrow_exception(caught.get_future().get()), std::runtime_error);
+
+	// The worker carries on.
+	std::promise<void> ran;
+	pool.execute([&ran]
+	{
+		ran.set_value();
+	}, 0);
+
+	ran.get_future().get();
+}
+
+TEST(Federate, IntInt_First_HotReordering)
+{
+	auto federate = Federate<int(int)>();
+	std::array<int, 4> calls = {{0, 0, 0, 0}};
+
+	// Each function accepts one value (or anything, for the pinned catch-all) by returning its id.
+	for(int id = 1; id <= 3; ++id)
+	{
+		federate.push_back([id, &calls](int x)
+		{
+			++calls[id - 1];
+			return (x == id * 10) ? id : 0;
+		});
+	}
+
+	federate.push_back_pinned([&calls](int)
+	{
+		++calls[3];
+		return 4;
+	});
+
+	EXPECT_EQ(2, federate.invokeFirst(20));
+	EXPECT_EQ(4, federate.invokeFirst(0));
+	EXPECT_EQ(2, calls[1]);
+	EXPECT_EQ(1, calls[2]);
+
+	federate.setHotReordering(8);
+
+	for(int i = 0; i < 16; ++i)
+	{
+		EXPECT_EQ(3, federate.invokeFirst(30));
+	}
+
+	// The hot function now runs first, and the catch-all is still last.
+	calls.fill(0);
+	EXPECT_EQ(3, federate.invokeFirst(30));
+	EXPECT_EQ(0, calls[0]);
+	EXPECT_EQ(1, calls[2]);
+
+	EXPECT_EQ(4, federate.invokeFirst(5));
+	EXPECT_EQ(std::vector<int>({0, 0, 0, 4}), federate.invoke(-1));
+	EXPECT_EQ(3, federate.invoke(30)[0]);
+}
+
+TEST(Federate, IntInt_First_HotReordering_PushRange)
+{
+	auto federate = Federate<int(int)>();
+	federate.setHotReordering(2);
+
+	std::vector<std::function<int(int)>> slots;
+
+	for(int id = 1; id <= 3; ++id)
+	{
+		slots.push_back([id](int x)
+		{
+			return (x == id) ? id : 0;
+		});
+	}
+
+	// Appending to an empty Federate keeps the statistics parallel to the functions.
+	federate.push_back_range(std::begin(slots), std::end(slots));
+
+	for(int i = 0; i < 4; ++i)
+	{
+		EXPECT_EQ(3, federate.invokeFirst(3));
+	}
+
+	EXPECT_EQ(3, federate.invoke(3)[0]);
+
+	// And so does appending after a clear.
+	federate.clear();
+	federate.push_back_range(std::begin(slots), std::end(slots));
+
+	for(int i = 0; i < 4; ++i)
+	{
+		EXPECT_EQ(2, federate.invokeFirst(2));
+	}
+
+	EXPECT_EQ(2, federate.invoke(2)[0]);
+}
+
+TEST(Federate, BoolInt_ThreadSafe_First_Scoped_Errors)
+{
+	auto federate = Federate<bool(int), false, true>();
+	federate.setErrorPolicy(FederateErrorPolicy::Collect);
+	federate.setHotReordering(4);
+
+	auto cold = federate.push_back_scoped([](int x)
+	{
+		return x < 0;
+	});
+
+	auto throws = federate.push_back_scoped([](int x)->bool
+	{
+		if(x == 13)
+		{
+			throw std::runtime_error("unlucky");
+		}
+
+		return false;
+	});
+
+	auto hot = federate.push_back_scoped([](int x)
+	{
+		return x > 0;
+	});
+
+	for(int i = 0; i < 8; ++i)
+	{
+		EXPECT_TRUE(federate.invokeFirst(1));
+	}
+
+	// Reordering keeps each scoped connection pointing at its own function.
+	cold.disconnect();
+	EXPECT_EQ(2, federate.size());
+	EXPECT_FALSE(federate.invokeFirst(-1));
+
+	hot.disconnect();
+	EXPECT_FALSE(federate.invokeFirst(13));
+	EXPECT_EQ(1, federate.takeErrors().size());
+	EXPECT_TRUE(throws.connected());
+}
+
+TEST(Federate, VoidIntString_ThreadSafe_WaitNext)
+{
+	auto federate = Federate<void(int, const std::string&), false, true>();
+	auto args = std::make_tuple(0, std::string());
+
+	// Nothing invokes it: the wait times out and leaves the arguments alone.
+	EXPECT_FALSE(federate.waitNext(args, std::chrono::milliseconds(10)));
+	EXPECT_EQ(0, std::get<0>(args));
+
+	std::atomic<bool> woken(false);
+	auto waiter = std::thread([&federate, &args, &woken]
+	{
+		EXPECT_TRUE(federate.waitNext(args, std::chrono::seconds(10)));
+		woken = true;
+	});
+
+	// Keep invoking until the waiter has registered and been woken.
+	for(int i = 1; woken == false; ++i)
+	{
+		federate.invoke(i, "signal");
+		std::this_thread::yield();
+	}
+
+	waiter.join();
+
+	EXPECT_GT(std::get<0>(args), 0);
+	EXPECT_EQ("signal", std::get<1>(args));
+
+	// Waiting added no function.
+	EXPECT_EQ(0, federate.size());
+}
+
+TEST(Federate, IntInt_ThreadSafe_WaitNext_Unbounded)
+{
+	auto federate = Federate<int(int), false, true>();
+	auto args = std::make_tuple(0);
+
+	// A timeout that has already passed returns at once.
+	EXPECT_FALSE(federate.waitNext(args, std::chrono::nanoseconds::min()));
+
+	// Timeouts past the end of the clock wait for the invocation rather than overflowing into the past.
+	std::atomic<int> woken(0);
+	auto waiter = std::thread([&federate, &woken]
+	{
+		auto bounded = std::make_tuple(0);
+		EXPECT_TRUE(federate.waitNext(bounded, std::chrono::nanoseconds::max()));
+		EXPECT_LT(0, std::get<0>(bounded));
+		++woken;
+
+		auto unbounded = std::make_tuple(0);
+		federate.waitNext(unbounded);
+		EXPECT_LT(std::get<0>(bounded), std::get<0>(unbounded));
+		++woken;
+	});
+
+	for(int i = 1; woken != 2; ++i)
+	{
+		federate.invoke(i);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	waiter.join();
+}
+
+TEST(Federate, IntInt_Tracked_NextAsync)
+{
+	auto federate = Federate<int(int), true, true>();
+	auto tracker = federate.push_back([](int x) { return x * 2; });
+
+	auto first = federate.nextAsync();
+	auto second = federate.nextAsync();
+	EXPECT_EQ(std::future_status::timeout, first.wait_for(std::chrono::milliseconds(0)));
+
+	EXPECT_EQ(14, federate.invoke(7).front());
+	EXPECT_EQ(7, std::get<0>(first.get()));
+	EXPECT_EQ(7, std::get<0>(second.get()));
+
+	// Each future sees one invocation only; asynchronous invocations are seen too.
+	auto third = federate.nextAsync();
+	federate.invokeAsync(9).front().get();
+	EXPECT_EQ(9, std::get<0>(third.get()));
+	EXPECT_EQ(1, federate.size());
+}
+
+namespace
+{
+	struct AbstractCounter
+	{
+		virtual ~AbstractCounter()
+		{
+		}
+
+		virtual int next() = 0;
+	};
+
+	struct Counter : public AbstractCounter
+	{
+		int next() override
+		{
+			return ++this->count;
+		}
+
+		int count = 0;
+	};
+}
+
+TEST(Federate, NonCopyableReferenceArguments)
+{
+	// Nothing can wait on these Federates, so invocations must not try to copy their arguments.
+	auto locking = Federate<void(std::mutex&)>();
+	locking.push_back([](std::mutex& m) { std::lock_guard<std::mutex> scopedLock(m); });
+	std::mutex mutex;
+	locking.invoke(mutex);
+	EXPECT_TRUE(locking.invokeChecked(mutex).errors.empty());
+
+	auto counting = Federate<int(AbstractCounter&), true, true>();
+	auto tracker = counting.push_back([](AbstractCounter& c) { return c.next(); });
+	auto throttled = counting.push_back_throttled([](AbstractCounter& c) { return c.next() * 10; }, 1, std::chrono::hours(1));
+
+	Counter counter;
+	EXPECT_EQ((std::vector<int>{1, 20}), counting.invoke(counter));
+	EXPECT_EQ(3, counting.invokeFirst(counter));
+	EXPECT_EQ(3, counter.count);
+
+	auto owning = Federate<void(std::unique_ptr<int>&)>();
+	owning.push_back([](std::unique_ptr<int>& p) { p.reset(new int(5)); });
+	std::unique_ptr<int> p;
+	owning.invoke(p);
+	ASSERT_NE(nullptr, p);
+	EXPECT_EQ(5, *p);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST(Federate, VoidIntDouble_Record_Replay)
+{
+	const std::string path = "/tmp/federate_test_" + std::to_string(::getpid()) + ".log";
+
+	{
+		FederateRecorder<void(int, double)> recorder(path);
+		auto source = Federate<void(int, double)>();
+		source.setRecorder(recorder.hook());
+
+		// Enough records to grow the log past its first mapping.
+		for(int i = 0; i < 5000; ++i)
+		{
+			source.invoke(i, i * 0.5);
+		}
+
+		source.setRecorder(nullptr);
+		source.invoke(-1, -1.0);
+
+		EXPECT_EQ(5000, recorder.size());
+	}
+
+	FederateReplay<void(int, double)> replay(path);
+	EXPECT_EQ(5000, replay.size());
+
+	auto sink = Federate<void(int, double), false, true>();
+	int count = 0;
+	bool ordered = true;
+
+	sink.push_back([&count, &ordered](int x, double y)
+	{
+		ordered = ordered && (x == count) && (y == x * 0.5);
+		++count;
+	});
+
+	EXPECT_EQ(5000, replay.replay(sink));
+	EXPECT_EQ(5000, count);
+	EXPECT_TRUE(ordered);
+
+	EXPECT_THROW(FederateReplay<void(int)> mismatched(path), std::system_error);
+	::unlink(path.c_str());
+}
+
+TEST(Federate, VoidFloat_Record_Replay_LayoutMismatch)
+{
+	const std::string path = "/tmp/federate_test_layout_" + std::to_string(::getpid()) + ".log";
+
+	{
+		FederateRecorder<void(float)> recorder(path);
+		auto source = Federate<void(float)>();
+		source.setRecorder(recorder.hook());
+		source.invoke(1.5f);
+		source.setRecorder(nullptr);
+	}
+
+	// Same record size, different argument kind.
+	static_assert(sizeof(float) == sizeof(int), "the mismatch below relies on equal sizes");
+	EXPECT_THROW(FederateReplay<void(int)> mismatched(path), std::system_error);
+
+	FederateReplay<void(float)> replay(path);
+	EXPECT_EQ(1, replay.size());
+	::unlink(path.c_str());
+}
+
+TEST(Federate, IntInt_Record_Replay_Original)
+{
+	const std::string path = "/tmp/federate_test_original_" + std::to_string(::getpid()) + ".log";
+	FederateRecorder<int(int)> recorder(path);
+	auto source = Federate<int(int), true, true>();
+	source.setRecorder(recorder.hook());
+
+	source.invoke(1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	source.invokeAsync(2);
+	recorder.close();
+
+	FederateReplay<int(int)> replay(path);
+	EXPECT_EQ(2, replay.size());
+	EXPECT_GE(replay.duration(), std::chrono::milliseconds(20));
+
+	auto sink = Federate<int(int)>();
+	int sum = 0;
+
+	sink.push_back([&sum](int x)
+	{
+		sum += x;
+		return x;
+	});
+
+	const auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(2, replay.replay(sink, FederateReplaySpeed::Original));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+	EXPECT_EQ(3, sum);
+
+	::unlink(path.c_str());
+}
+
+TEST(Federate, VoidInt_Record_GrowFailure)
+{
+	const std::string path = "/tmp/federate_test_grow_" + std::to_string(::getpid()) + ".log";
+	FederateRecorder<void(int)> recorder(path);
+	auto source = Federate<void(int)>();
+	source.setRecorder(recorder.hook());
+
+	// Cap the file at its first mapping so that growing it fails with EFBIG rather than raising SIGXFSZ.
+	struct rlimit limit;
+	ASSERT_EQ(0, ::getrlimit(RLIMIT_FSIZE, &limit));
+	auto capped = limit;
+	capped.rlim_cur = 64 * 1024;
+	const auto handler = std::signal(SIGXFSZ, SIG_IGN);
+	ASSERT_EQ(0, ::setrlimit(RLIMIT_FSIZE, &capped));
+
+	for(int i = 0; i < 10000; ++i)
+	{
+		EXPECT_NO_THROW(source.invoke(i));
+	}
+
+	::setrlimit(RLIMIT_FSIZE, &limit);
+	std::signal(SIGXFSZ, handler);
+
+	const auto kept = recorder.size();
+	EXPECT_LT(0, kept);
+	EXPECT_EQ(10000, kept + recorder.dropped());
+	EXPECT_EQ(std::errc::file_too_large, recorder.error());
+
+	// The old mapping survived, and recording resumes once the log can grow.
+	source.invoke(10000);
+	EXPECT_EQ(kept + 1, recorder.size());
+	recorder.close();
+
+	FederateReplay<void(int)> replay(path);
+	EXPECT_EQ(kept + 1, replay.size());
+
+	auto sink = Federate<void(int)>();
+	int last = -1;
+	bool ordered = true;
+
+	sink.push_back([&last, &ordered](int x)
+	{
+		ordered = ordered && (x > last);
+		last = x;
+	});
+
+	replay.replay(sink);
+	EXPECT_TRUE(ordered);
+	EXPECT_EQ(10000, last);
+
+	::unlink(path.c_str());
+}
+#endif